@@ -122,9 +122,11 @@ static void memTrace(THREADID t_id,
 
     thread_data_t* t_data = static_cast<thread_data_t*>(PIN_GetThreadData(tls_key, t_id));
     
+    // The memory trace is disabled here, so nothing to lock. See Workload_Char/trace_extr.cpp
+    // for the buffered version.
+/*
     // Lock the print out
     PIN_GetLock(&pinLock, t_id + 1);
-/*
     trace_out << t_id << " "
               << t_data->num_exes_before_mem_or_bra << " "
               << eip << " ";
@@ -137,8 +139,8 @@ static void memTrace(THREADID t_id,
         trace_out << "L ";
     }
     trace_out << mem_addr << std::endl;
-*/
     PIN_ReleaseLock(&pinLock);
+*/
     
     t_data->num_exes_before_mem_or_bra = 0;
 }
@@ -254,7 +256,7 @@ VOID FreeBefore(CHAR *s, ADDRINT size)
     typeof(heap.begin()) iter;
     if ((iter = heap.find(size)) != heap.end())
     {
-        trace_out << "FREE " << size << " " << iter->second << std::endl;
+        trace_out << "FREE " << size << " " << iter->second << "\n";
         heap.erase(iter);
     }
 }
@@ -265,10 +267,17 @@ VOID MallocAfter(ADDRINT ret)
     if (ret != 0) 
     {
         heap[ret] = last_malloc_size;
-        trace_out << "MALLOC " << ret << " " << last_malloc_size << std::endl;
+        trace_out << "MALLOC " << ret << " " << last_malloc_size << "\n";
     }
 }
 
+// The MALLOC/FREE lines are no longer flushed one by one.
+VOID Fini(INT32 code, VOID *v)
+{
+    trace_out << std::flush;
+    trace_out.close();
+}
+
 VOID Image(IMG img, VOID *v)
 {
     // Instrument the malloc() and free() functions.  Print the input argument
@@ -334,6 +343,8 @@ main(int argc, char *argv[])
     // Register Fini to be called when thread exits.
     PIN_AddThreadFiniFunction(ThreadFini, NULL);
 
+    PIN_AddFiniFunction(Fini, NULL);
+
     PIN_AddFollowChildProcessFunction(FollowChild, 0);
 
     // RTN_AddInstrumentFunction(routineCallback, 0);
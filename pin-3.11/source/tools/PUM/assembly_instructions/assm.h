@@ -9,7 +9,10 @@ namespace PUM
 {
 typedef uint8_t UINT8;
 
-enum class Operation : UINT8 {AND, OR, NOT}; // Will be extended soon.
+// The operations of the rows. The shifts move the bits of an operand taken as a little-endian
+// integer (bit j of byte i is bit 8 * i + j), by a number of bits passed in place of src_2, and
+// fill with zeros.
+enum class Operation : UINT8 {AND, OR, NOT, XOR, NAND, SHL, SHR};
 
 struct Args
 {
@@ -42,7 +45,8 @@ void ROWOPR(Args &args)
                   : // No outputs
                   : [src1] "r" (src_1_addr), [src2] "r" (src_2_addr), [dest] "r" (dest_addr),
                     [len] "r" (len_of_opr), [op] "r" (opr)
-                  : "rsp");
+                  // The pops restore rsp; the tool reads the operands from memory.
+                  : "memory");
 }
 
 // The final length of operation is 2^len_of_opr.
@@ -65,6 +69,31 @@ void ROWNOT(UINT8 *src_1_addr, UINT8 *dest_addr, UINT8 len_of_opr)
     ROWOPR(args);
 }
 
+void ROWXOR(UINT8 *src_1_addr, UINT8 *src_2_addr, UINT8 *dest_addr, UINT8 len_of_opr)
+{
+    Args args {src_1_addr, src_2_addr, dest_addr, len_of_opr, UINT8(Operation::XOR)};
+    ROWOPR(args);
+}
+
+void ROWNAND(UINT8 *src_1_addr, UINT8 *src_2_addr, UINT8 *dest_addr, UINT8 len_of_opr)
+{
+    Args args {src_1_addr, src_2_addr, dest_addr, len_of_opr, UINT8(Operation::NAND)};
+    ROWOPR(args);
+}
+
+// Shift by shift bits (less than 8 * 2^len_of_opr).
+void ROWSHL(UINT8 *src_1_addr, UINT8 *dest_addr, UINT8 len_of_opr, uintptr_t shift)
+{
+    Args args {src_1_addr, (UINT8 *)shift, dest_addr, len_of_opr, UINT8(Operation::SHL)};
+    ROWOPR(args);
+}
+
+void ROWSHR(UINT8 *src_1_addr, UINT8 *dest_addr, UINT8 len_of_opr, uintptr_t shift)
+{
+    Args args {src_1_addr, (UINT8 *)shift, dest_addr, len_of_opr, UINT8(Operation::SHR)};
+    ROWOPR(args);
+}
+
 // Some common sizes defined here
 // 256
 void ROWAND_256(UINT8 *src_1_addr, UINT8 *src_2_addr, UINT8 *dest_addr)
@@ -81,6 +110,26 @@ void ROWNOT_256(UINT8 *src_1_addr, UINT8 *dest_addr)
 {
     ROWNOT(src_1_addr, dest_addr, log2(256));
 }
+
+void ROWXOR_256(UINT8 *src_1_addr, UINT8 *src_2_addr, UINT8 *dest_addr)
+{
+    ROWXOR(src_1_addr, src_2_addr, dest_addr, log2(256));
+}
+
+void ROWNAND_256(UINT8 *src_1_addr, UINT8 *src_2_addr, UINT8 *dest_addr)
+{
+    ROWNAND(src_1_addr, src_2_addr, dest_addr, log2(256));
+}
+
+void ROWSHL_256(UINT8 *src_1_addr, UINT8 *dest_addr, uintptr_t shift)
+{
+    ROWSHL(src_1_addr, dest_addr, log2(256), shift);
+}
+
+void ROWSHR_256(UINT8 *src_1_addr, UINT8 *dest_addr, uintptr_t shift)
+{
+    ROWSHR(src_1_addr, dest_addr, log2(256), shift);
+}
 }
 
 #endif
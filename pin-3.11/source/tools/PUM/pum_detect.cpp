@@ -0,0 +1,714 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pin.H"
+
+#include "pum_eval.hh"
+
+// Finds the loops of an unmodified binary that are worth offloading as PUM row operations (see
+// assembly_instructions/assm.h), and estimates their speedup with the model of pum_eval.
+//
+// When an image loads, every innermost loop (a direct backward branch to an earlier instruction
+// of its routine, with no other backward branch in between) is analyzed statically, once, in
+// the order of its instructions:
+//     1) the values loaded from memory (but the stack and the RIP-relative scalars) are data,
+//        and so is what an instruction computes from data (register operands only, addresses
+//        are not data);
+//     2) the instructions computing on data are the data operations; the bitwise ones (AND,
+//        OR, XOR, NOT and ANDN, scalar or SIMD) must be at least -min_bitwise of them;
+//     3) a register read before it is written in the body, and holding data at its end, carries
+//        a dependence from one iteration to the next (a reduction): not a candidate;
+//     4) the body must not call, and must load and store (but the stack).
+// The loops that pass are instrumented: the iterations (the loop head reached), the invocations
+// (an edge into the body from outside it: the fall-through into the head, or a direct branch of
+// the routine, so that top-tested loops and loops entered in the middle count too), and every
+// memory access of the body, as streams of addresses.
+// At the end, a loop is a candidate if it
+//     5) runs at least -min_trips iterations per invocation;
+//     6) streams: every access goes a constant stride (of at most MAX_STRIDE_ELEMENTS elements)
+//        from the previous one, but the loads of a loop-invariant address;
+//     7) never loads what one of its stores wrote in an earlier iteration of the invocation.
+// The estimate runs the bytes stored through PUMEval::Evaluator, as row operations of a row
+// (the largest power of two bytes that fits) with the bitwise operations of an element (those
+// of an iteration per store of it, as an unrolled or vectorized body stores several elements
+// per iteration), the first two data load streams as sources and the first store stream as
+// destination, against the stores of the loop in PUMEval::CPU_Baseline.
+//
+// Only the main executable is analyzed, but with -main_only 0.
+using std::ofstream;
+ofstream out;
+
+KNOB<std::string> OutFile(KNOB_MODE_WRITEONCE, "pintool",
+    "o", "pum_detect.out", "specify output file name");
+
+KNOB<std::string> ConfigFile(KNOB_MODE_WRITEONCE, "pintool",
+    "c", "", "specify the PUM evaluation config (see configs/, default: DDR3 with Ambit)");
+
+KNOB<UINT64> MinTrips(KNOB_MODE_WRITEONCE, "pintool",
+    "min_trips", "1024", "minimum iterations per invocation of a candidate");
+
+KNOB<double> MinBitwise(KNOB_MODE_WRITEONCE, "pintool",
+    "min_bitwise", "0.5", "minimum fraction of bitwise operations among the data operations");
+
+KNOB<BOOL> MainOnly(KNOB_MODE_WRITEONCE, "pintool",
+    "main_only", "1", "analyze only the loops of the main executable");
+
+typedef PUM::Operation Operation;
+
+static const unsigned MAX_STRIDE_ELEMENTS = 8;
+static const double STREAMING_FRACTION = 0.9;
+
+struct Loop_Info;
+
+struct Stream_Info
+{
+    Loop_Info *loop;
+    unsigned index;
+    bool is_store;
+    UINT32 size;
+};
+
+// The accesses of a stream, in a thread, then in total.
+struct Stream_State
+{
+    UINT64 accesses = 0;
+    UINT64 zero_strides = 0;
+    UINT64 regular_strides = 0; // Constant and short, see above.
+    UINT64 bytes = 0;
+    ADDRINT min_addr = ~ADDRINT(0);
+
+    // The current invocation.
+    UINT64 invocation_accesses = 0;
+    ADDRINT last_addr = 0;
+    ADDRINT last_stride = 0;
+    // Stores: what the earlier iterations wrote (lo, hi), and the current one.
+    ADDRINT lo = 0, hi = 0;
+    ADDRINT cur_lo = 0, cur_hi = 0;
+
+    void add(const Stream_State &other)
+    {
+        accesses += other.accesses;
+        zero_strides += other.zero_strides;
+        regular_strides += other.regular_strides;
+        bytes += other.bytes;
+        min_addr = std::min(min_addr, other.min_addr);
+    }
+};
+
+struct Loop_State
+{
+    UINT64 invocations = 0;
+    UINT64 iterations = 0;
+    UINT64 dependences = 0; // Loads of what an earlier iteration stored.
+    std::vector<Stream_State> streams;
+
+    void add(const Loop_State &other)
+    {
+        invocations += other.invocations;
+        iterations += other.iterations;
+        dependences += other.dependences;
+        if (streams.size() < other.streams.size()) { streams.resize(other.streams.size()); }
+        for (unsigned i = 0; i < other.streams.size(); i++) { streams[i].add(other.streams[i]); }
+    }
+};
+
+struct Loop_Info
+{
+    unsigned id;
+    ADDRINT head;
+    ADDRINT end; // Past the back edge.
+    std::string rtn;
+    std::string img;
+
+    UINT64 ops[PUMTrace::NUM_OPERATIONS] = {}; // The bitwise data operations, per iteration.
+    UINT64 data_ops = 0;
+    std::vector<Stream_Info*> streams;
+
+    std::string reject; // Why it is not a candidate (statically), empty if it may be.
+
+    Loop_State total; // Of all the threads.
+};
+
+static std::vector<Loop_Info*> loops;
+
+static TLS_KEY tls_key = INVALID_TLS_KEY;
+static PIN_LOCK pinLock;
+
+struct Thread_State
+{
+    std::vector<Loop_State> loops; // By Loop_Info::id, as the thread meets them.
+};
+
+static Loop_State &loopState(THREADID t_id, const Loop_Info *loop)
+{
+    Thread_State *t_state = static_cast<Thread_State*>(PIN_GetThreadData(tls_key, t_id));
+    if (loop->id >= t_state->loops.size()) { t_state->loops.resize(loop->id + 1); }
+    Loop_State &state = t_state->loops[loop->id];
+    if (state.streams.size() != loop->streams.size())
+    {
+        state.streams.resize(loop->streams.size());
+    }
+    return state;
+}
+
+// An edge into the loop from outside it.
+static void loopEntry(THREADID t_id, Loop_Info *loop)
+{
+    Loop_State &state = loopState(t_id, loop);
+    state.invocations++;
+    for (auto &stream : state.streams)
+    {
+        stream.invocation_accesses = 0;
+        stream.lo = stream.hi = stream.cur_lo = stream.cur_hi = 0;
+    }
+}
+
+static void loopHead(THREADID t_id, Loop_Info *loop)
+{
+    Loop_State &state = loopState(t_id, loop);
+    for (auto &stream : state.streams)
+    {
+        if (stream.cur_lo == stream.cur_hi) { continue; }
+        if (stream.lo == stream.hi)
+        {
+            stream.lo = stream.cur_lo;
+            stream.hi = stream.cur_hi;
+        }
+        else
+        {
+            stream.lo = std::min(stream.lo, stream.cur_lo);
+            stream.hi = std::max(stream.hi, stream.cur_hi);
+        }
+        stream.cur_lo = stream.cur_hi = 0;
+    }
+    state.iterations++;
+}
+
+static void memAccess(THREADID t_id, Stream_Info *info, ADDRINT addr)
+{
+    Loop_State &state = loopState(t_id, info->loop);
+    Stream_State &stream = state.streams[info->index];
+
+    if (stream.invocation_accesses > 0)
+    {
+        ADDRINT stride = addr - stream.last_addr;
+        ADDRINT max_stride = ADDRINT(MAX_STRIDE_ELEMENTS) * info->size;
+        bool short_stride = stride <= max_stride || -stride <= max_stride;
+        if (stride == 0) { stream.zero_strides++; }
+        else if (short_stride &&
+                 (stream.invocation_accesses == 1 || stride == stream.last_stride))
+        {
+            stream.regular_strides++;
+        }
+        stream.last_stride = stride;
+    }
+    stream.accesses++;
+    stream.invocation_accesses++;
+    stream.bytes += info->size;
+    stream.min_addr = std::min(stream.min_addr, addr);
+    stream.last_addr = addr;
+
+    if (info->is_store)
+    {
+        if (stream.cur_lo == stream.cur_hi)
+        {
+            stream.cur_lo = addr;
+            stream.cur_hi = addr + info->size;
+        }
+        else
+        {
+            stream.cur_lo = std::min(stream.cur_lo, addr);
+            stream.cur_hi = std::max(stream.cur_hi, addr + info->size);
+        }
+        return;
+    }
+
+    for (auto *other : info->loop->streams)
+    {
+        if (!other->is_store) { continue; }
+        const Stream_State &written = state.streams[other->index];
+        if (addr + info->size > written.lo && addr < written.hi) { state.dependences++; }
+    }
+}
+
+VOID ThreadStart(THREADID threadid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    if (PIN_SetThreadData(tls_key, new Thread_State, threadid) == FALSE)
+    {
+        std::cerr << "PIN_SetThreadData failed" << std::endl;
+        PIN_ExitProcess(1);
+    }
+}
+
+VOID ThreadFini(THREADID threadIndex, const CONTEXT *ctxt, INT32 code, VOID *v)
+{
+    Thread_State *t_state = static_cast<Thread_State*>(PIN_GetThreadData(tls_key, threadIndex));
+
+    PIN_GetLock(&pinLock, threadIndex + 1);
+    for (unsigned id = 0; id < t_state->loops.size(); id++)
+    {
+        loops[id]->total.add(t_state->loops[id]);
+    }
+    PIN_ReleaseLock(&pinLock);
+
+    delete t_state;
+    PIN_SetThreadData(tls_key, NULL, threadIndex);
+}
+
+// The row operations of a bitwise instruction (ANDN is a NOT, then an AND) into ops, returns
+// their number (0 if it is not one).
+static unsigned bitwiseOps(INS ins, Operation ops[2])
+{
+    switch (INS_Opcode(ins))
+    {
+        case XED_ICLASS_AND: case XED_ICLASS_PAND: case XED_ICLASS_ANDPS: case XED_ICLASS_ANDPD:
+        case XED_ICLASS_VPAND: case XED_ICLASS_VANDPS: case XED_ICLASS_VANDPD:
+        case XED_ICLASS_VPANDD: case XED_ICLASS_VPANDQ:
+            ops[0] = Operation::AND;
+            return 1;
+        case XED_ICLASS_OR: case XED_ICLASS_POR: case XED_ICLASS_ORPS: case XED_ICLASS_ORPD:
+        case XED_ICLASS_VPOR: case XED_ICLASS_VORPS: case XED_ICLASS_VORPD:
+        case XED_ICLASS_VPORD: case XED_ICLASS_VPORQ:
+            ops[0] = Operation::OR;
+            return 1;
+        case XED_ICLASS_XOR: case XED_ICLASS_PXOR: case XED_ICLASS_XORPS: case XED_ICLASS_XORPD:
+        case XED_ICLASS_VPXOR: case XED_ICLASS_VXORPS: case XED_ICLASS_VXORPD:
+        case XED_ICLASS_VPXORD: case XED_ICLASS_VPXORQ:
+            ops[0] = Operation::XOR;
+            return 1;
+        case XED_ICLASS_NOT:
+            ops[0] = Operation::NOT;
+            return 1;
+        case XED_ICLASS_ANDN: case XED_ICLASS_PANDN: case XED_ICLASS_ANDNPS:
+        case XED_ICLASS_ANDNPD: case XED_ICLASS_VPANDN: case XED_ICLASS_VANDNPS:
+        case XED_ICLASS_VANDNPD: case XED_ICLASS_VPANDND: case XED_ICLASS_VPANDNQ:
+            ops[0] = Operation::NOT;
+            ops[1] = Operation::AND;
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// An XOR of a register with itself (or SUB): sets it to zero, reads nothing.
+static bool isZeroIdiom(INS ins)
+{
+    Operation ops[2];
+    bool zeroing = (bitwiseOps(ins, ops) == 1 && ops[0] == Operation::XOR) ||
+                   INS_Opcode(ins) == XED_ICLASS_SUB;
+    if (!zeroing) { return false; }
+
+    REG reg = REG_INVALID();
+    unsigned num_regs = 0;
+    for (UINT32 i = 0; i < INS_OperandCount(ins); i++)
+    {
+        if (INS_OperandIsImplicit(ins, i)) { continue; }
+        if (!INS_OperandIsReg(ins, i)) { return false; }
+        if (num_regs > 0 && INS_OperandReg(ins, i) != reg) { return false; }
+        reg = INS_OperandReg(ins, i);
+        num_regs++;
+    }
+    return num_regs >= 2;
+}
+
+// Memory operands that are not data: the stack, and the RIP-relative (scalar) ones.
+static bool isScalarMemOp(INS ins, UINT32 mem_op)
+{
+    REG base = INS_OperandMemoryBaseReg(ins, INS_MemoryOperandIndexToOperandIndex(ins, mem_op));
+    base = REG_FullRegName(base);
+    return base == REG_STACK_PTR || base == REG_GBP || base == REG_INST_PTR;
+}
+
+// Steps 1) to 4) above, on the instructions of the body (the last one is the back edge).
+static void analyzeBody(Loop_Info *loop, const std::vector<INS> &body)
+{
+    std::vector<bool> data(REG_LAST, false);
+    std::vector<bool> written(REG_LAST, false);
+    std::vector<bool> read_first(REG_LAST, false);
+    bool loads = false, stores = false;
+
+    for (unsigned n = 0; n < body.size(); n++)
+    {
+        INS ins = body[n];
+        if (INS_IsCall(ins))
+        {
+            loop->reject = "call in the body";
+            return;
+        }
+        if (n + 1 < body.size() && INS_IsDirectBranch(ins) &&
+            INS_DirectControlFlowTargetAddress(ins) <= INS_Address(ins))
+        {
+            loop->reject = "not innermost";
+            return;
+        }
+        if (INS_IsBranch(ins) || INS_IsNop(ins)) { continue; }
+
+        bool zero = isZeroIdiom(ins);
+        bool reads_data = false;
+        for (UINT32 i = 0; !zero && i < INS_OperandCount(ins); i++)
+        {
+            if (!INS_OperandIsReg(ins, i) || !INS_OperandRead(ins, i)) { continue; }
+            REG reg = REG_FullRegName(INS_OperandReg(ins, i));
+            if (!REG_valid(reg) || reg >= REG_LAST) { continue; }
+            if (data[reg]) { reads_data = true; }
+            if (!written[reg]) { read_first[reg] = true; }
+        }
+        for (UINT32 i = 0; i < INS_MemoryOperandCount(ins); i++)
+        {
+            if (isScalarMemOp(ins, i)) { continue; }
+            if (INS_MemoryOperandIsRead(ins, i))
+            {
+                reads_data = true;
+                loads = true;
+            }
+            if (INS_MemoryOperandIsWritten(ins, i)) { stores = true; }
+        }
+
+        for (UINT32 i = 0; i < INS_MaxNumWRegs(ins); i++)
+        {
+            REG reg = REG_FullRegName(INS_RegW(ins, i));
+            if (!REG_valid(reg) || reg >= REG_LAST || reg == REG_GFLAGS) { continue; }
+            data[reg] = reads_data;
+            written[reg] = true;
+        }
+
+        xed_category_enum_t category = xed_category_enum_t(INS_Category(ins));
+        bool moves = category == XED_CATEGORY_DATAXFER || category == XED_CATEGORY_CONVERT ||
+                     category == XED_CATEGORY_BROADCAST;
+        if (!reads_data || moves) { continue; }
+        loop->data_ops++;
+        Operation ops[2];
+        unsigned num_ops = bitwiseOps(ins, ops);
+        for (unsigned i = 0; i < num_ops; i++) { loop->ops[unsigned(ops[i])]++; }
+    }
+
+    for (unsigned reg = 0; reg < REG_LAST; reg++)
+    {
+        if (read_first[reg] && written[reg] && data[reg])
+        {
+            loop->reject = "loop-carried dependence through " + REG_StringShort(REG(reg));
+            return;
+        }
+    }
+    if (!loads || !stores)
+    {
+        loop->reject = "no load or no store";
+        return;
+    }
+
+    UINT64 bitwise = 0;
+    for (UINT64 count : loop->ops) { bitwise += count; }
+    if (bitwise == 0 || bitwise < MinBitwise.Value() * loop->data_ops)
+    {
+        loop->reject = "not dominated by bitwise operations";
+    }
+}
+
+// The body is insts[head] to insts[tail], the instructions of its routine.
+static void instrumentLoop(Loop_Info *loop, const std::vector<INS> &insts, unsigned head,
+                           unsigned tail)
+{
+    std::vector<INS> body(insts.begin() + head, insts.begin() + tail + 1);
+
+    // The entries: the fall-through into the head, and the branches from outside the body to
+    // it (indirect jumps, and branches from other routines, are not seen).
+    if (head > 0 && INS_HasFallThrough(insts[head - 1]))
+    {
+        INS_InsertCall(insts[head - 1], IPOINT_AFTER, (AFUNPTR)loopEntry,
+                       IARG_THREAD_ID,
+                       IARG_PTR, loop,
+                       IARG_END);
+    }
+    for (unsigned n = 0; n < insts.size(); n++)
+    {
+        INS ins = insts[n];
+        if ((n >= head && n <= tail) || !INS_IsDirectBranch(ins)) { continue; }
+        ADDRINT target = INS_DirectControlFlowTargetAddress(ins);
+        if (target < loop->head || target >= loop->end) { continue; }
+        INS_InsertCall(ins, IPOINT_TAKEN_BRANCH, (AFUNPTR)loopEntry,
+                       IARG_THREAD_ID,
+                       IARG_PTR, loop,
+                       IARG_END);
+    }
+
+    INS_InsertCall(body.front(), IPOINT_BEFORE, (AFUNPTR)loopHead,
+                   IARG_THREAD_ID,
+                   IARG_PTR, loop,
+                   IARG_END);
+
+    for (INS ins : body)
+    {
+        for (UINT32 i = 0; i < INS_MemoryOperandCount(ins); i++)
+        {
+            if (isScalarMemOp(ins, i)) { continue; }
+
+            bool is_store = INS_MemoryOperandIsWritten(ins, i);
+            Stream_Info *stream = new Stream_Info{loop, unsigned(loop->streams.size()), is_store,
+                                                  UINT32(INS_MemoryOperandSize(ins, i))};
+            loop->streams.push_back(stream);
+            INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)memAccess,
+                                     IARG_THREAD_ID,
+                                     IARG_PTR, stream,
+                                     IARG_MEMORYOP_EA, i,
+                                     IARG_END);
+        }
+    }
+}
+
+VOID Image(IMG img, VOID *v)
+{
+    if (MainOnly.Value() && !IMG_IsMainExecutable(img)) { return; }
+
+    for (SEC sec = IMG_SecHead(img); SEC_Valid(sec); sec = SEC_Next(sec))
+    {
+        for (RTN rtn = SEC_RtnHead(sec); RTN_Valid(rtn); rtn = RTN_Next(rtn))
+        {
+            RTN_Open(rtn);
+            std::vector<INS> insts;
+            for (INS ins = RTN_InsHead(rtn); INS_Valid(ins); ins = INS_Next(ins))
+            {
+                insts.push_back(ins);
+            }
+
+            for (unsigned tail = 0; tail < insts.size(); tail++)
+            {
+                INS ins = insts[tail];
+                if (!INS_IsDirectBranch(ins)) { continue; }
+                ADDRINT target = INS_DirectControlFlowTargetAddress(ins);
+                if (target > INS_Address(ins) || target < RTN_Address(rtn)) { continue; }
+
+                unsigned head = tail;
+                while (head > 0 && INS_Address(insts[head]) > target) { head--; }
+                if (INS_Address(insts[head]) != target) { continue; }
+
+                Loop_Info *loop = new Loop_Info;
+                loop->id = loops.size();
+                loop->head = target;
+                loop->end = INS_Address(ins) + INS_Size(ins);
+                loop->rtn = RTN_Name(rtn);
+                loop->img = IMG_Name(img);
+                PIN_GetLock(&pinLock, PIN_ThreadId() + 1);
+                loops.push_back(loop); // ThreadFini() may be reading it.
+                PIN_ReleaseLock(&pinLock);
+
+                std::vector<INS> body(insts.begin() + head, insts.begin() + tail + 1);
+                analyzeBody(loop, body);
+                // Entered by calls, which are not told apart from the back edge.
+                if (loop->reject.empty() && head == 0)
+                {
+                    loop->reject = "loop head is the routine entry";
+                }
+                if (loop->reject.empty()) { instrumentLoop(loop, insts, head, tail); }
+            }
+            RTN_Close(rtn);
+        }
+    }
+}
+
+// Steps 5) to 7) above, empty if the loop is a candidate.
+static std::string dynamicReject(const Loop_Info &loop)
+{
+    const Loop_State &total = loop.total;
+    if (total.iterations < MinTrips.Value() * total.invocations) { return "few iterations"; }
+    if (total.dependences > 0) { return "loop-carried dependence through memory"; }
+
+    for (unsigned i = 0; i < loop.streams.size(); i++)
+    {
+        const Stream_State &stream = total.streams[i];
+        UINT64 strides = stream.accesses - std::min(stream.accesses, total.invocations);
+        if (stream.zero_strides >= STREAMING_FRACTION * strides)
+        {
+            if (loop.streams[i]->is_store) { return "stores to a scalar"; }
+            continue;
+        }
+        if (stream.regular_strides < STREAMING_FRACTION * strides) { return "not streaming"; }
+    }
+    return "";
+}
+
+// The loop as row operations, see above.
+static double estimateSpeedup(const Loop_Info &loop, const PUMEval::Config &cfg)
+{
+    const Loop_State &total = loop.total;
+    std::vector<ADDRINT> srcs;
+    ADDRINT dest = 0;
+    UINT64 stored = 0, stores = 0;
+    bool has_dest = false;
+    for (unsigned i = 0; i < loop.streams.size(); i++)
+    {
+        const Stream_State &stream = total.streams[i];
+        UINT64 strides = stream.accesses - std::min(stream.accesses, total.invocations);
+        if (stream.zero_strides >= STREAMING_FRACTION * strides) { continue; }
+
+        if (!loop.streams[i]->is_store) { srcs.push_back(stream.min_addr); }
+        else
+        {
+            if (!has_dest) { dest = stream.min_addr; }
+            has_dest = true;
+            stored += stream.bytes;
+            stores += stream.accesses;
+        }
+    }
+    if (srcs.empty() || !has_dest) { return 0; }
+    if (srcs.size() == 1) { srcs.push_back(srcs[0]); }
+
+    // The operations of an element: those of an iteration per store of it (which may be
+    // fractional, carried from a row to the next).
+    double stores_per_iteration = double(stores) / std::max<UINT64>(total.iterations, 1);
+    double per_row[PUMTrace::NUM_OPERATIONS];
+    double carried[PUMTrace::NUM_OPERATIONS] = {};
+    for (unsigned op = 0; op < PUMTrace::NUM_OPERATIONS; op++)
+    {
+        per_row[op] = loop.ops[op] / std::max(stores_per_iteration, 1.0);
+    }
+
+    PUMTrace::Record record;
+    while ((UINT64(2) << record.len_of_opr) <= cfg.row_bytes) { record.len_of_opr++; }
+    PUMEval::Evaluator evaluator(cfg);
+    for (UINT64 offset = 0; offset < stored; offset += record.size())
+    {
+        for (unsigned op = 0; op < PUMTrace::NUM_OPERATIONS; op++)
+        {
+            carried[op] += per_row[op];
+            for (; carried[op] >= 1; carried[op] -= 1)
+            {
+                record.op = Operation(op);
+                record.src_1 = srcs[0] + offset;
+                record.src_2 = srcs[1] + offset;
+                record.dest = dest + offset;
+                evaluator.rowOperation(record);
+            }
+        }
+    }
+
+    PUMEval::CPU_Baseline baseline(cfg);
+    baseline.stores = stores;
+    baseline.store_lines = (stored + cfg.line_bytes - 1) / cfg.line_bytes;
+    return evaluator.timeNs() > 0 ? baseline.timeNs() / evaluator.timeNs() : 0;
+}
+
+static void report(const Loop_Info &loop, const std::string &reject, double speedup,
+                   const PUMEval::Config &cfg)
+{
+    const Loop_State &total = loop.total;
+    out << std::hex << "Loop 0x" << loop.head << "-0x" << loop.end << std::dec << " in "
+        << loop.rtn << " (" << loop.img << "): "
+        << (reject.empty() ? "candidate" : "not a candidate, " + reject) << "\n";
+    out << "    Invocations = " << total.invocations << ", iterations = " << total.iterations
+        << " (" << std::fixed << std::setprecision(1)
+        << double(total.iterations) / std::max<UINT64>(total.invocations, 1) << " each)\n";
+
+    out << "    Data operations per iteration = " << loop.data_ops << ", bitwise:";
+    for (unsigned op = 0; op < PUMTrace::NUM_OPERATIONS; op++)
+    {
+        if (loop.ops[op] > 0) { out << " " << PUMTrace::OP_NAMES[op] << " " << loop.ops[op]; }
+    }
+    out << "\n";
+
+    UINT64 loaded = 0, stored = 0;
+    unsigned num_loads = 0, num_stores = 0;
+    for (unsigned i = 0; i < loop.streams.size(); i++)
+    {
+        if (loop.streams[i]->is_store)
+        {
+            num_stores++;
+            stored += total.streams[i].bytes;
+        }
+        else
+        {
+            num_loads++;
+            loaded += total.streams[i].bytes;
+        }
+    }
+    out << "    Streams = " << num_loads << " loads, " << num_stores << " stores\n";
+    out << "    Bytes processed = " << stored << " stored, " << loaded << " loaded\n";
+    if (reject.empty())
+    {
+        out << "    Estimated speedup (" << cfg.memory_type << ", " << cfg.row_bytes
+            << "-byte rows) = " << std::setprecision(2) << speedup << "x\n";
+    }
+    out << "\n";
+}
+
+VOID Fini(INT32 code, VOID *v)
+{
+    PUMEval::Config cfg;
+    if (!ConfigFile.Value().empty()) { cfg = PUMEval::Config(ConfigFile.Value()); }
+
+    struct Result
+    {
+        const Loop_Info *loop;
+        std::string reject;
+        double speedup;
+        UINT64 stored;
+    };
+    std::vector<Result> results;
+    for (auto *loop : loops)
+    {
+        if (!loop->reject.empty() || loop->total.iterations == 0) { continue; }
+
+        Result result{loop, dynamicReject(*loop), 0, 0};
+        if (result.reject.empty()) { result.speedup = estimateSpeedup(*loop, cfg); }
+        for (unsigned i = 0; i < loop->streams.size(); i++)
+        {
+            if (loop->streams[i]->is_store) { result.stored += loop->total.streams[i].bytes; }
+        }
+        results.push_back(result);
+    }
+
+    // The candidates first, the most bytes first.
+    std::sort(results.begin(), results.end(), [](const Result &a, const Result &b) {
+        if (a.reject.empty() != b.reject.empty()) { return a.reject.empty(); }
+        return a.stored > b.stored;
+    });
+
+    out << "# PUM offload candidates\n\n";
+    for (auto &result : results) { report(*result.loop, result.reject, result.speedup, cfg); }
+
+    out << "# Loops not analyzed\n\n";
+    for (auto *loop : loops)
+    {
+        if (loop->reject.empty()) { continue; }
+        out << std::hex << "Loop 0x" << loop->head << "-0x" << loop->end << std::dec << " in "
+            << loop->rtn << ": " << loop->reject << "\n";
+    }
+    out.close();
+}
+
+int
+main(int argc, char *argv[])
+{
+    PIN_InitLock(&pinLock);
+    tls_key = PIN_CreateThreadDataKey(NULL);
+    if (tls_key == INVALID_TLS_KEY)
+    {
+        std::cerr << "number of already allocated keys reached the MAX_CLIENT_TLS_KEYS limit"
+                  << std::endl;
+        PIN_ExitProcess(1);
+    }
+
+    PIN_InitSymbols(); // Initialize all the PIN API functions
+
+    // Initialize PIN, e.g., process command line options
+    if(PIN_Init(argc,argv))
+    {
+        return 1;
+    }
+
+    out.open(OutFile.Value().c_str());
+
+    IMG_AddInstrumentFunction(Image, 0);
+
+    PIN_AddThreadStartFunction(ThreadStart, NULL);
+    PIN_AddThreadFiniFunction(ThreadFini, NULL);
+    PIN_AddFiniFunction(Fini, NULL);
+
+    /* Never returns */
+    PIN_StartProgram();
+
+    return 0;
+}
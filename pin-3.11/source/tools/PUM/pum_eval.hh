@@ -0,0 +1,348 @@
+#ifndef __PUM_EVAL_HH__
+#define __PUM_EVAL_HH__
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "pum_trace_format.hh"
+
+// Trace-driven evaluation of the row operations of a PUM trace (pum_trace, see
+// pum_trace_format.hh) in a DRAM (or PCM) with in-subarray bulk bitwise operations (as in
+// Ambit), against the stores of the same kernel on the CPU (normal_trace).
+namespace PUMEval
+{
+// Memory and cost parameters, "key = value" lines ('#' starts a comment), see configs/.
+struct Config
+{
+    std::string memory_type = "DRAM"; // Only a label.
+
+    // Geometry: per channel, ranks of banks of subarrays of rows, row_bytes each.
+    unsigned channels = 1;
+    unsigned ranks = 1;
+    unsigned banks = 8;
+    unsigned subarrays = 64;
+    unsigned rows = 512; // Per subarray.
+    unsigned row_bytes = 8192;
+    unsigned line_bytes = 64;
+
+    // Address mapping, from the most to the least significant bits: channel (ch), rank (ra),
+    // bank (ba), subarray (sa), row (ro) and column (co), all of them. The bits above the fields
+    // are ignored.
+    std::string address_mapping = "ro,sa,ra,ba,ch,co";
+
+    // One ACTIVATE-ACTIVATE-PRECHARGE (AAP, a row copy within a subarray), and the extra time
+    // and energy of one with a triple-row activation (TRA). ROWAND/ROWOR take three AAPs
+    // (operands and control row into the compute rows) and a TRA-AAP (into the destination),
+    // ROWNOT two AAPs (through a dual-contact row), ROWNAND five (a ROWAND into a dual-contact
+    // row), ROWXOR seven, three of them TRAs (two ANDs with the negated operands, then an OR).
+    // The shifts have no in-subarray form: every line of the operand goes over the internal
+    // bus (as a RowClone PSM copy) through a shifter, into the destination row, one AAP.
+    double aap_ns = 49.0;
+    double aap_energy_nj = 3.2;
+    double tra_extra_ns = 0.0;
+    double tra_extra_energy_nj = 0.7;
+
+    // RowClone pipelined serial mode: a line copied over the internal bus between subarrays or
+    // banks (or to another column), for the operands not co-located with the destination.
+    double psm_ns_per_line = 10.0;
+    double psm_energy_nj_per_line = 1.1;
+
+    // The CPU issues a row operation to the memory controller.
+    double issue_ns = 1.0;
+
+    // CPU baseline: every store costs cpu_ns_per_store of compute, and moves its line together
+    // with cpu_reads_per_store source lines over a channel of cpu_bandwidth_gbps; the time is
+    // the larger of the two. A line costs cpu_line_energy_nj.
+    double cpu_ns_per_store = 0.5;
+    unsigned cpu_reads_per_store = 2;
+    double cpu_bandwidth_gbps = 12.8;
+    double cpu_line_energy_nj = 8.0;
+
+    // The defaults, see above.
+    Config() {}
+
+    Config(const std::string &fname)
+    {
+        std::ifstream file(fname.c_str());
+        assert(file.good());
+
+        std::string line;
+        while (getline(file, line))
+        {
+            line = line.substr(0, line.find('#'));
+            size_t eq = line.find('=');
+            if (eq == std::string::npos) { continue; }
+            std::string key = trim(line.substr(0, eq));
+            std::string val = trim(line.substr(eq + 1));
+
+            if (key == "memory_type") { memory_type = val; }
+            else if (key == "channels") { channels = atoi(val.c_str()); }
+            else if (key == "ranks") { ranks = atoi(val.c_str()); }
+            else if (key == "banks") { banks = atoi(val.c_str()); }
+            else if (key == "subarrays") { subarrays = atoi(val.c_str()); }
+            else if (key == "rows") { rows = atoi(val.c_str()); }
+            else if (key == "row_bytes") { row_bytes = atoi(val.c_str()); }
+            else if (key == "line_bytes") { line_bytes = atoi(val.c_str()); }
+            else if (key == "address_mapping") { address_mapping = val; }
+            else if (key == "aap_ns") { aap_ns = atof(val.c_str()); }
+            else if (key == "aap_energy_nj") { aap_energy_nj = atof(val.c_str()); }
+            else if (key == "tra_extra_ns") { tra_extra_ns = atof(val.c_str()); }
+            else if (key == "tra_extra_energy_nj") { tra_extra_energy_nj = atof(val.c_str()); }
+            else if (key == "psm_ns_per_line") { psm_ns_per_line = atof(val.c_str()); }
+            else if (key == "psm_energy_nj_per_line")
+            {
+                psm_energy_nj_per_line = atof(val.c_str());
+            }
+            else if (key == "issue_ns") { issue_ns = atof(val.c_str()); }
+            else if (key == "cpu_ns_per_store") { cpu_ns_per_store = atof(val.c_str()); }
+            else if (key == "cpu_reads_per_store") { cpu_reads_per_store = atoi(val.c_str()); }
+            else if (key == "cpu_bandwidth_gbps") { cpu_bandwidth_gbps = atof(val.c_str()); }
+            else if (key == "cpu_line_energy_nj") { cpu_line_energy_nj = atof(val.c_str()); }
+            else { assert(false && "Unknown PUM evaluation parameter"); }
+        }
+    }
+
+    static std::string trim(const std::string &str)
+    {
+        size_t begin = str.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) { return ""; }
+        return str.substr(begin, str.find_last_not_of(" \t\r") + 1 - begin);
+    }
+};
+
+// Where an address is.
+struct Location
+{
+    unsigned channel;
+    unsigned rank;
+    unsigned bank;
+    unsigned subarray;
+    unsigned row;
+    unsigned column; // Byte in the row.
+
+    // The bank, among all of them.
+    unsigned globalBank(const Config &cfg) const
+    {
+        return (channel * cfg.ranks + rank) * cfg.banks + bank;
+    }
+
+    bool sameSubarray(const Location &other) const
+    {
+        return channel == other.channel && rank == other.rank && bank == other.bank &&
+               subarray == other.subarray;
+    }
+};
+
+// Bit fields of the addresses, in the order of the configuration.
+class Address_Mapping
+{
+  public:
+    Address_Mapping(const Config &cfg)
+    {
+        std::stringstream fields(cfg.address_mapping);
+        std::string name;
+        std::vector<Field> msb_first;
+        while (getline(fields, name, ','))
+        {
+            name = Config::trim(name);
+            Field field;
+            if (name == "ch") { field = Field{CHANNEL, log2(cfg.channels), 0}; }
+            else if (name == "ra") { field = Field{RANK, log2(cfg.ranks), 0}; }
+            else if (name == "ba") { field = Field{BANK, log2(cfg.banks), 0}; }
+            else if (name == "sa") { field = Field{SUBARRAY, log2(cfg.subarrays), 0}; }
+            else if (name == "ro") { field = Field{ROW, log2(cfg.rows), 0}; }
+            else if (name == "co") { field = Field{COLUMN, log2(cfg.row_bytes), 0}; }
+            else { assert(false && "address_mapping fields are ch, ra, ba, sa, ro and co"); }
+            msb_first.push_back(field);
+        }
+        assert(msb_first.size() == NUM_FIELDS);
+
+        unsigned shift = 0;
+        for (auto iter = msb_first.rbegin(); iter != msb_first.rend(); iter++)
+        {
+            iter->shift = shift;
+            shift += iter->bits;
+            fields_lsb_first.push_back(*iter);
+        }
+    }
+
+    Location locate(uint64_t addr) const
+    {
+        unsigned values[NUM_FIELDS];
+        for (auto &field : fields_lsb_first)
+        {
+            values[field.kind] = unsigned((addr >> field.shift) & ((1ULL << field.bits) - 1));
+        }
+        return Location{values[CHANNEL], values[RANK], values[BANK], values[SUBARRAY],
+                        values[ROW], values[COLUMN]};
+    }
+
+  protected:
+    enum Kind : unsigned { CHANNEL, RANK, BANK, SUBARRAY, ROW, COLUMN, NUM_FIELDS };
+
+    struct Field
+    {
+        Kind kind;
+        unsigned bits;
+        unsigned shift;
+    };
+    std::vector<Field> fields_lsb_first;
+
+    static unsigned log2(unsigned val)
+    {
+        assert(val > 0 && (val & (val - 1)) == 0);
+        unsigned bits = 0;
+        while ((1u << bits) < val) { bits++; }
+        return bits;
+    }
+};
+
+// The row operations of a kernel, in trace order. An operation is split at the row boundaries
+// of its destination, every piece (a row operation proper) runs in the subarray of its
+// destination, and every source piece that is in another subarray, or at another column, is
+// first copied there with RowClone (PSM). The pieces of different banks overlap, those of a
+// bank are serialized, and the CPU issues them one after the other (issue_ns).
+class Evaluator
+{
+  public:
+    Evaluator(const Config &_cfg)
+        : cfg(_cfg),
+          mapping(_cfg),
+          bank_free(_cfg.channels * _cfg.ranks * _cfg.banks, 0.0)
+    {}
+
+    void rowOperation(const PUMTrace::Record &record)
+    {
+        unsigned aaps = AAPS[unsigned(record.op)];
+        unsigned tras = TRAS[unsigned(record.op)];
+        bool shift = record.op == PUM::Operation::SHL || record.op == PUM::Operation::SHR;
+        num_ops[unsigned(record.op)]++;
+        bytes += record.size();
+
+        for (uint64_t offset = 0; offset < record.size(); )
+        {
+            Location dest = mapping.locate(record.dest + offset);
+            uint64_t piece = std::min<uint64_t>(record.size() - offset,
+                                                cfg.row_bytes - dest.column);
+
+            // Sources: co-located (same subarray and column), or copied in.
+            double copy_ns = 0;
+            unsigned busy_banks[2];
+            unsigned num_busy = 0;
+            for (unsigned i = 0; i < record.numOperands(); i++)
+            {
+                uint64_t src = (i == 0 ? record.src_1 : record.src_2) + offset;
+                Location loc = mapping.locate(src);
+                if (!shift && loc.sameSubarray(dest) && loc.column == dest.column) { continue; }
+
+                uint64_t lines = (piece + cfg.line_bytes - 1) / cfg.line_bytes;
+                if (!loc.sameSubarray(dest)) { subarray_copies++; }
+                else { column_copies++; }
+                copied_lines += lines;
+                copy_ns += lines * cfg.psm_ns_per_line;
+                energy_nj += lines * cfg.psm_energy_nj_per_line;
+                busy_banks[num_busy++] = loc.globalBank(cfg);
+            }
+
+            unsigned bank = dest.globalBank(cfg);
+            issue_time += cfg.issue_ns;
+            double start = std::max(issue_time, bank_free[bank]);
+            for (unsigned i = 0; i < num_busy; i++)
+            {
+                start = std::max(start, bank_free[busy_banks[i]]);
+            }
+
+            double latency = copy_ns + aaps * cfg.aap_ns + tras * cfg.tra_extra_ns;
+            bank_free[bank] = start + latency;
+            for (unsigned i = 0; i < num_busy; i++)
+            {
+                bank_free[busy_banks[i]] = std::max(bank_free[busy_banks[i]], start + copy_ns);
+            }
+            if (start + latency > end_time) { end_time = start + latency; }
+
+            energy_nj += aaps * cfg.aap_energy_nj + tras * cfg.tra_extra_energy_nj;
+            row_ops++;
+            offset += piece;
+        }
+    }
+
+    double timeNs() const { return end_time; }
+    double energyNJ() const { return energy_nj; }
+
+    uint64_t num_ops[PUMTrace::NUM_OPERATIONS] = {}; // By PUM::Operation.
+    uint64_t bytes = 0;
+    uint64_t row_ops = 0; // Pieces, see above.
+    uint64_t subarray_copies = 0;
+    uint64_t column_copies = 0;
+    uint64_t copied_lines = 0;
+
+  protected:
+    // AAPs and TRAs of a row operation, by PUM::Operation (see Config).
+    static constexpr unsigned AAPS[PUMTrace::NUM_OPERATIONS] = {4, 4, 2, 7, 5, 1, 1};
+    static constexpr unsigned TRAS[PUMTrace::NUM_OPERATIONS] = {1, 1, 0, 3, 1, 0, 0};
+
+    const Config &cfg;
+    Address_Mapping mapping;
+
+    std::vector<double> bank_free; // When each bank is done with its queued work.
+    double issue_time = 0;
+    double end_time = 0;
+    double energy_nj = 0;
+};
+
+// The CPU baseline, from a normal_trace trace: "S addr value" lines, the old then the new
+// value of every store (the consecutive lines of an address are one store).
+class CPU_Baseline
+{
+  public:
+    CPU_Baseline(const Config &_cfg) : cfg(_cfg) {}
+
+    bool read(const std::string &fn)
+    {
+        std::ifstream file(fn.c_str());
+        if (!file.good()) { return false; }
+
+        std::string line;
+        uint64_t prev_addr = ~0ULL;
+        uint64_t prev_line = ~0ULL;
+        while (getline(file, line))
+        {
+            if (line.size() < 2 || line[0] != 'S') { continue; }
+            uint64_t addr = strtoull(line.c_str() + 2, nullptr, 10);
+            if (addr == prev_addr) { continue; }
+            prev_addr = addr;
+            stores++;
+
+            uint64_t line_addr = addr / cfg.line_bytes;
+            if (line_addr != prev_line) { store_lines++; }
+            prev_line = line_addr;
+        }
+        return true;
+    }
+
+    uint64_t lines() const { return store_lines * (1 + cfg.cpu_reads_per_store); }
+
+    double timeNs() const
+    {
+        double compute_ns = stores * cfg.cpu_ns_per_store;
+        double memory_ns = lines() * cfg.line_bytes / cfg.cpu_bandwidth_gbps;
+        return std::max(compute_ns, memory_ns);
+    }
+
+    double energyNJ() const { return lines() * cfg.cpu_line_energy_nj; }
+
+    uint64_t stores = 0;
+    uint64_t store_lines = 0; // Lines stored to (again if the stores come back to one).
+
+  protected:
+    const Config &cfg;
+};
+}
+
+#endif
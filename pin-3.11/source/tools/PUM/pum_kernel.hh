@@ -0,0 +1,178 @@
+#ifndef __PUM_KERNEL_HH__
+#define __PUM_KERNEL_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#include "assembly_instructions/assm.h"
+
+// The semantics of the row operations (see assembly_instructions/assm.h), for pum_trace to
+// perform them on the memory of the application.
+//
+// The bitwise operations go 32 bytes at a time with AVX2, when the CPU has it (the tools are
+// not built with -mavx2, only these functions are), else 16 bytes at a time with SSE2, then a
+// byte at a time for what is left. The shifts go a 64-bit word at a time (a byte at a time for
+// the operands of less than 8 bytes).
+namespace PUMKernel
+{
+typedef PUM::Operation Operation;
+
+inline bool hasAVX2()
+{
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) { return false; }
+    // The OS must save the YMM registers (OSXSAVE, then XCR0 bits 1 and 2).
+    if ((ecx & bit_OSXSAVE) == 0 || (ecx & bit_AVX) == 0) { return false; }
+    unsigned xcr0_lo, xcr0_hi;
+    __asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+    if ((xcr0_lo & 6) != 6) { return false; }
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) { return false; }
+    return (ebx & bit_AVX2) != 0;
+}
+
+static const bool has_avx2 = hasAVX2();
+
+// dest = src_1 OP src_2 on the first done bytes, returns done (OP is known at compile time,
+// the switches go away).
+template <Operation OP>
+__attribute__((target("avx2")))
+inline size_t bitwiseAVX2(const uint8_t *src_1, const uint8_t *src_2, uint8_t *dest,
+                          size_t size)
+{
+    const __m256i ones = _mm256_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(src_1 + i));
+        __m256i b = OP == Operation::NOT ? ones
+                                         : _mm256_loadu_si256((const __m256i *)(src_2 + i));
+        __m256i r;
+        switch (OP)
+        {
+            case Operation::AND: r = _mm256_and_si256(a, b); break;
+            case Operation::OR: r = _mm256_or_si256(a, b); break;
+            case Operation::XOR: case Operation::NOT: r = _mm256_xor_si256(a, b); break;
+            default: r = _mm256_xor_si256(_mm256_and_si256(a, b), ones); break; // NAND
+        }
+        _mm256_storeu_si256((__m256i *)(dest + i), r);
+    }
+    return i;
+}
+
+template <Operation OP>
+inline size_t bitwiseSSE2(const uint8_t *src_1, const uint8_t *src_2, uint8_t *dest,
+                          size_t size)
+{
+    const __m128i ones = _mm_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src_1 + i));
+        __m128i b = OP == Operation::NOT ? ones : _mm_loadu_si128((const __m128i *)(src_2 + i));
+        __m128i r;
+        switch (OP)
+        {
+            case Operation::AND: r = _mm_and_si128(a, b); break;
+            case Operation::OR: r = _mm_or_si128(a, b); break;
+            case Operation::XOR: case Operation::NOT: r = _mm_xor_si128(a, b); break;
+            default: r = _mm_xor_si128(_mm_and_si128(a, b), ones); break; // NAND
+        }
+        _mm_storeu_si128((__m128i *)(dest + i), r);
+    }
+    return i;
+}
+
+template <Operation OP>
+inline void bitwise(const uint8_t *src_1, const uint8_t *src_2, uint8_t *dest, size_t size)
+{
+    size_t i = has_avx2 ? bitwiseAVX2<OP>(src_1, src_2, dest, size)
+                        : bitwiseSSE2<OP>(src_1, src_2, dest, size);
+    for (; i < size; i++)
+    {
+        uint8_t a = src_1[i];
+        uint8_t b = OP == Operation::NOT ? 0xff : src_2[i];
+        switch (OP)
+        {
+            case Operation::AND: dest[i] = a & b; break;
+            case Operation::OR: dest[i] = a | b; break;
+            case Operation::XOR: case Operation::NOT: dest[i] = a ^ b; break;
+            default: dest[i] = ~(a & b); break; // NAND
+        }
+    }
+}
+
+// The operand as a little-endian integer of size bytes, shifted left (towards the last byte)
+// or right by amount bits.
+inline void shift(bool left, const uint8_t *src, uint64_t amount, uint8_t *dest, size_t size)
+{
+    if (amount >= uint64_t(size) * 8)
+    {
+        memset(dest, 0, size);
+        return;
+    }
+
+    // Words (bytes for the small operands) and bits.
+    size_t word_bytes = size % 8 == 0 ? 8 : 1;
+    size_t num_words = size / word_bytes;
+    unsigned word_bits = unsigned(word_bytes * 8);
+    size_t words = size_t(amount / word_bits);
+    unsigned bits = unsigned(amount % word_bits);
+
+    auto word = [&](size_t i) -> uint64_t
+    {
+        if (i >= num_words) { return 0; } // Also the words "before" the first one (wrapped).
+        if (word_bytes == 1) { return src[i]; }
+        uint64_t w;
+        memcpy(&w, src + i * 8, 8);
+        return w;
+    };
+
+    for (size_t i = 0; i < num_words; i++)
+    {
+        uint64_t w;
+        if (left)
+        {
+            w = word(i - words) << bits;
+            if (bits != 0) { w |= word(i - words - 1) >> (word_bits - bits); }
+        }
+        else
+        {
+            w = word(i + words) >> bits;
+            if (bits != 0) { w |= word(i + words + 1) << (word_bits - bits); }
+        }
+
+        if (word_bytes == 1) { dest[i] = uint8_t(w); }
+        else { memcpy(dest + i * 8, &w, 8); }
+    }
+}
+
+// dest = src_1 op src_2, on size bytes; src_2 is unused by ROWNOT, and holds the shift of
+// ROWSHL and ROWSHR (src_2_value). dest must not overlap the sources.
+inline void execute(Operation op, const uint8_t *src_1, const uint8_t *src_2,
+                    uint64_t src_2_value, uint8_t *dest, size_t size)
+{
+    if (op == Operation::SHL || op == Operation::SHR)
+    {
+        shift(op == Operation::SHL, src_1, src_2_value, dest, size);
+    }
+    else
+    {
+        switch (op)
+        {
+            case Operation::AND: bitwise<Operation::AND>(src_1, src_2, dest, size); break;
+            case Operation::OR: bitwise<Operation::OR>(src_1, src_2, dest, size); break;
+            case Operation::NOT: bitwise<Operation::NOT>(src_1, src_2, dest, size); break;
+            case Operation::XOR: bitwise<Operation::XOR>(src_1, src_2, dest, size); break;
+            default: bitwise<Operation::NAND>(src_1, src_2, dest, size); break;
+        }
+    }
+}
+}
+
+#endif
@@ -9,6 +9,8 @@
 #include <sys/stat.h>
 
 #include "assembly_instructions/assm.h" // Our PMU class
+#include "pum_kernel.hh"
+#include "pum_trace_format.hh"
 
 using std::ofstream;
 ofstream trace_out;
@@ -20,71 +22,149 @@ ofstream data_out;
 KNOB<std::string> DataOut(KNOB_MODE_WRITEONCE, "pintool",
     "d", "", "specify output data file name");
 
+// Binary trace (see pum_trace_format.hh), in place of the text trace and data files.
+ofstream binary_out;
+KNOB<std::string> BinaryOut(KNOB_MODE_WRITEONCE, "pintool",
+    "b", "", "specify output binary trace file name (replaces -t and -d)");
+
+// Without -b, -t and -d, the row operations are only performed (no-trace mode).
+KNOB<BOOL> Emulate(KNOB_MODE_WRITEONCE, "pintool",
+    "emulate", "1", "perform the row operations on the memory of the application");
+
 // Extract Processing-using-Memory (PUM) traces
 typedef PUM::UINT8 UINT8;
 typedef PUM::Operation Operation;
 
-static void pumTrace(CONTEXT *ctxt)
+// Every thread formats its row operations into its own buffers (reused, nothing is allocated
+// once they have grown), and writes them out once they hold FLUSH_BYTES, or when it exits. The
+// order of the row operations across threads is only kept at that granularity.
+//
+// The operands are read once from the application, into operands, for the trace and for the
+// kernel (pum_kernel.hh), which computes the result into result before it goes to dest.
+static const size_t FLUSH_BYTES = 1 << 20;
+
+struct Thread_Buffers
 {
-    UINT8 **sp = (UINT8 **)PIN_GetContextReg(ctxt, REG_STACK_PTR);
+    std::string trace; // Text trace, or binary records.
+    std::string data; // Text data.
+    std::string operands; // src_1, then src_2 but for the operations of a single operand.
+    std::string result;
+};
 
-    UINT8 *opr = *sp;
-    UINT8 *len = *(sp + 1);
-    UINT8 *dest = *(sp + 2);
-    UINT8 *src_2 = *(sp + 3);
-    UINT8 *src_1 = *(sp + 4);
+static bool tracing = false;
 
-    if (*opr == UINT8(Operation::AND))
-    {
-        trace_out << "ROWAND ";
-    }
-    else if (*opr == UINT8(Operation::OR))
+static TLS_KEY tls_key = INVALID_TLS_KEY;
+static PIN_LOCK pinLock;
+
+static void flush(Thread_Buffers *t_bufs, THREADID t_id)
+{
+    if (!tracing) { return; }
+
+    PIN_GetLock(&pinLock, t_id + 1);
+    if (binary_out.is_open())
     {
-        trace_out << "ROWOR ";
+        binary_out.write(t_bufs->trace.data(), t_bufs->trace.size());
     }
-    else if (*opr == UINT8(Operation::NOT))
+    else
     {
-        trace_out << "ROWNOT ";
+        trace_out.write(t_bufs->trace.data(), t_bufs->trace.size());
+        data_out.write(t_bufs->data.data(), t_bufs->data.size());
     }
+    PIN_ReleaseLock(&pinLock);
 
-    unsigned size = pow(2.0, (double)*len);
-
-    trace_out << (uint64_t)src_1 << " ";
-    trace_out << (uint64_t)src_2 << " ";
-    trace_out << (uint64_t)dest << " ";
-    trace_out << size << "\n";
+    t_bufs->trace.clear();
+    t_bufs->data.clear();
+}
 
-    // Extrace data (for src_1 and src_2)
-    UINT8 *src_1_check = (UINT8 *)malloc(size * sizeof(UINT8));
-    UINT8 *src_2_check = (UINT8 *)malloc(size * sizeof(UINT8));
+// Copy an operand to the end of out.
+static void copyOperand(std::string &out, UINT8 *addr, uint32_t size)
+{
+    size_t begin = out.size();
+    out.resize(begin + size);
+    PIN_SafeCopy(&out[begin], addr, size);
+}
 
-    PIN_SafeCopy(src_1_check, src_1, size * sizeof(UINT8));
-    if (*opr != UINT8(Operation::NOT))
+// At the ud2 of ROWOPR(), sp points to the pointers it pushed.
+static void pumTrace(ADDRINT sp, THREADID t_id)
+{
+    UINT8 **frame = (UINT8 **)sp;
+
+    UINT8 *opr = *frame;
+    UINT8 *len = *(frame + 1);
+    UINT8 *dest = *(frame + 2);
+    UINT8 *src_2 = *(frame + 3);
+    UINT8 *src_1 = *(frame + 4);
+
+    if (*opr >= PUMTrace::NUM_OPERATIONS || *len > PUMTrace::MAX_LEN_OF_OPR) { return; }
+
+    PUMTrace::Record record;
+    record.op = Operation(*opr);
+    record.len_of_opr = *len;
+    record.src_1 = (uint64_t)src_1;
+    record.src_2 = (uint64_t)src_2;
+    record.dest = (uint64_t)dest;
+    uint32_t size = record.size();
+    bool two_operands = record.numOperands() == 2;
+
+    Thread_Buffers *t_bufs = static_cast<Thread_Buffers*>(PIN_GetThreadData(tls_key, t_id));
+    std::string &operands = t_bufs->operands;
+    operands.clear();
+    copyOperand(operands, src_1, size);
+    if (two_operands) { copyOperand(operands, src_2, size); }
+    const uint8_t *src_1_data = reinterpret_cast<const uint8_t*>(operands.data());
+    const uint8_t *src_2_data = two_operands ? src_1_data + size : nullptr;
+
+    if (binary_out.is_open())
     {
-        PIN_SafeCopy(src_2_check, src_2, size * sizeof(UINT8));
+        PUMTrace::appendHeader(record, t_bufs->trace);
+        t_bufs->trace.append(operands);
     }
+    else if (tracing)
+    {
+        PUMTrace::formatOp(record, t_bufs->trace);
 
-    data_out << (uint64_t)src_1 << " "
-             << size << " ";
-    for (unsigned i = 0; i < size; i++)
+        // Extract data (for src_1 and src_2)
+        PUMTrace::formatData(record.src_1, src_1_data, size, t_bufs->data);
+        if (two_operands) { PUMTrace::formatData(record.src_2, src_2_data, size, t_bufs->data); }
+    }
+
+    if (Emulate.Value())
     {
-        data_out << int(src_1_check[i]) << " ";
+        std::string &result = t_bufs->result;
+        result.resize(size);
+        uint8_t *result_data = reinterpret_cast<uint8_t*>(&result[0]);
+        PUMKernel::execute(record.op, src_1_data, src_2_data, record.src_2, result_data, size);
+        PIN_SafeCopy(dest, result_data, size);
     }
-    data_out << "\n";
 
-    if (*opr != UINT8(Operation::NOT))
+    if (t_bufs->trace.size() + t_bufs->data.size() >= FLUSH_BYTES) { flush(t_bufs, t_id); }
+}
+
+VOID ThreadStart(THREADID threadid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    Thread_Buffers *t_bufs = new Thread_Buffers;
+    if (tracing) { t_bufs->trace.reserve(FLUSH_BYTES); }
+    if (PIN_SetThreadData(tls_key, t_bufs, threadid) == FALSE)
     {
-        data_out << (uint64_t)src_2 << " "
-                 << size << " ";
-        for (unsigned i = 0; i < size; i++)
-        {
-            data_out << int(src_2_check[i]) << " ";
-        }
-        data_out << "\n";
+        std::cerr << "PIN_SetThreadData failed" << std::endl;
+        PIN_ExitProcess(1);
     }
+}
+
+VOID ThreadFini(THREADID threadIndex, const CONTEXT *ctxt, INT32 code, VOID *v)
+{
+    Thread_Buffers *t_bufs =
+        static_cast<Thread_Buffers*>(PIN_GetThreadData(tls_key, threadIndex));
+    flush(t_bufs, threadIndex);
+    delete t_bufs;
+    PIN_SetThreadData(tls_key, NULL, threadIndex);
+}
 
-    free(src_1_check);
-    free(src_2_check);
+VOID Fini(INT32 code, VOID *v)
+{
+    if (binary_out.is_open()) { binary_out.close(); }
+    if (trace_out.is_open()) { trace_out.close(); }
+    if (data_out.is_open()) { data_out.close(); }
 }
 
 VOID Image(IMG img, VOID *v)
@@ -104,17 +184,19 @@ VOID Image(IMG img, VOID *v)
                 RTN_Open(rtn);
                 for (INS ins = RTN_InsHead(rtn); INS_Valid(ins); ins = INS_Next(ins))
                 {
-                    if (INS_IsHalt(ins))
+                    // ROWOPR() signals a row operation with a ud2.
+                    if (INS_IsHalt(ins) || INS_Opcode(ins) == XED_ICLASS_UD2)
                     {
                         INS_InsertCall(ins, IPOINT_BEFORE,
                                       (AFUNPTR)pumTrace,
-                                       IARG_CONST_CONTEXT,
+                                       IARG_REG_VALUE, REG_STACK_PTR,
+                                       IARG_THREAD_ID,
                                        IARG_END);
                         INS_Delete(ins);
                     }
                 }
+                RTN_Close(rtn);
             }
-            RTN_Close(rtn);
         }
     }
 }
@@ -122,6 +204,15 @@ VOID Image(IMG img, VOID *v)
 int
 main(int argc, char *argv[])
 {
+    PIN_InitLock(&pinLock);
+    tls_key = PIN_CreateThreadDataKey(NULL);
+    if (tls_key == INVALID_TLS_KEY)
+    {
+        std::cerr << "number of already allocated keys reached the MAX_CLIENT_TLS_KEYS limit"
+                  << std::endl;
+        PIN_ExitProcess(1);
+    }
+
     PIN_InitSymbols(); // Initialize all the PIN API functions
 
     // Initialize PIN, e.g., process command line options
@@ -129,18 +220,35 @@ main(int argc, char *argv[])
     {
         return 1;
     }
-    assert(!TraceOut.Value().empty());
-    assert(!DataOut.Value().empty());
 
-    trace_out.open(TraceOut.Value().c_str());
-    data_out.open(DataOut.Value().c_str());
+    if (!BinaryOut.Value().empty())
+    {
+        binary_out.open(BinaryOut.Value().c_str(), std::ios::binary);
+        PUMTrace::File_Header header;
+        binary_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    else if (!TraceOut.Value().empty() || !DataOut.Value().empty())
+    {
+        if (TraceOut.Value().empty() || DataOut.Value().empty())
+        {
+            std::cerr << "-t and -d go together" << std::endl;
+            return 1;
+        }
+
+        trace_out.open(TraceOut.Value().c_str());
+        data_out.open(DataOut.Value().c_str());
+    }
+    tracing = binary_out.is_open() || trace_out.is_open();
 
     // Simulate each instruction, to eliminate overhead, we are using Trace-based call back.
     IMG_AddInstrumentFunction(Image, 0);
 
+    PIN_AddThreadStartFunction(ThreadStart, NULL);
+    PIN_AddThreadFiniFunction(ThreadFini, NULL);
+    PIN_AddFiniFunction(Fini, NULL);
+
     /* Never returns */
     PIN_StartProgram();
 
     return 0;
 }
-
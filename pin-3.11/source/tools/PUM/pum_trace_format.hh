@@ -0,0 +1,210 @@
+#ifndef __PUM_TRACE_FORMAT_HH__
+#define __PUM_TRACE_FORMAT_HH__
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "assembly_instructions/assm.h"
+
+// Trace formats written by pum_trace and read back by the offline tools.
+//
+// Text: two files,
+//     trace: one row operation per line, "<op> src_1 src_2 dest size", where op is ROWAND,
+//            ROWOR, ROWNOT, ROWXOR, ROWNAND, ROWSHL or ROWSHR (src_2 is the shift of the
+//            shifts, 0 for ROWNOT)
+//     data: one operand per line, "addr size byte byte ... " (src_1, then src_2 but for the
+//           operations of a single operand)
+//
+// Binary (version 1): a single file,
+//     File_Header
+//     { Record_Header, operand bytes } ...
+// where the operand bytes are the size bytes of src_1, then those of src_2 (but for the
+// operations of a single operand), as they were in memory.
+namespace PUMTrace
+{
+typedef PUM::Operation Operation;
+
+struct Record
+{
+    Operation op = Operation::AND;
+    uint8_t len_of_opr = 0; // The operands are 2^len_of_opr bytes.
+    uint64_t src_1 = 0;
+    uint64_t src_2 = 0; // The shift (in bits) of ROWSHL and ROWSHR, 0 for ROWNOT.
+    uint64_t dest = 0;
+
+    uint32_t size() const { return uint32_t(1) << len_of_opr; }
+    unsigned numOperands() const { return numOperands(op); }
+
+    static unsigned numOperands(Operation op)
+    {
+        return op == Operation::NOT || op == Operation::SHL || op == Operation::SHR ? 1 : 2;
+    }
+};
+
+static const unsigned NUM_OPERATIONS = unsigned(Operation::SHR) + 1;
+
+// Names of the operations, by Operation.
+static const char *const OP_NAMES[NUM_OPERATIONS] = {
+    "ROWAND", "ROWOR", "ROWNOT", "ROWXOR", "ROWNAND", "ROWSHL", "ROWSHR"
+};
+
+// The operation of a name, false if there is none.
+inline bool parseOp(const std::string &name, Operation &op)
+{
+    for (unsigned i = 0; i < NUM_OPERATIONS; i++)
+    {
+        if (name == OP_NAMES[i])
+        {
+            op = Operation(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+static const uint32_t MAGIC = 0x544d5550; // "PUMT"
+static const uint16_t VERSION = 1;
+
+struct File_Header
+{
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    uint16_t flags = 0;
+};
+
+struct Record_Header
+{
+    uint8_t op;
+    uint8_t len_of_opr;
+    uint16_t reserved;
+    uint32_t size; // Redundant with len_of_opr, checked by the reader.
+    uint64_t src_1;
+    uint64_t src_2;
+    uint64_t dest;
+};
+
+// Largest operand the reader accepts (len_of_opr up to 30).
+static const uint8_t MAX_LEN_OF_OPR = 30;
+
+// Append the header of a binary record to out; the operand bytes follow it.
+inline void appendHeader(const Record &record, std::string &out)
+{
+    Record_Header header;
+    header.op = uint8_t(record.op);
+    header.len_of_opr = record.len_of_opr;
+    header.reserved = 0;
+    header.size = record.size();
+    header.src_1 = record.src_1;
+    header.src_2 = record.src_2;
+    header.dest = record.dest;
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+inline void appendUInt(std::string &out, uint64_t val)
+{
+    char digits[20];
+    int len = 0;
+    do
+    {
+        digits[len++] = char('0' + val % 10);
+        val /= 10;
+    } while (val != 0);
+    while (len > 0) { out.push_back(digits[--len]); }
+}
+
+// Append the record as a line of the text trace.
+inline void formatOp(const Record &record, std::string &out)
+{
+    out.append(OP_NAMES[unsigned(record.op)]);
+    out.push_back(' ');
+    appendUInt(out, record.src_1);
+    out.push_back(' ');
+    appendUInt(out, record.src_2);
+    out.push_back(' ');
+    appendUInt(out, record.dest);
+    out.push_back(' ');
+    appendUInt(out, record.size());
+    out.push_back('\n');
+}
+
+// Append an operand as a line of the text data.
+inline void formatData(uint64_t addr, const uint8_t *data, uint32_t size, std::string &out)
+{
+    appendUInt(out, addr);
+    out.push_back(' ');
+    appendUInt(out, size);
+    out.push_back(' ');
+    for (uint32_t i = 0; i < size; i++)
+    {
+        appendUInt(out, data[i]);
+        out.push_back(' ');
+    }
+    out.push_back('\n');
+}
+
+// Reads a binary trace.
+class Reader
+{
+  public:
+    Reader(const std::string &fn)
+    {
+        file = fopen(fn.c_str(), "rb");
+        if (file == nullptr) { return; }
+
+        File_Header header;
+        valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == MAGIC &&
+                header.version == VERSION;
+    }
+
+    ~Reader()
+    {
+        if (file != nullptr) { fclose(file); }
+    }
+
+    bool isValid() const { return valid; }
+
+    // Next row operation; src_1_data and src_2_data (nullptr for the operations of a single
+    // operand) point to its operands, until the next call. False at the end (or on a malformed
+    // trace, see isValid()).
+    bool next(Record &record, const uint8_t *&src_1_data, const uint8_t *&src_2_data)
+    {
+        if (!valid) { return false; }
+
+        Record_Header header;
+        if (fread(&header, sizeof(header), 1, file) != 1) { return false; }
+        if (header.op >= NUM_OPERATIONS || header.len_of_opr > MAX_LEN_OF_OPR ||
+            header.size != uint32_t(1) << header.len_of_opr)
+        {
+            return invalid();
+        }
+
+        record.op = Operation(header.op);
+        record.len_of_opr = header.len_of_opr;
+        record.src_1 = header.src_1;
+        record.src_2 = header.src_2;
+        record.dest = header.dest;
+
+        data.resize(size_t(record.numOperands()) * header.size);
+        if (fread(&data[0], 1, data.size(), file) != data.size()) { return invalid(); }
+
+        src_1_data = &data[0];
+        src_2_data = record.numOperands() == 1 ? nullptr : &data[header.size];
+        return true;
+    }
+
+  private:
+    FILE *file = nullptr;
+    bool valid = false;
+    std::vector<uint8_t> data;
+
+    bool invalid()
+    {
+        valid = false;
+        return false;
+    }
+};
+}
+
+#endif
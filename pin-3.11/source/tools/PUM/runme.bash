@@ -8,6 +8,20 @@ make -C test_apps/
 
 ../../../pin -t obj-intel64/pum_trace.so -t sample_traces/pum.cpu_trace -d sample_traces/pum.data -- test_apps/test_app_our
 
+# No-trace mode: only perform the row operations.
+../../../pin -t obj-intel64/pum_trace.so -- test_apps/test_app_our
+
+# Loops of an unmodified binary worth offloading (see pum_detect.cpp).
+make -C ../Workload_Char/test_apps/
+../../../pin -t obj-intel64/pum_detect.so -o sample_traces/pum_detect.out -- ../Workload_Char/test_apps/test_app
+make clean -C ../Workload_Char/test_apps/
+
+make -C trace_tools/
+
+trace_tools/pum_eval -c configs/ddr3_ambit.cfg sample_traces/pum.cpu_trace sample_traces/base.cpu_trace
+
 make clean
 
 make clean -C test_apps/
+
+make clean -C trace_tools/
@@ -24,6 +24,14 @@ int main()
     {
         PUM::ROWAND_256(&(src_1[i]), &(src_2[i]), &(dest[i]));
     }
+
+    // pum_trace performs the row operations (unless -emulate 0).
+    unsigned wrong = 0;
+    for (int i = 0; i < ARR_SIZE; i++)
+    {
+        if (dest[i] != (src_1[i] & src_2[i])) { wrong++; }
+    }
+    if (wrong != 0) { std::cerr << wrong << " bytes of dest are wrong" << std::endl; }
     
     free(src_1);
     free(src_2);
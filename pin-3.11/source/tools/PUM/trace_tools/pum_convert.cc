@@ -0,0 +1,69 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../pum_trace_format.hh"
+
+// Converts a binary pum_trace trace into the text trace and data files (see
+// ../pum_trace_format.hh), as pum_trace writes them with -t and -d.
+//
+// Usage: pum_convert <binary trace> <text trace> <text data>
+static const size_t CHUNK_BYTES = 1 << 20;
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <binary trace> <text trace> <text data>\n";
+        return 1;
+    }
+
+    PUMTrace::Reader reader(argv[1]);
+    if (!reader.isValid())
+    {
+        std::cerr << "Cannot read trace " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::ofstream trace_out(argv[2], std::ios::binary);
+    std::ofstream data_out(argv[3], std::ios::binary);
+    if (!trace_out || !data_out)
+    {
+        std::cerr << "Cannot open " << (trace_out ? argv[3] : argv[2]) << "\n";
+        return 1;
+    }
+
+    uint64_t num_records = 0;
+    std::string trace, data;
+    PUMTrace::Record record;
+    const uint8_t *src_1_data, *src_2_data;
+    while (reader.next(record, src_1_data, src_2_data))
+    {
+        PUMTrace::formatOp(record, trace);
+        PUMTrace::formatData(record.src_1, src_1_data, record.size(), data);
+        if (src_2_data != nullptr)
+        {
+            PUMTrace::formatData(record.src_2, src_2_data, record.size(), data);
+        }
+        num_records++;
+
+        if (trace.size() + data.size() >= CHUNK_BYTES)
+        {
+            trace_out.write(trace.data(), trace.size());
+            data_out.write(data.data(), data.size());
+            trace.clear();
+            data.clear();
+        }
+    }
+    trace_out.write(trace.data(), trace.size());
+    data_out.write(data.data(), data.size());
+
+    if (!reader.isValid())
+    {
+        std::cerr << "Malformed trace " << argv[1] << " after " << num_records
+                  << " row operations\n";
+        return 1;
+    }
+    std::cerr << num_records << " row operations\n";
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../pum_eval.hh"
+
+// Evaluates the row operations of a PUM trace (binary, or the text trace of pum_trace -t) in
+// the memory of a configuration (see ../pum_eval.hh and ../configs), and compares the kernel
+// against its CPU baseline (a normal_trace trace), if given.
+//
+// Usage: pum_eval -c <config> <PUM trace> [<CPU baseline trace>]
+static bool readText(const std::string &fn, PUMEval::Evaluator &evaluator)
+{
+    std::ifstream file(fn.c_str());
+    if (!file.good()) { return false; }
+
+    std::string op;
+    PUMTrace::Record record;
+    uint64_t size;
+    while (file >> op >> record.src_1 >> record.src_2 >> record.dest >> size)
+    {
+        if (!PUMTrace::parseOp(op, record.op)) { return false; }
+
+        record.len_of_opr = 0;
+        while (record.size() < size) { record.len_of_opr++; }
+        if (record.size() != size) { return false; }
+        evaluator.rowOperation(record);
+    }
+    return file.eof();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || argc > 5 || strcmp(argv[1], "-c") != 0)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " -c <config> <PUM trace> [<CPU baseline trace>]\n";
+        return 1;
+    }
+
+    PUMEval::Config cfg(argv[2]);
+    PUMEval::Evaluator evaluator(cfg);
+
+    PUMTrace::Reader reader(argv[3]);
+    if (reader.isValid())
+    {
+        PUMTrace::Record record;
+        const uint8_t *src_1_data, *src_2_data;
+        while (reader.next(record, src_1_data, src_2_data)) { evaluator.rowOperation(record); }
+        if (!reader.isValid())
+        {
+            std::cerr << "Malformed trace " << argv[3] << "\n";
+            return 1;
+        }
+    }
+    else if (!readText(argv[3], evaluator))
+    {
+        std::cerr << "Cannot read trace " << argv[3] << "\n";
+        return 1;
+    }
+
+    printf("PUM: Memory = %s\n", cfg.memory_type.c_str());
+    for (unsigned op = 0; op < PUMTrace::NUM_OPERATIONS; op++)
+    {
+        printf("PUM: Number of %s = %lu\n", PUMTrace::OP_NAMES[op], evaluator.num_ops[op]);
+    }
+    printf("PUM: Bytes operated on = %lu\n", evaluator.bytes);
+    printf("PUM: Number of row operations = %lu\n", evaluator.row_ops);
+    printf("PUM: Number of RowClone copies (other subarray) = %lu\n", evaluator.subarray_copies);
+    printf("PUM: Number of RowClone copies (other column) = %lu\n", evaluator.column_copies);
+    printf("PUM: Lines copied = %lu\n", evaluator.copied_lines);
+    printf("PUM: Time (ns) = %.1f\n", evaluator.timeNs());
+    printf("PUM: Energy (nJ) = %.1f\n", evaluator.energyNJ());
+
+    if (argc == 5)
+    {
+        PUMEval::CPU_Baseline baseline(cfg);
+        if (!baseline.read(argv[4]))
+        {
+            std::cerr << "Cannot read trace " << argv[4] << "\n";
+            return 1;
+        }
+
+        printf("\nCPU: Number of stores = %lu\n", baseline.stores);
+        printf("CPU: Lines moved = %lu\n", baseline.lines());
+        printf("CPU: Time (ns) = %.1f\n", baseline.timeNs());
+        printf("CPU: Energy (nJ) = %.1f\n", baseline.energyNJ());
+
+        printf("\nSpeedup of the offloaded kernel = %.2fx\n",
+               evaluator.timeNs() > 0 ? baseline.timeNs() / evaluator.timeNs() : 0.0);
+        printf("Energy reduction of the offloaded kernel = %.2fx\n",
+               evaluator.energyNJ() > 0 ? baseline.energyNJ() / evaluator.energyNJ() : 0.0);
+    }
+    return 0;
+}
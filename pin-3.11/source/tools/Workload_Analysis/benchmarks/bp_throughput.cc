@@ -0,0 +1,127 @@
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/Sim/config.hh"
+#include "../src/Branch_Predictor/branch_predictor_factory.hh"
+
+// Predictions per second, ns per branch and accuracy of each branch predictor, configured the
+// way the profiler configures them (from a .cfg file), on the same synthetic branch stream.
+// The stream is a program of 64 static branches run over and over: loop branches with
+// constant trip counts, branches correlated with the earlier ones, periodic patterns and
+// biased random branches, so that the history-based predictors have something to learn.
+//
+// Usage: bp_throughput [number of branches (default 20M)] [.cfg file]
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+static uint64_t rngNext()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+struct Branch
+{
+    Addr PC;
+    bool taken;
+};
+
+static std::vector<Branch> genStream(uint64_t num_branches)
+{
+    enum Kind : int { LOOP, CORRELATED, PATTERN, BIASED };
+    struct Static_Branch
+    {
+        Kind kind;
+        Addr PC;
+        unsigned param; // The trip count, the pattern period or the bias (in 1/16).
+        unsigned count = 0;
+    };
+
+    std::vector<Static_Branch> program;
+    for (unsigned i = 0; i < 64; i++)
+    {
+        Static_Branch branch;
+        branch.kind = Kind(i % 4);
+        branch.PC = 0x400000 + i * 0x24 + (rngNext() & 0xc);
+        branch.param = branch.kind == LOOP ? 3 + (rngNext() % 30) :
+                       branch.kind == PATTERN ? 2 + (rngNext() % 7) :
+                       branch.kind == BIASED ? 12 + (rngNext() % 4) : 0;
+        program.push_back(branch);
+    }
+
+    std::vector<Branch> stream;
+    stream.reserve(num_branches);
+    uint64_t recent = 0; // The last outcomes.
+    while (stream.size() < num_branches)
+    {
+        for (auto &branch : program)
+        {
+            bool taken = false;
+            unsigned repeats = branch.kind == LOOP ? branch.param : 1;
+            for (unsigned r = 0; r < repeats && stream.size() < num_branches; r++)
+            {
+                switch (branch.kind)
+                {
+                    case LOOP: taken = r + 1 < repeats; break;
+                    case CORRELATED: taken = ((recent >> 1) ^ (recent >> 5)) & 1; break;
+                    case PATTERN: taken = (branch.count++ % branch.param) == 0; break;
+                    default: taken = (rngNext() & 15) < branch.param; break;
+                }
+                stream.push_back({branch.PC, taken});
+                recent = (recent << 1) | taken;
+            }
+        }
+    }
+    return stream;
+}
+
+static std::string writeConfig()
+{
+    std::string cfg_file = "/tmp/bp_throughput.cfg";
+    std::ofstream cfg(cfg_file);
+    cfg << "num_cores = 1\n"
+        << "block_size = 64\n";
+    return cfg_file;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t num_branches = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000000;
+    Config cfg(argc > 2 ? std::string(argv[2]) : writeConfig());
+
+    std::vector<Branch> stream = genStream(num_branches);
+
+    const char *names[] = {"two_bit_local", "tournament", "pentium_m", "tage_sc_l",
+                           "hashed_perceptron"};
+    for (auto name : names)
+    {
+        std::unique_ptr<BP::Branch_Predictor> bp(
+            BP::createBranchPredictor(name, cfg.tage, cfg.perceptron));
+        assert(bp);
+
+        Instruction instr;
+        instr.setBranch();
+        auto begin = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < stream.size(); i++)
+        {
+            instr.setPC(stream[i].PC);
+            instr.setTaken(stream[i].taken);
+            bp->predict(instr, i);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+        printf("%-17s %8.1f M predictions/s, %6.2f ns/branch, %6.2f%% correct\n", name,
+               stream.size() / elapsed.count() / 1e6, elapsed.count() * 1e9 / stream.size(),
+               bp->perf());
+    }
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../src/Branch_Predictor/packed_counter_table.hh"
+
+// Predictions per second of a tournament predictor (local, global and choice tables of 2-bit
+// counters, as BP::Tournament) on 64K- to 4M-entry tables, with three counter stores:
+//     1) The former std::vector<Sat_Counter> (8 bytes per counter, with the padding);
+//     2) PackedCounterTable<2, uint8_t> (4 counters per byte);
+//     3) PackedCounterTable<2> (32 counters per 64-bit word).
+// The branches are spread over a footprint larger than the tables, so that the host caches
+// matter; all three must predict the same.
+//
+// Usage: counter_table [number of branches (default 20M)]
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+static uint64_t rngNext()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// The counter Branch_Predictor used to have.
+class Sat_Counter
+{
+  public:
+    Sat_Counter(unsigned _counter_bits) : counter_bits(_counter_bits),
+                                          max_val((1 << counter_bits) - 1),
+                                          val(0)
+    {}
+
+    void increment() { if (val < max_val) { ++val; } }
+
+    void decrement() { if (val > 0) { --val; } }
+
+    bool predict() { return val >> (counter_bits - 1); }
+
+    const unsigned counter_bits;
+
+    uint8_t max_val;
+    uint8_t val;
+};
+
+// std::vector<Sat_Counter> behind the PackedCounterTable interface.
+class Sat_Counter_Table
+{
+  public:
+    Sat_Counter_Table(size_t num_counters) : counters(num_counters, 2) {}
+
+    bool predict(size_t i) { return counters[i].predict(); }
+
+    void increment(size_t i) { counters[i].increment(); }
+
+    void decrement(size_t i) { counters[i].decrement(); }
+
+    void update(size_t i, bool up)
+    {
+        if (up) { counters[i].increment(); }
+        else { counters[i].decrement(); }
+    }
+
+  protected:
+    std::vector<Sat_Counter> counters;
+};
+
+struct Branch
+{
+    uint64_t PC;
+    bool taken;
+};
+
+template<typename Table>
+static double run(const std::vector<Branch> &stream, size_t entries, uint64_t &correct)
+{
+    Table local(entries), global(entries), choice(entries);
+    uint64_t mask = entries - 1;
+    uint64_t history = 0;
+
+    correct = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (auto &branch : stream)
+    {
+        size_t local_index = (branch.PC >> 2) & mask;
+        size_t global_index = ((branch.PC >> 2) ^ history) & mask;
+
+        bool local_pred = local.predict(local_index);
+        bool global_pred = global.predict(global_index);
+        bool pred = choice.predict(global_index) ? global_pred : local_pred;
+        correct += pred == branch.taken;
+
+        if (local_pred != global_pred) { choice.update(global_index, global_pred == branch.taken); }
+        local.update(local_index, branch.taken);
+        global.update(global_index, branch.taken);
+        history = (history << 1) | branch.taken;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    return stream.size() / elapsed.count();
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t num_branches = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000000;
+
+    size_t sizes[] = {size_t(1) << 16, size_t(1) << 18, size_t(1) << 20, size_t(1) << 22};
+    for (auto entries : sizes)
+    {
+        // Branches over four times the entries, biased per branch.
+        std::vector<Branch> stream(num_branches);
+        for (auto &branch : stream)
+        {
+            uint64_t r = rngNext();
+            uint64_t id = (r >> 16) % (entries * 4);
+            branch.PC = 0x400000 + id * 4;
+            branch.taken = ((id * 0x9e3779b97f4a7c15ULL) >> 60) > (r & 15);
+        }
+
+        uint64_t correct[3];
+        double sat = run<Sat_Counter_Table>(stream, entries, correct[0]);
+        double bytes = run<BP::PackedCounterTable<2, uint8_t>>(stream, entries, correct[1]);
+        double words = run<BP::PackedCounterTable<2>>(stream, entries, correct[2]);
+        if (correct[1] != correct[0] || correct[2] != correct[0])
+        {
+            printf("Mismatch at %zu entries: %lu, %lu and %lu correct\n", entries,
+                   correct[0], correct[1], correct[2]);
+            return 1;
+        }
+
+        printf("%5zuK entries: Sat_Counter %7.1f M/s, packed (byte) %7.1f M/s (%.2fx), "
+               "packed (word) %7.1f M/s (%.2fx), %.2f%% correct\n", entries / 1024,
+               sat / 1e6, bytes / 1e6, bytes / sat, words / 1e6, words / sat,
+               100.0 * correct[0] / num_branches);
+    }
+
+    return 0;
+}
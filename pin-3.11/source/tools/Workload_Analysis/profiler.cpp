@@ -27,6 +27,8 @@ KNOB<std::string> TraceOut(KNOB_MODE_WRITEONCE, "pintool",
     "o", "", "specify output trace file name");
 KNOB<std::string> CfgFile(KNOB_MODE_WRITEONCE, "pintool",
     "i", "", "specify system configuration file name");
+KNOB<std::string> StatsOut(KNOB_MODE_WRITEONCE, "pintool",
+    "stats", "stats.txt", "specify the branch predictor stats file name (with -bp)");
 
 // Simulation components
 static unsigned NUM_CORES = 1;
@@ -44,7 +46,18 @@ static const Count NUM_RUNS = 100;
 
 Config *cfg;
 
-BP::Branch_Predictor *bp;
+// Branches are only predicted with -bp: the predictor(s) of the configuration, stats to -stats.
+BP::Branch_Predictor *bp = nullptr;
+KNOB<BOOL> SimBP(KNOB_MODE_WRITEONCE, "pintool",
+    "bp", "0", "simulate the branch predictor(s) of the configuration");
+
+// Several predictors (branch_predictor = <name>,<name>,... in the configuration) share one
+// pass, fed by bpSim() and each with its own stats in -stats; -bp_threads runs each on a Pin
+// internal thread.
+static BP::Predictor_Ensemble *bp_ensemble = nullptr;
+static std::vector<PIN_THREAD_UID> bp_worker_uids;
+KNOB<BOOL> BPThreads(KNOB_MODE_WRITEONCE, "pintool",
+    "bp_threads", "0", "run each branch predictor on its own internal thread");
 
 System::MMU *mmu;
 
@@ -57,18 +70,41 @@ static bool start_sim = false;
 static unsigned cur_run = 0;
 // static bool end_sim = false; 
 static UINT64 insn_count = 0; // Track how many instructions we have already instrumented.
-ofstream trace_out;
-static void increCount() { ++insn_count;
+static UINT64 next_event = SKIP; // Value of insn_count at which increCount() has work to do.
+// Trace output, compressed (-z) on a background thread, see
+// Workload_Char/include/Pin/output_stream.hh.
+#include "../Workload_Char/include/Pin/output_stream.hh"
+#include "../Workload_Char/include/Trace/trace_format.hh"
+static Output_Stream trace_out;
+KNOB<BOOL> CompressTrace(KNOB_MODE_WRITEONCE, "pintool",
+    "z", "0", "compress the trace output");
+// By default a line is "[count ]eip L|S addr" (count left out when 0). With -trace_tid, it is
+// the Trace text format "tid count eip L|S addr" (Workload_Char/include/Trace/trace_format.hh)
+// that trace_convert and replay read; compressed (-z), such a trace starts with a File_Header
+// (FLAG_COMPRESSED | FLAG_TEXT), while the default one is only LZ frames.
+// Either way the lines of different threads come in runs of ~1MB (one Output_Stream chunk).
+KNOB<BOOL> TraceTid(KNOB_MODE_WRITEONCE, "pintool",
+    "trace_tid", "0", "write the trace in the Trace text format (with thread ids)");
+// increCount() runs under countLock, see foldCount().
+PIN_LOCK countLock;
+static void increCount() { 
 //                           return; // TODO, don't forget to set start_sim to false
-                           if (insn_count < SKIP) { return; }
-                           if (insn_count == SKIP) { start_sim = true; return; }
-                           if (insn_count == SKIP + 1000000000)
+                           if (!start_sim)
                            {
-                               trace_out << std::flush;
-                               exit(0); 
+                               start_sim = true;
+                               next_event = SKIP + 1000000000;
+                               return;
+                           }
+                           if (insn_count >= SKIP + 1000000000)
+                           {
+                               // The trace is drained and closed in
+                               // PrepareForFini() and Fini(). The other threads
+                               // must not be left waiting on countLock.
+                               PIN_ReleaseLock(&countLock);
+                               PIN_ExitApplication(0);
                            }
                            return;
-                           if (cur_run == 0 && insn_count == (SKIP + PROFILING_LIMIT))
+                           if (cur_run == 0 && insn_count >= (SKIP + PROFILING_LIMIT))
                            {
                                std::string page_info_out = "page_profiling/10M.csv";
                                mmu->printPageInfo(page_info_out);
@@ -79,7 +115,7 @@ static void increCount() { ++insn_count;
                            }
 
                            if (cur_run > 0 && cur_run <= NUM_RUNS && 
-                               insn_count == (SKIP + PROFILING_LIMIT + 
+                               insn_count >= (SKIP + PROFILING_LIMIT + 
                                               cur_run * INFERENCE_LIMIT))
                            {
                                // Print phase stats.
@@ -118,14 +154,74 @@ static void increCount() { ++insn_count;
                            }
 }
 
-static unsigned num_exes_before_mem = 0;
-// Function: branch predictor simulation
-static void bpSim(ADDRINT eip, BOOL taken, ADDRINT target)
+// Instructions are counted once per basic block (BBL_NumIns) into per-thread counters, so
+// the 10B-instruction SKIP costs one inlined add-and-compare per basic block. A thread only
+// takes countLock to fold its counter into insn_count, which happens every COUNT_QUANTUM
+// instructions or when the fold could reach next_event, whichever comes first.
+//
+// The SKIP runs the skip version of the code, which carries nothing but the counter; the
+// simulation version is switched to once SKIP is reached.
+#include "../Workload_Char/include/Pin/fast_forward.hh"
+enum Version : ADDRINT
 {
-    if (!start_sim) { return; }
+    VERSION_SKIP = FastForward::DEFAULT_VERSION,
+    VERSION_SIM,
+    NUM_VERSIONS
+};
 
-    num_exes_before_mem++;
-    return;
+static const UINT64 COUNT_QUANTUM = 1 << 20;
+
+static void PIN_FAST_ANALYSIS_CALL foldCount(THREADID t_id)
+{
+    PIN_GetLock(&countLock, t_id + 1);
+    insn_count += FastForward::takeCount(t_id);
+
+    if (insn_count >= next_event)
+    {
+        increCount();
+        if (start_sim) { FastForward::setVersion(VERSION_SIM); }
+    }
+
+    // Come back after a quantum, or exactly at the next event if this is the only thread
+    // running.
+    UINT64 until_event = next_event > insn_count ? next_event - insn_count : 1;
+    FastForward::checkAgainIn(t_id, std::min(COUNT_QUANTUM, until_event));
+    PIN_ReleaseLock(&countLock);
+}
+
+// Inlined predicate guarding every simulation call.
+static ADDRINT PIN_FAST_ANALYSIS_CALL isSimulating()
+{
+    return start_sim;
+}
+
+// Per-thread trace state, padded to a cache line so that threads never share one: the line
+// being formatted, and the instructions since the thread's last memory access.
+struct Thread_Trace
+{
+    std::string line;
+    UINT64 num_exes_before_mem = 0;
+    UINT8 pad[64 - sizeof(std::string) - sizeof(UINT64)];
+};
+static Thread_Trace thread_traces[PIN_MAX_THREADS];
+
+// With -bp_threads, every thread is a producer of the ensemble, with its own batches; its lock
+// is only taken by stopTrace() otherwise. Without, the predictor is shared and predict() is not
+// thread-safe: the branches of all the threads go through it one at a time, under bpLock.
+// Once stopTrace() has stopped a thread, its branches left are not predicted.
+struct alignas(64) Thread_BP
+{
+    PIN_LOCK lock;
+    bool stopped = false;
+};
+static Thread_BP thread_bps[PIN_MAX_THREADS];
+static PIN_LOCK bpLock;
+static bool bp_stopped = false;
+
+// Function: branch predictor simulation
+static void bpSim(THREADID t_id, ADDRINT eip, BOOL taken, ADDRINT target)
+{
+    thread_traces[t_id].num_exes_before_mem++;
 
     Instruction instr;
 
@@ -133,24 +229,55 @@ static void bpSim(ADDRINT eip, BOOL taken, ADDRINT target)
     instr.setBranch();
     instr.setTaken(taken);
 
-    // Sending to the branch predictor.
-    bp->predict(instr, insn_count); // I'm using insn_count as time-stamp.
+    // Sending to the branch predictor, I'm using insn_count as time-stamp.
+    if (bp_ensemble != nullptr && bp_ensemble->isSharded())
+    {
+        Thread_BP &thread_bp = thread_bps[t_id];
+        PIN_GetLock(&thread_bp.lock, t_id + 1);
+        if (!thread_bp.stopped) { bp_ensemble->predict(t_id, instr, insn_count); }
+        PIN_ReleaseLock(&thread_bp.lock);
+        return;
+    }
+
+    PIN_GetLock(&bpLock, t_id + 1);
+    if (!bp_stopped) { bp->predict(instr, insn_count); }
+    PIN_ReleaseLock(&bpLock);
 }
 
 // Function: memory access simulation
-static void memAccessSim(ADDRINT eip, bool is_store, ADDRINT mem_addr, UINT32 payload_size)
+// Writes a trace line, see -trace_tid.
+static void memAccessSim(THREADID t_id,
+                         ADDRINT eip, bool is_store, ADDRINT mem_addr, UINT32 payload_size)
 {
-    if (!start_sim) { return; }
+    Thread_Trace &thread_trace = thread_traces[t_id];
+    std::string &line = thread_trace.line;
+    line.clear();
 
-    if (num_exes_before_mem != 0)
+    if (TraceTid.Value())
     {
-        trace_out << num_exes_before_mem << " ";
-        num_exes_before_mem = 0;
+        Trace::Record record;
+        record.tid = t_id;
+        record.count = thread_trace.num_exes_before_mem;
+        record.eip = eip;
+        record.type = is_store ? Trace::Type::STORE : Trace::Type::LOAD;
+        record.addr = mem_addr;
+        Trace::formatText(record, line);
     }
-    trace_out << eip << " ";
-    if (is_store) { trace_out << "S "; }
-    else { trace_out << "L "; }
-    trace_out << mem_addr << "\n";
+    else
+    {
+        if (thread_trace.num_exes_before_mem != 0)
+        {
+            Trace::appendUInt(line, thread_trace.num_exes_before_mem);
+            line += ' ';
+        }
+        Trace::appendUInt(line, eip);
+        line += is_store ? " S " : " L ";
+        Trace::appendUInt(line, mem_addr);
+        line += '\n';
+    }
+    thread_trace.num_exes_before_mem = 0;
+
+    trace_out.write(line, t_id);
     return;
 
     Request req;
@@ -176,42 +303,45 @@ static void memAccessSim(ADDRINT eip, bool is_store, ADDRINT mem_addr, UINT32 pa
 }
 
 //Function: Other function
-static void nonBranchNorMem()
+static void nonBranchNorMem(THREADID t_id)
 {
-    if (!start_sim) { return; }
-
-    num_exes_before_mem++;
+    thread_traces[t_id].num_exes_before_mem++;
     return;
 
 //    std::cout << insn_count << ": E\n";
 }
 
-// "Main" function: decode and simulate the instruction
+// "Main" function: decode and simulate the instruction (simulation version only)
 static void instructionSim(INS ins)
 {
-    // Step one, increment instruction count.
-    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)increCount, IARG_END);
+    // Step one, instruction count is incremented per basic block, see traceCallback().
 
-    // Step two, decode and simulate instruction.
-    if (INS_IsBranch(ins) && INS_HasFallThrough(ins))
+    // Step two, decode and simulate instruction (branches are counted as the others without -bp).
+    if (bp != nullptr && INS_IsBranch(ins) && INS_HasFallThrough(ins))
     {
         // Why two calls for a branch?
         // A branch has two path: a taken path and a fall-through path.
-        INS_InsertCall(
+        INS_InsertIfCall(ins, IPOINT_TAKEN_BRANCH, (AFUNPTR)isSimulating,
+                         IARG_FAST_ANALYSIS_CALL, IARG_END);
+        INS_InsertThenCall(
             ins,
             IPOINT_TAKEN_BRANCH, // Insert a call on the taken edge 
                                  // of the control-flow instruction
             (AFUNPTR)bpSim,
+            IARG_THREAD_ID,
             IARG_ADDRINT, INS_Address(ins),
             IARG_BOOL, TRUE,
             IARG_BRANCH_TARGET_ADDR,
             IARG_END);
 
-        INS_InsertCall(
+        INS_InsertIfCall(ins, IPOINT_AFTER, (AFUNPTR)isSimulating,
+                         IARG_FAST_ANALYSIS_CALL, IARG_END);
+        INS_InsertThenCall(
             ins,
             IPOINT_AFTER, // Insert a call on the fall-through path of 
                           // the last instruction of the instrumented object
             (AFUNPTR)bpSim,
+            IARG_THREAD_ID,
             IARG_ADDRINT, INS_Address(ins),
             IARG_BOOL, FALSE,
             IARG_BRANCH_TARGET_ADDR,
@@ -231,10 +361,13 @@ static void instructionSim(INS ins)
 
             if (INS_MemoryOperandIsRead(ins, i))
             {
-                INS_InsertPredicatedCall(
+                INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)isSimulating,
+                                           IARG_FAST_ANALYSIS_CALL, IARG_END);
+                INS_InsertThenPredicatedCall(
                     ins,
                     IPOINT_BEFORE,
                     (AFUNPTR)memAccessSim,
+                    IARG_THREAD_ID,
                     IARG_ADDRINT, INS_Address(ins),
                     IARG_BOOL, FALSE,
                     IARG_MEMORYOP_EA, i,
@@ -244,10 +377,13 @@ static void instructionSim(INS ins)
 
             if (INS_MemoryOperandIsWritten(ins, i))
             {
-                INS_InsertPredicatedCall(
+                INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)isSimulating,
+                                           IARG_FAST_ANALYSIS_CALL, IARG_END);
+                INS_InsertThenPredicatedCall(
                     ins,
                     IPOINT_BEFORE,
                     (AFUNPTR)memAccessSim,
+                    IARG_THREAD_ID,
                     IARG_ADDRINT, INS_Address(ins),
                     IARG_BOOL, TRUE,
                     IARG_MEMORYOP_EA, i,
@@ -258,7 +394,10 @@ static void instructionSim(INS ins)
     }
     else
     {
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)nonBranchNorMem, IARG_END);
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)isSimulating,
+                         IARG_FAST_ANALYSIS_CALL, IARG_END);
+        INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)nonBranchNorMem, IARG_THREAD_ID,
+                           IARG_END);
     }
 }
 
@@ -268,26 +407,72 @@ static void traceCallback(TRACE trace, VOID *v)
 
     for (BBL bbl = bbl_head; BBL_Valid(bbl); bbl = BBL_Next(bbl))
     {
-        for(INS ins = BBL_InsHead(bbl); ; ins = INS_Next(ins))
+        // Count the whole basic block once, at its first instruction.
+        FastForward::insertCount(bbl, (AFUNPTR)foldCount);
+
+        if (TRACE_Version(trace) == VERSION_SIM)
         {
-            instructionSim(ins);
-            if (ins == BBL_InsTail(bbl))
+            for(INS ins = BBL_InsHead(bbl); ; ins = INS_Next(ins))
             {
-                break;
+                instructionSim(ins);
+                if (ins == BBL_InsTail(bbl))
+                {
+                    break;
+                }
             }
         }
+
+        FastForward::insertVersionSwitch(trace, bbl);
+    }
+}
+
+static void stopTrace(VOID *v)
+{
+    trace_out.stop(PIN_ThreadId());
+
+    // The internal threads must be gone before Fini, and must not be handed branches after
+    // finish(): stop every thread (hand over what it has left), then the workers.
+    PIN_GetLock(&bpLock, PIN_ThreadId() + 1);
+    bp_stopped = true;
+    PIN_ReleaseLock(&bpLock);
+    if (bp_ensemble != nullptr && bp_ensemble->isSharded())
+    {
+        for (UINT32 t_id = 0; t_id < PIN_MAX_THREADS; t_id++)
+        {
+            Thread_BP &thread_bp = thread_bps[t_id];
+            PIN_GetLock(&thread_bp.lock, PIN_ThreadId() + 1);
+            thread_bp.stopped = true;
+            bp_ensemble->finish(t_id);
+            PIN_ReleaseLock(&thread_bp.lock);
+        }
+        bp_ensemble->finish();
+    }
+    for (auto uid : bp_worker_uids)
+    {
+        INT32 exit_code;
+        PIN_WaitForThreadTermination(uid, PIN_INFINITE_TIMEOUT, &exit_code);
     }
 }
 
+static void closeTrace(int code, VOID *v)
+{
+    trace_out.close(PIN_ThreadId());
+}
+
 static void printResults(int dummy, VOID *p)
 {
-    /*
-    // Print phase stats.
+    if (bp == nullptr) { return; }
+
+    // Print the branch predictor stats.
     Stats stat;
     stat.registerStats("Number of instructions: " 
                        + to_string(insn_count));
 
     bp->registerStats(stat);
+    stat.outputStats(StatsOut.Value());
+
+    // The MMU and the caches are not fed while tracing, see memAccessSim().
+    /*
     mmu->registerStats(stat);
 
     for (auto cache : l1) { cache->registerStats(stat); }
@@ -307,6 +492,10 @@ static void printResults(int dummy, VOID *p)
 int
 main(int argc, char *argv[])
 {
+    PIN_InitLock(&countLock);
+    PIN_InitLock(&bpLock);
+    for (auto &thread_bp : thread_bps) { PIN_InitLock(&thread_bp.lock); }
+
     PIN_InitSymbols(); // Initialize all the PIN API functions
 
     // Initialize PIN, e.g., process command line options
@@ -317,6 +506,8 @@ main(int argc, char *argv[])
     assert(!CfgFile.Value().empty());
     assert(!TraceOut.Value().empty());
 
+    FastForward::init(NUM_VERSIONS);
+
     // Read configuration files
     cfg = new Config(CfgFile.Value());
     NUM_CORES = cfg->num_cores;
@@ -459,6 +650,7 @@ main(int argc, char *argv[])
         { prof_cfg << "eDRAM-Cache is private (per core). \n\n"; }
         else { prof_cfg << "eDRAM-Cache is shared. \n\n"; }
     }
+    prof_cfg << "Branch predictor: " << cfg->branch_predictor << "\n";
     prof_cfg.close();
 
     // TODO, Connecting all levels of caches. Still testing CacheSim...
@@ -469,12 +661,65 @@ main(int argc, char *argv[])
     // l1[0]->setNextLevel(l2[0]);
     // l2[0]->setNextLevel(eDRAM[0]);
 
-    trace_out.open(TraceOut.Value().c_str());
+    // Compressed traces of the Trace format start with a file header (LZ frames of text lines).
+    std::string file_header;
+    if (CompressTrace.Value() && TraceTid.Value())
+    {
+        Trace::File_Header header;
+        header.flags = Trace::FLAG_COMPRESSED | Trace::FLAG_TEXT;
+        file_header.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    if (!trace_out.open(TraceOut.Value(), CompressTrace.Value(), file_header))
+    {
+        std::cerr << "[PINTOOL] Error: could not open the trace output." << std::endl;
+        PIN_ExitProcess(1);
+    }
 //    mkdir("page_profiling", S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 //    mkdir("phase_stats", S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 
-    // Let's keep tournament fixed.
-    bp = new BP::Two_Bit_Local();
+    if (SimBP.Value())
+    {
+        if (cfg->branch_predictor.find(',') == std::string::npos && !BPThreads.Value())
+        {
+            bp = BP::createBranchPredictor(cfg->branch_predictor, cfg->tage, cfg->perceptron);
+            if (bp == nullptr)
+            {
+                std::cerr << "[PINTOOL] Error: unknown branch predictor "
+                          << cfg->branch_predictor << "." << std::endl;
+                PIN_ExitProcess(1);
+            }
+        }
+        else
+        {
+            std::string unknown;
+            bp_ensemble = BP::createEnsemble(cfg->branch_predictor, unknown, cfg->tage,
+                                             cfg->perceptron);
+            if (bp_ensemble == nullptr)
+            {
+                std::cerr << "[PINTOOL] Error: unknown branch predictor " << unknown << "."
+                          << std::endl;
+                PIN_ExitProcess(1);
+            }
+            if (BPThreads.Value())
+            {
+                bp_ensemble->shard(PIN_MAX_THREADS);
+                for (unsigned w = 0; w < bp_ensemble->size(); w++)
+                {
+                    PIN_THREAD_UID uid;
+                    if (PIN_SpawnInternalThread(BP::Predictor_Ensemble::workerMain,
+                                                bp_ensemble->workerArg(w), 0, &uid)
+                        == INVALID_THREADID)
+                    {
+                        std::cerr << "[PINTOOL] Error: could not spawn a branch predictor "
+                                  << "thread." << std::endl;
+                        PIN_ExitProcess(1);
+                    }
+                    bp_worker_uids.push_back(uid);
+                }
+            }
+            bp = bp_ensemble;
+        }
+    }
 
     // Simulate each instruction, to eliminate overhead, we are using Trace-based call back.
     TRACE_AddInstrumentFunction(traceCallback, 0);
@@ -482,6 +727,10 @@ main(int argc, char *argv[])
     // Print stats
     PIN_AddFiniFunction(printResults, 0);
 
+    // Drain and close the trace.
+    PIN_AddPrepareForFiniFunction(stopTrace, 0);
+    PIN_AddFiniFunction(closeTrace, 0);
+
     /* Never returns */
     PIN_StartProgram();
 
@@ -2,6 +2,7 @@
 #define __TOURNAMENT_HH__
 
 #include "../branch_predictor.hh"
+#include "../packed_counter_table.hh"
 
 #include <vector>
 
@@ -12,7 +13,7 @@ class Tournament : public Branch_Predictor
   public:
     Tournament() : local_predictor_size(CONSTANTS::localPredictorSize),
                    local_predictor_mask(local_predictor_size - 1),
-                   local_counters(local_predictor_size, CONSTANTS::localCounterBits),
+                   local_counters(local_predictor_size),
                    
                    local_history_table_size(CONSTANTS::localHistoryTableSize),
                    local_history_table_mask(local_history_table_size - 1),
@@ -20,11 +21,11 @@ class Tournament : public Branch_Predictor
 
                    global_predictor_size(CONSTANTS::globalPredictorSize),
                    global_history_mask(global_predictor_size - 1),
-                   global_counters(global_predictor_size, CONSTANTS::globalCounterBits),
+                   global_counters(global_predictor_size),
 
                    choice_predictor_size(CONSTANTS::choicePredictorSize),
                    choice_history_mask(choice_predictor_size - 1),
-                   choice_counters(choice_predictor_size, CONSTANTS::choiceCounterBits),
+                   choice_counters(choice_predictor_size),
 
                    global_history(0),
                    history_register_mask(choice_predictor_size - 1)
@@ -47,17 +48,17 @@ class Tournament : public Branch_Predictor
         unsigned local_predictor_index = local_history_table[local_history_table_index] & 
             local_predictor_mask; // local history, should be updated as well.
 
-        bool local_prediction = local_counters[local_predictor_index].predict();
+        bool local_prediction = local_counters.predict(local_predictor_index);
 
         // Step two, get global prediction.
         unsigned global_predictor_index = global_history & global_history_mask;
 
-        bool global_prediction = global_counters[global_predictor_index].predict();
+        bool global_prediction = global_counters.predict(global_predictor_index);
 
         // Step three, get choice prediction.
         unsigned choice_predictor_index = global_history & choice_history_mask;
 
-        bool choice_prediction = choice_counters[choice_predictor_index].predict();
+        bool choice_prediction = choice_counters.predict(choice_predictor_index);
 
         // Step four, final prediction.
         bool final_prediction;
@@ -79,25 +80,17 @@ class Tournament : public Branch_Predictor
             if (local_prediction == instr.taken)
             {
                 // Should be more favorable towards local predictor.
-                choice_counters[choice_predictor_index].decrement();
+                choice_counters.decrement(choice_predictor_index);
             }
             else if (global_prediction == instr.taken)
             {
                 // Should be more favorable towards global predictor.
-                choice_counters[choice_predictor_index].increment();
+                choice_counters.increment(choice_predictor_index);
             }
         }
 
-        if (instr.taken)
-        {
-            global_counters[global_predictor_index].increment();
-            local_counters[local_predictor_index].increment();
-        }
-        else
-        {
-            global_counters[global_predictor_index].decrement();
-            local_counters[local_predictor_index].decrement(); 
-        } 
+        global_counters.update(global_predictor_index, instr.taken);
+        local_counters.update(local_predictor_index, instr.taken);
 
         // Step six, update global history register
         global_history = global_history << 1 | instr.taken;
@@ -108,7 +101,7 @@ class Tournament : public Branch_Predictor
   protected:
     unsigned local_predictor_size;
     unsigned local_predictor_mask;
-    std::vector<Sat_Counter> local_counters;
+    PackedCounterTable<CONSTANTS::localCounterBits> local_counters;
 
     unsigned local_history_table_size;
     unsigned local_history_table_mask;
@@ -116,11 +109,11 @@ class Tournament : public Branch_Predictor
 
     unsigned global_predictor_size;
     unsigned global_history_mask;
-    std::vector<Sat_Counter> global_counters;
+    PackedCounterTable<CONSTANTS::globalCounterBits> global_counters;
 
     unsigned choice_predictor_size;
     unsigned choice_history_mask;
-    std::vector<Sat_Counter> choice_counters;
+    PackedCounterTable<CONSTANTS::choiceCounterBits> choice_counters;
 
     uint64_t global_history;
     unsigned history_register_mask;
@@ -2,6 +2,7 @@
 #define __TWO_BIT_LOCAL_HH__
 
 #include "../branch_predictor.hh"
+#include "../packed_counter_table.hh"
 
 #include <vector>
 
@@ -12,7 +13,7 @@ class Two_Bit_Local : public Branch_Predictor
   public:
     Two_Bit_Local(): local_predictor_size(CONSTANTS::localPredictorSize),
                      index_mask(local_predictor_size - 1),
-                     local_counters(local_predictor_size, CONSTANTS::localCounterBits)
+                     local_counters(local_predictor_size)
     {
         assert(checkPowerofTwo(local_predictor_size));
     }
@@ -24,33 +25,19 @@ class Two_Bit_Local : public Branch_Predictor
         // Step one, get prediction
         unsigned local_index = (branch_addr >> instShiftAmt) & index_mask;
 
-        bool prediction = local_counters[local_index].predict();
+        bool prediction = local_counters.predict(local_index);
         if (prediction == instr.taken) { ++num_correct_preds; }
         else { ++num_incorrect_preds; }
 
         // Step two, update counter
-        if (instr.taken)
-        {
-            // std::cout << "Correct! ";
-            // std::cout << int(local_counters[local_index].val) << " -> ";
-            local_counters[local_index].increment();
-            // std::cout << int(local_counters[local_index].val) << "\n";
-        }
-        else
-        {
-            // std::cout << "Incorrect! "; 
-            // std::cout << int(local_counters[local_index].val) << " -> ";
-            local_counters[local_index].decrement();
-            // std::cout << int(local_counters[local_index].val) << "\n";
-        }
+        local_counters.update(local_index, instr.taken);
     }
 
   protected:
     const unsigned local_predictor_size; // Number of entries in a local predictor
     const unsigned index_mask;
 
-    // It seems that PIN does not support C++11. :( 
-    std::vector<Sat_Counter> local_counters;
+    PackedCounterTable<CONSTANTS::localCounterBits> local_counters;
 };
 }
 
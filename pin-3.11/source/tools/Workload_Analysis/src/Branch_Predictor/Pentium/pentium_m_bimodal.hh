@@ -2,6 +2,7 @@
 #define __PENTIUM_M_BIMODAL_HH__
 
 #include "../branch_predictor.hh"
+#include "../packed_counter_table.hh"
 
 #include <vector>
 
@@ -10,13 +11,13 @@ namespace BP
 class Pentium_M_Bimodal : public Branch_Predictor
 {
   public:
-    Pentium_M_Bimodal() : index_mask(NUM_ENTRIES - 1), local_counters(NUM_ENTRIES, 2) {}
+    Pentium_M_Bimodal() : index_mask(NUM_ENTRIES - 1), local_counters(NUM_ENTRIES) {}
 
     int lookup(Addr pc, Count timer)
     { 
         unsigned local_index = pc & index_mask;
 
-        bool prediction = local_counters[local_index].predict();
+        bool prediction = local_counters.predict(local_index);
 
         return prediction; 
     }
@@ -25,27 +26,14 @@ class Pentium_M_Bimodal : public Branch_Predictor
     {
         unsigned local_index = pc & index_mask;
 
-        if (actual)
-        {
-            // std::cout << "Correct! ";
-            // std::cout << int(local_counters[local_index].val) << " -> ";
-            local_counters[local_index].increment();
-            // std::cout << int(local_counters[local_index].val) << "\n";
-        }
-        else
-        {
-            // std::cout << "Incorrect! "; 
-            // std::cout << int(local_counters[local_index].val) << " -> ";
-            local_counters[local_index].decrement();
-            // std::cout << int(local_counters[local_index].val) << "\n";
-        }
+        local_counters.update(local_index, actual);
     }
 
   protected:
     static const unsigned NUM_ENTRIES = 4096;
     const unsigned index_mask;
 
-    std::vector<Sat_Counter> local_counters;
+    PackedCounterTable<2> local_counters;
 
 };
 }
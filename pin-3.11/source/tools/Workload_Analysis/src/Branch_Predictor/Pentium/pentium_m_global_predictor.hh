@@ -2,6 +2,7 @@
 #define __PENTIUM_M_GLOBAL_PREDICTOR_HH__
 
 #include "../branch_predictor.hh"
+#include "../packed_counter_table.hh"
 
 #include <vector>
 
@@ -14,7 +15,8 @@ namespace BP
 class Pentium_M_Global_Predictor : public Branch_Predictor
 {
   public:
-    Pentium_M_Global_Predictor() : sets(NUM_ENTRIES / NUM_WAYS, NUM_WAYS)
+    Pentium_M_Global_Predictor() : sets(NUM_ENTRIES / NUM_WAYS, NUM_WAYS),
+                                   counters(NUM_ENTRIES)
     {}
 
     int lookup(Addr pc, Addr pir, Count timer)
@@ -27,7 +29,7 @@ class Pentium_M_Global_Predictor : public Branch_Predictor
         {
             if (sets[index].ways[w].valid && sets[index].ways[w].tag == tag)
             {
-                return sets[index].ways[w].predict();
+                return counters.predict(index * NUM_WAYS + w);
             }
         }
 
@@ -63,8 +65,7 @@ class Pentium_M_Global_Predictor : public Branch_Predictor
         {
             if (sets[index].ways[w].valid && sets[index].ways[w].tag == tag)
             {
-                if (actual) { sets[index].ways[w].increment(); }
-                else { sets[index].ways[w].decrement(); }
+                counters.update(index * NUM_WAYS + w, actual);
 
                 sets[index].ways[w].lru = timer;
 
@@ -77,25 +78,17 @@ class Pentium_M_Global_Predictor : public Branch_Predictor
             }
         }
 
-        sets[index].ways[lru_way].init(tag, timer, actual);
+        sets[index].ways[lru_way].init(tag, timer);
+        counters.set(index * NUM_WAYS + lru_way, actual ? counters.MAX : 0);
     }
 
   protected:
     class Way
     {
       public:
-        Way() : sat_counter(2), valid(false), lru(0) {}
-        
-        bool predict() { return sat_counter.predict(); }
-        void increment() { sat_counter.increment(); }
-        void decrement() { sat_counter.decrement(); }
+        Way() : valid(false), lru(0) {}
 
-        void init(Addr _tag, Count timer, bool actual) 
-        { valid = true; tag = tag; lru = timer;
-          if (actual) { sat_counter.val = sat_counter.max_val; }
-          else { sat_counter.val = 0; } }
-
-        Sat_Counter sat_counter; // Each way has a counter;
+        void init(Addr _tag, Count timer) { valid = true; tag = tag; lru = timer; }
 
         bool valid; // Is the way valid?
         Addr tag; // Tag of the way.
@@ -111,6 +104,9 @@ class Pentium_M_Global_Predictor : public Branch_Predictor
     };
     std::vector<Set> sets;
 
+    // The counter of each way, way w of set s at s * NUM_WAYS + w.
+    PackedCounterTable<2> counters;
+
     static const unsigned NUM_ENTRIES = 2048;
     static const unsigned TAG_BITS = 6;
     static const unsigned NUM_WAYS = 4;
@@ -2,6 +2,7 @@
 #define __PENTIUM_M_LOOP_PREDICTOR_HH__
 
 #include "../branch_predictor.hh"
+#include "../packed_counter_table.hh"
 
 #include <vector>
 
@@ -13,7 +14,8 @@ namespace BP
 class Pentium_M_Loop_Branch_Predictor : public Branch_Predictor
 {
   public:
-    Pentium_M_Loop_Branch_Predictor() : sets(NUM_ENTRIES / NUM_WAYS, NUM_WAYS)
+    Pentium_M_Loop_Branch_Predictor() : sets(NUM_ENTRIES / NUM_WAYS, NUM_WAYS),
+                                        counters(NUM_ENTRIES)
     {
     }
 
@@ -33,11 +35,11 @@ class Pentium_M_Loop_Branch_Predictor : public Branch_Predictor
 
                 if (sets[index].ways[w].count == sets[index].ways[w].limit)
                 {
-                    return !sets[index].ways[w].predict();
+                    return !counters.predict(index * NUM_WAYS + w);
                 }
                 else
                 {
-                    return sets[index].ways[w].predict();
+                    return counters.predict(index * NUM_WAYS + w);
                 }
             }
         }
@@ -61,7 +63,7 @@ class Pentium_M_Loop_Branch_Predictor : public Branch_Predictor
         {
             if (sets[index].ways[w].valid && sets[index].ways[w].tag == tag)
             {
-                bool current_prediction = sets[index].ways[w].predict();
+                bool current_prediction = counters.predict(index * NUM_WAYS + w);
                 bool match = prediction_match(w, index, actual);
                 bool previous_actual = sets[index].ways[w].prev_actual;
                 Count &next_counter = sets[index].ways[w].count;
@@ -125,8 +127,7 @@ class Pentium_M_Loop_Branch_Predictor : public Branch_Predictor
                     next_limit = 1;
 
                     // Update the predictor
-                    if (actual) { sets[index].ways[w].increment(); }
-                    else { sets[index].ways[w].decrement(); }
+                    counters.update(index * NUM_WAYS + w, actual);
 
                     // Disable the entry since we have just started to look in another direction
                     next_enabled = false;
@@ -175,6 +176,7 @@ class Pentium_M_Loop_Branch_Predictor : public Branch_Predictor
             }
         }
         sets[index].ways[lru_way].init(tag, timer, actual);
+        counters.set(index * NUM_WAYS + lru_way, actual);
     }
 
   protected:
@@ -186,19 +188,10 @@ class Pentium_M_Loop_Branch_Predictor : public Branch_Predictor
     class Way
     {
       public:
-        // We are using 1-bit counter here.
-        Way() : sat_counter(1), valid(false), lru(0) {}
-
-        bool predict() { return sat_counter.predict(); }
-        void increment() { sat_counter.increment(); }
-        void decrement() { sat_counter.decrement(); }
+        Way() : valid(false), lru(0) {}
 
         void init(Addr _tag, Count timer, bool actual)
-        { valid = true; tag = tag; lru = timer; count = 1; limit = 1; prev_actual = actual;
-          if (actual) { sat_counter.val = sat_counter.max_val; }
-          else { sat_counter.val = 0; } }
-
-        Sat_Counter sat_counter; // Each way has a counter;
+        { valid = true; tag = tag; lru = timer; count = 1; limit = 1; prev_actual = actual; }
 
         bool valid;
         Addr tag; // Tag of the way.
@@ -220,6 +213,9 @@ class Pentium_M_Loop_Branch_Predictor : public Branch_Predictor
     };
     std::vector<Set> sets;
 
+    // The counter of each way (1-bit), way w of set s at s * NUM_WAYS + w.
+    PackedCounterTable<1> counters;
+
     // Pentium M-specific indexing and tag values
     void gen_index_tag(Addr pc, Addr &index, Addr &tag)
     {
@@ -231,7 +227,7 @@ class Pentium_M_Loop_Branch_Predictor : public Branch_Predictor
     //                    (2) predict outcome correctly;
     bool prediction_match(unsigned way, Addr index, bool actual)
     {
-        bool prediction = sets[index].ways[way].predict();
+        bool prediction = counters.predict(index * NUM_WAYS + way);
         Count count = sets[index].ways[way].count;
         Count limit = sets[index].ways[way].limit;
 
@@ -0,0 +1,113 @@
+#ifndef __HASHED_PERCEPTRON_HH__
+#define __HASHED_PERCEPTRON_HH__
+
+#include "../branch_predictor.hh"
+#include "../branch_predictor_params.hh"
+#include "../branch_history.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace BP
+{
+// The hashed perceptron (Tarjan and Skadron), with the history lengths of O-GEHL (Seznec):
+// num_tables tables of signed weights, table 0 indexed by the PC and table i by the PC hashed
+// with the last hist_lengths[i] directions, geometric up to max_hist. The prediction is the sign
+// of the sum of the weights; they train on a misprediction, or when the sum is within theta, and
+// theta adapts to balance the two (as in O-GEHL).
+class Hashed_Perceptron : public Branch_Predictor
+{
+  public:
+    Hashed_Perceptron(const Perceptron_Params &_params = Perceptron_Params())
+        : params(_params),
+          weight_max((1 << (params.weight_bits - 1)) - 1),
+          weight_min(-(1 << (params.weight_bits - 1))),
+          weights(params.num_tables, std::vector<int8_t>(size_t(1) << params.table_bits, 0)),
+          hist_lengths(params.num_tables, 0),
+          folds(params.num_tables),
+          indices(params.num_tables),
+          history(params.max_hist),
+          theta(params.num_tables)
+    {
+        assert(params.num_tables > 1 && params.table_bits < 24 && params.max_hist > 0);
+        assert(params.weight_bits > 1 && params.weight_bits <= 8);
+
+        for (unsigned i = 1; i < params.num_tables; i++)
+        {
+            double ratio = double(params.max_hist);
+            unsigned length = unsigned(pow(ratio, double(i) / (params.num_tables - 1)) + 0.5);
+            hist_lengths[i] = std::max(length, hist_lengths[i - 1] + 1);
+            folds[i] = Folded_History(hist_lengths[i], params.table_bits);
+        }
+    }
+
+    void predict(Instruction &instr, Count timer) override
+    {
+        Addr pc = instr.PC >> instShiftAmt;
+        bool taken = instr.taken;
+
+        unsigned mask = (1u << params.table_bits) - 1;
+        int sum = 0;
+        for (unsigned i = 0; i < params.num_tables; i++)
+        {
+            unsigned hash = unsigned(pc ^ (pc >> params.table_bits)) ^ folds[i].value() ^
+                            (i * 0x9e37u);
+            indices[i] = hash & mask;
+            sum += weights[i][indices[i]];
+        }
+        bool pred = sum >= 0;
+
+        if (pred == taken) { ++num_correct_preds; }
+        else { ++num_incorrect_preds; }
+
+        if (pred != taken || std::abs(sum) <= theta)
+        {
+            for (unsigned i = 0; i < params.num_tables; i++)
+            {
+                satUpdate(weights[i][indices[i]], taken, weight_min, weight_max);
+            }
+
+            // Adaptive threshold.
+            if (pred != taken)
+            {
+                if (++theta_ctr >= THETA_CTR_MAX)
+                {
+                    theta++;
+                    theta_ctr = 0;
+                }
+            }
+            else
+            {
+                if (--theta_ctr <= -THETA_CTR_MAX)
+                {
+                    if (theta > 0) { theta--; }
+                    theta_ctr = 0;
+                }
+            }
+        }
+
+        history.push(taken);
+        for (unsigned i = 1; i < params.num_tables; i++) { folds[i].update(history); }
+    }
+
+  protected:
+    static constexpr int THETA_CTR_MAX = 64;
+
+    const Perceptron_Params params;
+    const int weight_max;
+    const int weight_min;
+
+    std::vector<std::vector<int8_t>> weights;
+    std::vector<unsigned> hist_lengths;
+    std::vector<Folded_History> folds; // folds[0] is empty, table 0 is by the PC only.
+    std::vector<unsigned> indices; // Of the current branch.
+
+    Global_History history;
+    int theta;
+    int theta_ctr = 0;
+};
+}
+
+#endif
@@ -0,0 +1,436 @@
+#ifndef __TAGE_SC_L_HH__
+#define __TAGE_SC_L_HH__
+
+#include "../branch_predictor.hh"
+#include "../branch_predictor_params.hh"
+#include "../branch_history.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace BP
+{
+// TAGE-SC-L (Seznec, CBP-5), scaled down to its three components:
+//     1) TAGE: a bimodal base predictor and num_tables partially tagged tables indexed with the
+//        PC and geometrically longer global histories (plus path history). The longest hit
+//        provides the prediction, but a newly allocated (weak, useless) entry defers to the
+//        next hit (use_alt_on_na). A misprediction allocates an entry in a longer table;
+//        the usefulness bits age every U_RESET_PERIOD branches.
+//     2) SC, the statistical corrector: a bias table (PC and TAGE prediction) and GEHL-like
+//        tables on short global histories, summed; it reverts the TAGE prediction when the sum
+//        disagrees beyond an adaptive threshold.
+//     3) L, the loop predictor: counts the iterations of the branches with a constant trip
+//        count, and predicts their exit once confident.
+// The sizes of the tables come from TAGE_Params.
+class TAGE_SC_L : public Branch_Predictor
+{
+  public:
+    TAGE_SC_L(const TAGE_Params &_params = TAGE_Params())
+        : params(_params),
+          base(size_t(1) << params.base_bits, 2),
+          tables(params.num_tables),
+          history(params.max_hist),
+          sc_tables(SC_NUM_TABLES, std::vector<int8_t>(size_t(1) << params.sc_table_bits, 0)),
+          sc_indices(SC_NUM_TABLES),
+          loops(params.loop_bits == 0 ? 0 : size_t(1) << params.loop_bits)
+    {
+        assert(params.num_tables > 1 && params.min_hist > 0 && params.max_hist > params.min_hist);
+        assert(params.table_bits < 24 && params.base_bits < 30 && params.sc_table_bits < 24);
+        assert(params.min_tag_bits > 0 && params.max_tag_bits >= params.min_tag_bits &&
+               params.max_tag_bits <= 16);
+
+        for (unsigned i = 0; i < params.num_tables; i++)
+        {
+            Tagged_Table &table = tables[i];
+            double ratio = double(params.max_hist) / params.min_hist;
+            unsigned hist_length = unsigned(params.min_hist *
+                                            pow(ratio, double(i) / (params.num_tables - 1)) +
+                                            0.5);
+            unsigned tag_bits = params.min_tag_bits + (params.max_tag_bits -
+                                                       params.min_tag_bits) * i /
+                                                      (params.num_tables - 1);
+
+            table.entries.resize(size_t(1) << params.table_bits);
+            table.index_fold = Folded_History(hist_length, params.table_bits);
+            table.tag_fold_0 = Folded_History(hist_length, tag_bits);
+            table.tag_fold_1 = Folded_History(hist_length, tag_bits - 1);
+            table.tag_mask = (1u << tag_bits) - 1;
+            table.pc_shift = params.table_bits - i % params.table_bits;
+            table.path_mask = (1u << std::min(hist_length, 16u)) - 1;
+        }
+        sc_threshold = 35;
+    }
+
+    void predict(Instruction &instr, Count timer) override
+    {
+        Addr pc = instr.PC >> instShiftAmt;
+        bool taken = instr.taken;
+
+        // TAGE.
+        unsigned base_index = pc & ((1u << params.base_bits) - 1);
+        bool base_pred = base[base_index] >= 2;
+        computeIndices(pc);
+
+        int provider = -1, alt = -1;
+        for (int i = params.num_tables - 1; i >= 0; i--)
+        {
+            if (tables[i].current().tag != tables[i].tag) { continue; }
+            if (provider < 0) { provider = i; }
+            else
+            {
+                alt = i;
+                break;
+            }
+        }
+
+        bool alt_pred = alt >= 0 ? tables[alt].current().ctr >= 0 : base_pred;
+        bool provider_pred = alt_pred;
+        bool weak_new = false;
+        bool tage_pred = base_pred;
+        int tage_conf = 0; // 0 to 3.
+        if (provider >= 0)
+        {
+            const Tagged_Entry &entry = tables[provider].current();
+            provider_pred = entry.ctr >= 0;
+            weak_new = (entry.ctr == 0 || entry.ctr == -1) && entry.u == 0;
+            tage_pred = weak_new && use_alt_on_na >= 0 ? alt_pred : provider_pred;
+            tage_conf = (std::abs(2 * entry.ctr + 1) - 1) / 2;
+        }
+        else { tage_conf = base[base_index] == 0 || base[base_index] == 3 ? 3 : 0; }
+
+        // SC.
+        bool pred = tage_pred;
+        int sc_sum = 0;
+        bool sc_used = params.sc_table_bits > 0;
+        if (sc_used)
+        {
+            sc_sum = scSum(pc, tage_pred, tage_conf);
+            bool sc_pred = sc_sum >= 0;
+            if (sc_pred != tage_pred && std::abs(sc_sum) >= sc_threshold)
+            {
+                pred = sc_pred;
+                ++num_sc_overrides;
+            }
+        }
+
+        // L.
+        Loop_Entry *loop = nullptr;
+        bool loop_valid = false, loop_pred = false;
+        if (!loops.empty())
+        {
+            loop = &loops[pc & (loops.size() - 1)];
+            if (loop->tag == loopTag(pc))
+            {
+                loop_valid = loop->confidence == LOOP_CONFIDENT;
+                loop_pred = loop->current_iter + 1 == loop->past_iter ? !loop->dir : loop->dir;
+            }
+            else { loop = nullptr; }
+        }
+        if (loop_valid && use_loop >= 0)
+        {
+            if (loop_pred != pred) { ++num_loop_overrides; }
+            pred = loop_pred;
+        }
+
+        if (pred == taken) { ++num_correct_preds; }
+        else { ++num_incorrect_preds; }
+
+        // Updates.
+        if (!loops.empty()) { updateLoop(loop, pc, taken, tage_pred, loop_valid, loop_pred); }
+        if (sc_used) { updateSC(tage_pred, sc_sum, taken); }
+        updateTAGE(provider, alt, base_index, taken, tage_pred, provider_pred, alt_pred,
+                   weak_new);
+        updateHistories(pc, taken);
+    }
+
+    void statsLines(std::vector<std::string> &lines) override
+    {
+        Branch_Predictor::statsLines(lines);
+        lines.push_back(statsName() + ": Number of SC overrides = " +
+                        toString(num_sc_overrides));
+        lines.push_back(statsName() + ": Number of loop overrides = " +
+                        toString(num_loop_overrides));
+    }
+
+    void reInitialize() override
+    {
+        Branch_Predictor::reInitialize();
+        num_sc_overrides = 0;
+        num_loop_overrides = 0;
+    }
+
+  protected:
+    static constexpr int CTR_MAX = 3; // 3-bit signed counters.
+    static constexpr int CTR_MIN = -4;
+    static constexpr unsigned U_MAX = 3;
+    static constexpr unsigned U_RESET_PERIOD = 1 << 18;
+    static constexpr unsigned SC_NUM_TABLES = 4; // The bias table, then the GEHL tables.
+    static constexpr int SC_CTR_MAX = 31; // 6-bit signed counters.
+    static constexpr int SC_CTR_MIN = -32;
+    static constexpr unsigned LOOP_TAG_BITS = 14;
+    static constexpr unsigned LOOP_ITER_MAX = (1 << 14) - 1;
+    static constexpr unsigned LOOP_CONFIDENT = 3;
+    static constexpr unsigned LOOP_AGE_MAX = 7;
+
+    const TAGE_Params params;
+
+    struct Tagged_Entry
+    {
+        int8_t ctr = 0;
+        uint16_t tag = 0;
+        uint8_t u = 0;
+    };
+
+    struct Loop_Entry
+    {
+        uint16_t tag = 0xffff; // Never a 14-bit tag.
+        uint16_t past_iter = 0;
+        uint16_t current_iter = 0;
+        uint8_t confidence = 0;
+        uint8_t age = 0;
+        bool dir = false; // The direction of the iterations (the exit is the other one).
+    };
+
+    std::vector<uint8_t> base;
+    // A tagged table, with what it hashes the PC with, and the index and tag of the current
+    // branch.
+    struct Tagged_Table
+    {
+        std::vector<Tagged_Entry> entries;
+        Folded_History index_fold;
+        Folded_History tag_fold_0;
+        Folded_History tag_fold_1;
+        unsigned tag_mask = 0;
+        unsigned pc_shift = 0;
+        unsigned path_mask = 0;
+
+        unsigned index = 0;
+        uint16_t tag = 0;
+
+        Tagged_Entry &current() { return entries[index]; }
+    };
+    std::vector<Tagged_Table> tables;
+
+    Global_History history;
+    uint64_t recent_history = 0; // The last 64 directions, for the SC.
+    unsigned path_history = 0; // 16 bits of the PCs.
+    int use_alt_on_na = 0; // 4-bit signed.
+    unsigned u_reset_tick = 0;
+    uint32_t rand_state = 0x9e3779b9;
+
+    std::vector<std::vector<int8_t>> sc_tables;
+    std::vector<unsigned> sc_indices;
+    int sc_threshold;
+    int sc_threshold_ctr = 0; // 6-bit signed.
+
+    std::vector<Loop_Entry> loops;
+    int use_loop = -1; // 7-bit signed.
+
+    Count num_sc_overrides = 0;
+    Count num_loop_overrides = 0;
+
+    unsigned random()
+    {
+        rand_state ^= rand_state << 13;
+        rand_state ^= rand_state >> 17;
+        rand_state ^= rand_state << 5;
+        return rand_state;
+    }
+
+    void computeIndices(Addr pc)
+    {
+        unsigned index_mask = (1u << params.table_bits) - 1;
+        for (auto &table : tables)
+        {
+            unsigned path = path_history & table.path_mask;
+            table.index = unsigned(pc ^ (pc >> table.pc_shift) ^ table.index_fold.value() ^
+                                   path ^ (path >> params.table_bits)) &
+                          index_mask;
+            table.tag = uint16_t((pc ^ table.tag_fold_0.value() ^
+                                  (table.tag_fold_1.value() << 1)) &
+                                 table.tag_mask);
+        }
+    }
+
+    void updateTAGE(int provider, int alt, unsigned base_index, bool taken, bool tage_pred,
+                    bool provider_pred, bool alt_pred, bool weak_new)
+    {
+        // Allocation, on a misprediction, in a longer table.
+        if (tage_pred != taken && provider < int(params.num_tables) - 1)
+        {
+            unsigned start = provider + 1 + (random() & 1);
+            bool allocated = false;
+            for (unsigned i = start; i < params.num_tables; i++)
+            {
+                Tagged_Entry &entry = tables[i].current();
+                if (entry.u != 0) { continue; }
+                entry.tag = tables[i].tag;
+                entry.ctr = taken ? 0 : -1;
+                allocated = true;
+                break;
+            }
+            if (!allocated)
+            {
+                for (unsigned i = provider + 1; i < params.num_tables; i++)
+                {
+                    Tagged_Entry &entry = tables[i].current();
+                    if (entry.u > 0) { entry.u--; }
+                }
+            }
+        }
+
+        if (provider >= 0)
+        {
+            Tagged_Entry &entry = tables[provider].current();
+            if (weak_new && provider_pred != alt_pred)
+            {
+                satUpdate(use_alt_on_na, alt_pred == taken, -8, 7);
+            }
+            // A new entry is not trusted yet, its alternate learns too.
+            if (weak_new)
+            {
+                if (alt >= 0) { satUpdate(tables[alt].current().ctr, taken, CTR_MIN, CTR_MAX); }
+                else { satUpdate(base[base_index], taken, 0, 3); }
+            }
+            satUpdate(entry.ctr, taken, CTR_MIN, CTR_MAX);
+            if (provider_pred != alt_pred) { satUpdate(entry.u, provider_pred == taken, 0, U_MAX); }
+        }
+        else { satUpdate(base[base_index], taken, 0, 3); }
+
+        if (++u_reset_tick == U_RESET_PERIOD)
+        {
+            u_reset_tick = 0;
+            for (auto &table : tables)
+            {
+                for (auto &entry : table.entries) { entry.u >>= 1; }
+            }
+        }
+    }
+
+    void updateHistories(Addr pc, bool taken)
+    {
+        history.push(taken);
+        for (auto &table : tables)
+        {
+            unsigned out_bit = history.bit(table.index_fold.historyLength());
+            table.index_fold.update(taken, out_bit);
+            table.tag_fold_0.update(taken, out_bit);
+            table.tag_fold_1.update(taken, out_bit);
+        }
+        recent_history = (recent_history << 1) | taken;
+        path_history = ((path_history << 1) ^ unsigned(pc & 1)) & 0xffff;
+    }
+
+    // The sum of the SC, centered counters (2 * ctr + 1), and the TAGE prediction weighted by
+    // its confidence; sets sc_indices.
+    int scSum(Addr pc, bool tage_pred, int tage_conf)
+    {
+        static const unsigned lengths[SC_NUM_TABLES] = {0, 6, 13, 27};
+        unsigned mask = (1u << params.sc_table_bits) - 1;
+        int sum = (tage_pred ? 1 : -1) * (8 * tage_conf + 4);
+        for (unsigned i = 0; i < SC_NUM_TABLES; i++)
+        {
+            uint64_t hist = recent_history & ((uint64_t(1) << lengths[i]) - 1);
+            uint64_t hash = pc ^ (hist * 0x9e3779b97f4a7c15ULL >> 40) ^ (uint64_t(i) << 7);
+            if (i == 0) { hash = (pc << 1) | tage_pred; }
+            sc_indices[i] = unsigned(hash ^ (hash >> params.sc_table_bits)) & mask;
+            sum += 2 * sc_tables[i][sc_indices[i]] + 1;
+        }
+        return sum;
+    }
+
+    void updateSC(bool tage_pred, int sc_sum, bool taken)
+    {
+        bool sc_pred = sc_sum >= 0;
+        if (sc_pred != tage_pred)
+        {
+            // Adapt the threshold to the overrides that would help.
+            satUpdate(sc_threshold_ctr, sc_pred != taken, -32, 31);
+            if (sc_threshold_ctr == 31)
+            {
+                sc_threshold++;
+                sc_threshold_ctr = 0;
+            }
+            else if (sc_threshold_ctr == -32 && sc_threshold > 6)
+            {
+                sc_threshold--;
+                sc_threshold_ctr = 0;
+            }
+        }
+        if (sc_pred != taken || std::abs(sc_sum) < sc_threshold)
+        {
+            for (unsigned i = 0; i < SC_NUM_TABLES; i++)
+            {
+                satUpdate(sc_tables[i][sc_indices[i]], taken, SC_CTR_MIN, SC_CTR_MAX);
+            }
+        }
+    }
+
+    uint16_t loopTag(Addr pc) const
+    {
+        return uint16_t((pc >> params.loop_bits) & ((1u << LOOP_TAG_BITS) - 1));
+    }
+
+    void updateLoop(Loop_Entry *loop, Addr pc, bool taken, bool tage_pred, bool loop_valid,
+                    bool loop_pred)
+    {
+        if (loop_valid && loop_pred != tage_pred)
+        {
+            satUpdate(use_loop, loop_pred == taken, -64, 63);
+        }
+
+        if (loop == nullptr)
+        {
+            // Allocate on a TAGE misprediction, taking it for a loop exit.
+            if (tage_pred == taken) { return; }
+            Loop_Entry &entry = loops[pc & (loops.size() - 1)];
+            if (entry.age > 0)
+            {
+                entry.age--;
+                return;
+            }
+            entry = Loop_Entry();
+            entry.tag = loopTag(pc);
+            entry.dir = !taken;
+            entry.age = LOOP_AGE_MAX;
+            return;
+        }
+
+        if (loop_valid && loop_pred != taken)
+        {
+            *loop = Loop_Entry(); // Not a loop with a constant trip count after all.
+            return;
+        }
+        if (loop_valid && loop_pred != tage_pred && loop->age < LOOP_AGE_MAX) { loop->age++; }
+
+        if (taken == loop->dir)
+        {
+            if (loop->current_iter < LOOP_ITER_MAX) { loop->current_iter++; }
+            if (loop->past_iter != 0 && loop->current_iter >= loop->past_iter)
+            {
+                // Ran past the trip count.
+                loop->confidence = 0;
+                loop->past_iter = 0;
+            }
+            return;
+        }
+
+        // The exit.
+        unsigned iterations = loop->current_iter + 1;
+        if (iterations == loop->past_iter)
+        {
+            if (loop->confidence < LOOP_CONFIDENT) { loop->confidence++; }
+        }
+        else
+        {
+            loop->past_iter = uint16_t(std::min(iterations, LOOP_ITER_MAX));
+            loop->confidence = 0;
+        }
+        loop->current_iter = 0;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef __BRANCH_HISTORY_HH__
+#define __BRANCH_HISTORY_HH__
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace BP
+{
+// The global history of the branch directions, the newest first: bit(0) is the last branch.
+// A circular buffer of one byte per bit, as the folded histories need the bit leaving them.
+class Global_History
+{
+  public:
+    Global_History(unsigned max_length)
+    {
+        unsigned size = 1;
+        while (size < max_length + 1) { size <<= 1; }
+        bits.assign(size, 0);
+        mask = size - 1;
+    }
+
+    uint8_t bit(unsigned age) const { return bits[(head + age) & mask]; }
+
+    void push(bool taken)
+    {
+        head = (head - 1) & mask;
+        bits[head] = taken;
+    }
+
+  protected:
+    std::vector<uint8_t> bits;
+    unsigned mask;
+    unsigned head = 0;
+};
+
+// The last length bits of a global history, folded (XORed) into width bits, and kept up to
+// date in a few operations per branch (as in TAGE): call update() after every push().
+class Folded_History
+{
+  public:
+    Folded_History() {}
+
+    Folded_History(unsigned _length, unsigned _width)
+        : length(_length), width(_width), out_point(_width == 0 ? 0 : _length % _width)
+    {
+        assert(width < 32);
+    }
+
+    unsigned value() const { return comp; }
+
+    unsigned historyLength() const { return length; }
+
+    void update(const Global_History &history) { update(history.bit(0), history.bit(length)); }
+
+    // With the bit that entered the history, and the one that left the last length bits
+    // (history.bit(length)), for the folds of the same length to read them once.
+    void update(unsigned in_bit, unsigned out_bit)
+    {
+        if (width == 0) { return; }
+        comp = (comp << 1) ^ in_bit;
+        comp ^= out_bit << out_point;
+        comp ^= comp >> width;
+        comp &= (1u << width) - 1;
+    }
+
+  protected:
+    unsigned length = 0;
+    unsigned width = 0;
+    unsigned out_point = 0;
+    unsigned comp = 0;
+};
+
+// Saturating update of a signed counter within [min, max].
+template <typename T>
+inline void satUpdate(T &ctr, bool up, int min, int max)
+{
+    if (up) { if (ctr < max) { ++ctr; } }
+    else { if (ctr > min) { --ctr; } }
+}
+}
+
+#endif
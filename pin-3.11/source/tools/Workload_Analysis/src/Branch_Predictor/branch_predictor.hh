@@ -2,9 +2,11 @@
 #define __BRANCH_PREDICTOR_HH__
 
 #include "branch_predictor_constants.hh"
-#include "../Sim/instruction.hh"
-#include "../Sim/stats.hh"
-#include "../Sim/util.hh"
+#include "instruction.hh"
+
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace BP
 {
@@ -24,11 +26,25 @@ class Branch_Predictor
     float perf() { return float(num_correct_preds) / 
                  (float(num_correct_preds) + float(num_incorrect_preds)) * 100; }
 
-    virtual void registerStats(Stats &stats)
+    // The lines of the stats, see registerStats().
+    virtual void statsLines(std::vector<std::string> &lines)
+    {
+        lines.push_back(statsName() + ": Correctness  = " + toString(perf()) + "%");
+    }
+
+    // Into the Stats of either simulator (Workload_Analysis/src/Sim or Workload_Char/include/
+    // Sim), which the predictors do not depend on.
+    template<typename S>
+    void registerStats(S &stats)
     {
-        stats.registerStats("Branch Predictor: Correctness  = " + to_string(perf()) + "%");
+        std::vector<std::string> lines;
+        statsLines(lines);
+        for (auto &line : lines) { stats.registerStats(line); }
     }
 
+    // Labels the stats, for several predictors in one run (see Predictor_Ensemble).
+    void setName(const std::string &_name) { name = _name; }
+
     virtual void reInitialize()
     {
         num_correct_preds = 0;
@@ -36,30 +52,22 @@ class Branch_Predictor
     }
 
   protected:
-    class Sat_Counter
-    {
-      public:
-        Sat_Counter(unsigned _counter_bits) : counter_bits(_counter_bits),
-                                              max_val((1 << counter_bits) - 1),
-                                              val(0)
-        {}
-
-        void increment() { if (val < max_val) { ++val; } }
-
-        void decrement() { if (val > 0) { --val; } }
-
-        bool predict() { return val >> (counter_bits - 1); } // MSB determines prediction
+    const unsigned instShiftAmt;
 
-        // TODO, should be protected, I kept them public for debugging.
-//      protected:
-        const unsigned counter_bits; // Number of bits of a counter
+    std::string name;
 
-        uint8_t max_val; // Max value of the counter
-        uint8_t val; // Current value of the counter
-    };
+    std::string statsName() const
+    {
+        return name.empty() ? "Branch Predictor" : "Branch Predictor (" + name + ")";
+    }
 
-  protected:
-    const unsigned instShiftAmt;
+    template<typename T>
+    static std::string toString(T val)
+    {
+        std::ostringstream ss;
+        ss << val;
+        return ss.str();
+    }
 
     Count num_correct_preds;
     Count num_incorrect_preds;
@@ -0,0 +1,57 @@
+#ifndef __BRANCH_PREDICTOR_FACTORY_HH__
+#define __BRANCH_PREDICTOR_FACTORY_HH__
+
+#include "Basic/two_bit_local.hh"
+#include "Basic/tournament.hh"
+#include "Pentium/pentium_m.hh"
+#include "TAGE/tage_sc_l.hh"
+#include "Perceptron/hashed_perceptron.hh"
+#include "predictor_ensemble.hh"
+
+#include <string>
+
+namespace BP
+{
+// The predictor of that name (see Config::branch_predictor), nullptr for an unknown one.
+inline Branch_Predictor *createBranchPredictor(const std::string &name,
+                                               const TAGE_Params &tage = TAGE_Params(),
+                                               const Perceptron_Params &perceptron =
+                                                   Perceptron_Params())
+{
+    if (name == "two_bit_local") { return new Two_Bit_Local(); }
+    else if (name == "tournament") { return new Tournament(); }
+    else if (name == "pentium_m") { return new PentiumM(); }
+    else if (name == "tage_sc_l") { return new TAGE_SC_L(tage); }
+    else if (name == "hashed_perceptron") { return new Hashed_Perceptron(perceptron); }
+    return nullptr;
+}
+
+// The predictors of a comma-separated list of names, in an ensemble; nullptr if a name is
+// unknown (in unknown).
+inline Predictor_Ensemble *createEnsemble(const std::string &names, std::string &unknown,
+                                          const TAGE_Params &tage = TAGE_Params(),
+                                          const Perceptron_Params &perceptron =
+                                              Perceptron_Params())
+{
+    Predictor_Ensemble *ensemble = new Predictor_Ensemble();
+    size_t start = 0;
+    while (start <= names.size())
+    {
+        size_t end = names.find(',', start);
+        if (end == std::string::npos) { end = names.size(); }
+        std::string name = names.substr(start, end - start);
+        Branch_Predictor *bp = createBranchPredictor(name, tage, perceptron);
+        if (bp == nullptr)
+        {
+            unknown = name;
+            delete ensemble;
+            return nullptr;
+        }
+        ensemble->add(name, bp);
+        start = end + 1;
+    }
+    return ensemble;
+}
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __BP_PARAMS_HH__
+#define __BP_PARAMS_HH__
+
+#include <string>
+
+namespace BP
+{
+// The tables of the predictors that the configuration file sets (see Config); the sizes are the
+// log2 of the number of entries.
+struct TAGE_Params
+{
+    unsigned base_bits = 13; // Bimodal base predictor, 2-bit counters.
+    unsigned num_tables = 12; // Tagged tables.
+    unsigned table_bits = 10; // Per tagged table.
+    unsigned min_hist = 4; // History lengths, geometric from min_hist to max_hist.
+    unsigned max_hist = 640;
+    unsigned min_tag_bits = 8; // Tag widths, from min_tag_bits to max_tag_bits.
+    unsigned max_tag_bits = 12;
+    unsigned sc_table_bits = 10; // Statistical corrector, 0 disables it.
+    unsigned loop_bits = 6; // Loop predictor, 0 disables it.
+};
+
+struct Perceptron_Params
+{
+    unsigned num_tables = 8; // The first one is indexed by the PC only.
+    unsigned table_bits = 12;
+    unsigned max_hist = 128; // History lengths, geometric up to max_hist.
+    unsigned weight_bits = 8;
+};
+
+// Sets the parameter named as in the configuration file (tage_<field> or perceptron_<field>);
+// false for an unknown name.
+inline bool setParam(const std::string &name, unsigned val, TAGE_Params &tage,
+                     Perceptron_Params &perceptron)
+{
+    if (name == "tage_base_bits") { tage.base_bits = val; }
+    else if (name == "tage_num_tables") { tage.num_tables = val; }
+    else if (name == "tage_table_bits") { tage.table_bits = val; }
+    else if (name == "tage_min_hist") { tage.min_hist = val; }
+    else if (name == "tage_max_hist") { tage.max_hist = val; }
+    else if (name == "tage_min_tag_bits") { tage.min_tag_bits = val; }
+    else if (name == "tage_max_tag_bits") { tage.max_tag_bits = val; }
+    else if (name == "tage_sc_table_bits") { tage.sc_table_bits = val; }
+    else if (name == "tage_loop_bits") { tage.loop_bits = val; }
+    else if (name == "perceptron_num_tables") { perceptron.num_tables = val; }
+    else if (name == "perceptron_table_bits") { perceptron.table_bits = val; }
+    else if (name == "perceptron_max_hist") { perceptron.max_hist = val; }
+    else if (name == "perceptron_weight_bits") { perceptron.weight_bits = val; }
+    else { return false; }
+    return true;
+}
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef __PACKED_COUNTER_TABLE_HH__
+#define __PACKED_COUNTER_TABLE_HH__
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace BP
+{
+// A table of Bits-bit saturating counters (0 to 2^Bits - 1), packed into words: 32 2-bit
+// counters per 64-bit word by default, 4 per word with Word = uint8_t. The MSB of a counter
+// is its prediction.
+//
+// increment() and decrement() are branch-free: a saturated counter adds (or subtracts) zero
+// instead of one, which never carries into the next counter.
+template <unsigned Bits, typename Word = uint64_t>
+class PackedCounterTable
+{
+  public:
+    static constexpr unsigned WORD_BITS = sizeof(Word) * 8;
+    static constexpr unsigned PER_WORD = WORD_BITS / Bits; // Counters per word.
+    static constexpr unsigned MAX = (1u << Bits) - 1;
+
+    static_assert(Bits > 0 && Bits <= 8 && WORD_BITS % Bits == 0,
+                  "Counters must be 1 to 8 bits and tile the word");
+
+    PackedCounterTable(size_t _num_counters, unsigned init = 0)
+        : num_counters(_num_counters), words((_num_counters + PER_WORD - 1) / PER_WORD, 0)
+    {
+        assert(init <= MAX);
+        if (init == 0) { return; }
+        Word filled = 0;
+        for (unsigned i = 0; i < PER_WORD; i++) { filled |= Word(init) << (i * Bits); }
+        for (auto &word : words) { word = filled; }
+    }
+
+    size_t size() const { return num_counters; }
+
+    unsigned get(size_t i) const { return unsigned(words[i / PER_WORD] >> shift(i)) & MAX; }
+
+    bool predict(size_t i) const { return get(i) >> (Bits - 1); }
+
+    void set(size_t i, unsigned val)
+    {
+        Word &word = words[i / PER_WORD];
+        word = (word & ~(Word(MAX) << shift(i))) | (Word(val & MAX) << shift(i));
+    }
+
+    void increment(size_t i)
+    {
+        Word &word = words[i / PER_WORD];
+        unsigned s = shift(i);
+        word += Word(((word >> s) & MAX) != MAX) << s;
+    }
+
+    void decrement(size_t i)
+    {
+        Word &word = words[i / PER_WORD];
+        unsigned s = shift(i);
+        word -= Word(((word >> s) & MAX) != 0) << s;
+    }
+
+    // increment() when up, decrement() otherwise, without a branch on up.
+    void update(size_t i, bool up)
+    {
+        Word &word = words[i / PER_WORD];
+        unsigned s = shift(i);
+        unsigned val = unsigned(word >> s) & MAX;
+        Word inc = Word(up & (val != MAX));
+        Word dec = Word(!up & (val != 0));
+        word = word + (inc << s) - (dec << s);
+    }
+
+  protected:
+    size_t num_counters;
+    std::vector<Word> words;
+
+    static unsigned shift(size_t i) { return unsigned(i % PER_WORD) * Bits; }
+};
+}
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef __PREDICTOR_ENSEMBLE_HH__
+#define __PREDICTOR_ENSEMBLE_HH__
+
+#include "branch_predictor.hh"
+
+#include <sched.h>
+
+#include <cassert>
+#include <string>
+#include <vector>
+
+namespace BP
+{
+// Several predictors fed the same branch stream in one pass, each with its own stats (labelled
+// with its name, see Branch_Predictor::setName()).
+//
+// By default predict() runs them one after the other. After shard(), predict() only appends the
+// branch to a batch, and each predictor runs on its own host thread (a worker) that the owner
+// starts on workerMain(workerArg(w)), a std::thread or a Pin internal thread, so that adding
+// predictors does not slow the producers down.
+//
+// A sharded ensemble has up to num_producers producers (e.g., the threads of the application),
+// each calling predict(producer, ...) with its own index; predict(instr, timer) is producer 0.
+// A producer has its own ring of RING_SLOTS batches (allocated at its first branch) with its
+// write cursor, and each worker a read cursor per producer; a slot is reused once every worker
+// is past it. Each cursor pair is a single-producer single-consumer queue, so there is no lock,
+// and the waits spin with sched_yield(). A worker takes a batch of each producer in turn, so
+// the branches of different producers reach a predictor interleaved by batch.
+//
+// Unsharded, there must be a single producer (as for any predictor, predict() is not
+// thread-safe). finish(producer) hands over what a producer has left; that producer must not
+// predict() anymore. registerStats(), reInitialize() and finish() must not run concurrently
+// with any predict(): the first two wait for the workers to catch up, and finish() stops them;
+// join them after it.
+class Predictor_Ensemble : public Branch_Predictor
+{
+  public:
+    static const unsigned BATCH_SIZE = 4096; // Branches.
+    static const unsigned RING_SLOTS = 8; // Batches.
+
+    Predictor_Ensemble() {}
+
+    ~Predictor_Ensemble()
+    {
+        assert(!sharded || done);
+        for (auto bp : predictors) { delete bp; }
+        for (auto &producer : producers) { delete[] producer.ring; }
+    }
+
+    // Takes ownership of bp.
+    void add(const std::string &name, Branch_Predictor *bp)
+    {
+        assert(!sharded);
+        bp->setName(name);
+        predictors.push_back(bp);
+    }
+
+    unsigned size() const { return predictors.size(); }
+
+    // One worker per predictor from now on; start them before the first predict().
+    void shard(unsigned num_producers = 1)
+    {
+        assert(!sharded && !predictors.empty() && num_producers > 0);
+        sharded = true;
+        producers.resize(num_producers);
+        workers.resize(predictors.size());
+        for (unsigned w = 0; w < workers.size(); w++)
+        {
+            workers[w].ensemble = this;
+            workers[w].id = w;
+        }
+        cursors.resize(num_producers * workers.size());
+    }
+
+    bool isSharded() const { return sharded; }
+
+    void *workerArg(unsigned w) { return &workers[w]; }
+
+    // The loop of a worker, returns after finish().
+    static void workerMain(void *arg)
+    {
+        Worker *worker = static_cast<Worker*>(arg);
+        Predictor_Ensemble *ensemble = worker->ensemble;
+        Branch_Predictor *bp = ensemble->predictors[worker->id];
+
+        Instruction instr;
+        instr.setBranch();
+        while (true)
+        {
+            bool idle = true;
+            unsigned num_active = __atomic_load_n(&ensemble->num_active, __ATOMIC_ACQUIRE);
+            for (unsigned p = 0; p < num_active; p++)
+            {
+                Producer &producer = ensemble->producers[p];
+                uint64_t &tail = ensemble->cursor(p, worker->id).tail;
+                if (tail == __atomic_load_n(&producer.head, __ATOMIC_ACQUIRE)) { continue; }
+
+                const Batch &batch = producer.ring[tail % RING_SLOTS];
+                for (unsigned i = 0; i < batch.size; i++)
+                {
+                    instr.setPC(batch.branches[i].PC);
+                    instr.setTaken(batch.branches[i].taken);
+                    bp->predict(instr, batch.branches[i].timer);
+                }
+                __atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+                idle = false;
+            }
+
+            if (idle)
+            {
+                // finish() sets done once the workers are past every batch.
+                if (__atomic_load_n(&ensemble->done, __ATOMIC_ACQUIRE)) { return; }
+                sched_yield();
+            }
+        }
+    }
+
+    void predict(Instruction &instr, Count timer) override { predict(0, instr, timer); }
+
+    void predict(unsigned p, Instruction &instr, Count timer)
+    {
+        if (!sharded)
+        {
+            for (auto bp : predictors) { bp->predict(instr, timer); }
+            return;
+        }
+
+        Producer &producer = producers[p];
+        if (producer.ring == nullptr) { addProducer(p); }
+        Batch &batch = producer.ring[producer.head % RING_SLOTS];
+        Branch &branch = batch.branches[batch.size];
+        branch.PC = instr.PC;
+        branch.timer = timer;
+        branch.taken = instr.taken;
+        if (++batch.size == BATCH_SIZE) { publish(p); }
+    }
+
+    // Hands over the branches producer p has left.
+    void finish(unsigned p)
+    {
+        if (!sharded) { return; }
+        Producer &producer = producers[p];
+        if (producer.ring != nullptr && producer.ring[producer.head % RING_SLOTS].size != 0)
+        {
+            publish(p);
+        }
+    }
+
+    // Until every worker has predicted every branch so far.
+    void drain()
+    {
+        if (!sharded) { return; }
+        for (unsigned p = 0; p < producers.size(); p++)
+        {
+            finish(p);
+            for (unsigned w = 0; w < workers.size(); w++)
+            {
+                while (__atomic_load_n(&cursor(p, w).tail, __ATOMIC_ACQUIRE) !=
+                       producers[p].head)
+                {
+                    sched_yield();
+                }
+            }
+        }
+    }
+
+    // drain(), then the workers return.
+    void finish()
+    {
+        if (!sharded || done) { return; }
+        drain();
+        __atomic_store_n(&done, true, __ATOMIC_RELEASE);
+    }
+
+    void statsLines(std::vector<std::string> &lines) override
+    {
+        drain();
+        for (auto bp : predictors) { bp->statsLines(lines); }
+    }
+
+    void reInitialize() override
+    {
+        drain();
+        for (auto bp : predictors) { bp->reInitialize(); }
+    }
+
+  protected:
+    struct Branch
+    {
+        Addr PC;
+        Count timer;
+        bool taken;
+    };
+
+    struct Batch
+    {
+        unsigned size = 0;
+        Branch branches[BATCH_SIZE];
+    };
+
+    // Each on its own cache line.
+    struct Producer
+    {
+        Batch *ring = nullptr;
+        uint64_t head = 0; // Batches published.
+        char pad[48];
+    };
+
+    struct Cursor
+    {
+        uint64_t tail = 0; // Batches done.
+        char pad[56];
+    };
+
+    struct Worker
+    {
+        Predictor_Ensemble *ensemble = nullptr;
+        unsigned id = 0;
+    };
+
+    std::vector<Branch_Predictor*> predictors;
+
+    bool sharded = false;
+    bool done = false;
+    std::vector<Producer> producers;
+    unsigned num_active = 0; // The producers the workers look at: up to the last with a ring.
+    std::vector<Cursor> cursors; // Of worker w for producer p, see cursor().
+    std::vector<Worker> workers;
+
+    Cursor &cursor(unsigned p, unsigned w) { return cursors[p * workers.size() + w]; }
+
+    // At the first branch of producer p.
+    void addProducer(unsigned p)
+    {
+        assert(p < producers.size());
+        producers[p].ring = new Batch[RING_SLOTS];
+        unsigned active = __atomic_load_n(&num_active, __ATOMIC_RELAXED);
+        while (active < p + 1 &&
+               !__atomic_compare_exchange_n(&num_active, &active, p + 1, true,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+    }
+
+    // Hands the current batch of producer p over, and waits for the next slot to be free.
+    void publish(unsigned p)
+    {
+        Producer &producer = producers[p];
+        uint64_t next = producer.head + 1;
+        __atomic_store_n(&producer.head, next, __ATOMIC_RELEASE);
+        for (unsigned w = 0; w < workers.size(); w++)
+        {
+            while (next - __atomic_load_n(&cursor(p, w).tail, __ATOMIC_ACQUIRE) >= RING_SLOTS)
+            {
+                sched_yield();
+            }
+        }
+        producer.ring[next % RING_SLOTS].size = 0;
+    }
+};
+}
+
+#endif
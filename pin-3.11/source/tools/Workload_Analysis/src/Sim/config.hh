@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include "../Branch_Predictor/branch_predictor_params.hh"
+
 using std::ifstream; // Not sure why this works.
 
 class Config
@@ -30,6 +32,12 @@ class Config
     };
     std::vector<Cache_Info> caches;
 
+    // two_bit_local, tournament, pentium_m, tage_sc_l or hashed_perceptron, or a comma-separated
+    // list of them to run together (see BP::Predictor_Ensemble).
+    std::string branch_predictor = "two_bit_local";
+    BP::TAGE_Params tage;
+    BP::Perceptron_Params perceptron;
+
     Config(std::string fname) : caches(int(Cache_Level::MAX)) { parse(fname); }
 
     void parse(std::string &fname)
@@ -86,6 +94,14 @@ class Config
             {
                 block_size = atoi(tokens[1].c_str());
             }
+            else if(tokens[0] == "branch_predictor")
+            {
+                branch_predictor = tokens[1];
+            }
+            else if(tokens[0].find("tage_") == 0 || tokens[0].find("perceptron_") == 0)
+            {
+                extractBPInfo(tokens);
+            }
             else if(tokens[0].find("L1D") != std::string::npos)
             {
                 extractCacheInfo(Cache_Level::L1D, tokens);
@@ -106,6 +122,14 @@ class Config
         file.close();
     }
     
+    void extractBPInfo(std::vector<std::string> &tokens)
+    {
+        if (!BP::setParam(tokens[0], atoi(tokens[1].c_str()), tage, perceptron))
+        {
+            assert(false && "Unknown branch predictor parameter");
+        }
+    }
+
     void extractCacheInfo(Cache_Level level, std::vector<std::string> &tokens)
     {
         caches[int(level)].valid = true;
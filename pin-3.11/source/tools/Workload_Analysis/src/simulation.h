@@ -2,11 +2,15 @@
 #define __SIMULATION_H__
 
 // Include all the necessary files here
-#include "Sim/instruction.hh"
+#include "Branch_Predictor/instruction.hh"
 #include "Branch_Predictor/branch_predictor.hh"
 #include "Branch_Predictor/Basic/two_bit_local.hh"
 #include "Branch_Predictor/Basic/tournament.hh"
 #include "Branch_Predictor/Pentium/pentium_m.hh"
+#include "Branch_Predictor/TAGE/tage_sc_l.hh"
+#include "Branch_Predictor/Perceptron/hashed_perceptron.hh"
+#include "Branch_Predictor/predictor_ensemble.hh"
+#include "Branch_Predictor/branch_predictor_factory.hh"
 
 #include "Sim/config.hh"
 #include "Sim/request.hh"
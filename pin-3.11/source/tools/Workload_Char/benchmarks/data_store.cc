@@ -0,0 +1,173 @@
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "../include/Sim/data.hh"
+
+// Operations per second of the data storage of data-aware tracing (Data, a slab of lines with an
+// open-addressing index) and of the unordered_map of byte vectors it replaced (Map_Data below),
+// on the stream an LLC of 32k lines sends it: a load per miss, a modification per store, a read
+// and a deletion per eviction. Both must end up with the same lines.
+//
+// Usage (from benchmarks): data_store [number of operations (default 10M)]
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+static uint64_t rngNext()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static const unsigned block_size = 64;
+static const unsigned llc_lines = 32768;
+
+// The previous Data.
+class Map_Data
+{
+  public:
+    void loadData(uint64_t aligned_addr, const uint8_t *data, unsigned size)
+    {
+        DUnit storage;
+        for (unsigned i = 0; i < size; i++)
+        {
+            storage.ori_data.push_back(data[i]);
+            storage.new_data.push_back(data[i]);
+        }
+        data_storage.insert({aligned_addr, storage});
+    }
+
+    void getData(uint64_t aligned_addr,
+                 std::vector<uint8_t> &ori_data,
+                 std::vector<uint8_t> &new_data)
+    {
+        auto d_iter = data_storage.find(aligned_addr);
+        assert(d_iter != data_storage.end());
+        for (unsigned i = 0; i < block_size; i++)
+        {
+            ori_data.push_back((d_iter->second).ori_data[i]);
+            new_data.push_back((d_iter->second).new_data[i]);
+        }
+    }
+
+    void deleteData(uint64_t aligned_addr) { data_storage.erase(aligned_addr); }
+
+    void modifyData(uint64_t addr, const uint8_t *data, unsigned size)
+    {
+        unsigned offset = addr & (block_size - 1);
+        auto d_iter = data_storage.find(addr & ~uint64_t(block_size - 1));
+        assert(d_iter != data_storage.end());
+        for (unsigned i = 0; i < size; i++) { (d_iter->second).new_data[i + offset] = data[i]; }
+    }
+
+    uint64_t numLines() const { return data_storage.size(); }
+
+  protected:
+    struct DUnit
+    {
+        std::vector<uint8_t> ori_data;
+        std::vector<uint8_t> new_data;
+    };
+
+    std::unordered_map<uint64_t, DUnit> data_storage;
+};
+
+struct Operation
+{
+    enum class Kind { LOAD, MODIFY, EVICT } kind;
+    uint64_t addr;
+    unsigned size;
+};
+
+// A direct-mapped stand-in for the LLC decides what is loaded and evicted.
+static std::vector<Operation> makeOperations(uint64_t num_operations)
+{
+    std::vector<Operation> operations;
+    std::vector<uint64_t> lines(llc_lines, ~uint64_t(0));
+    while (operations.size() < num_operations)
+    {
+        uint64_t r = rngNext();
+        uint64_t line = (r & 3) != 0 ? (r >> 8) % 16384 : (r >> 8) % 1048576;
+        uint64_t aligned_addr = line * block_size;
+        uint64_t &slot = lines[line % llc_lines];
+        if (slot != aligned_addr)
+        {
+            if (slot != ~uint64_t(0)) { operations.push_back({Operation::Kind::EVICT, slot, 0}); }
+            operations.push_back({Operation::Kind::LOAD, aligned_addr, block_size});
+            slot = aligned_addr;
+        }
+        if ((r & 0x30) == 0)
+        {
+            unsigned size = 1u << ((r >> 40) & 3);
+            unsigned offset = ((r >> 44) % block_size) & ~(size - 1);
+            operations.push_back({Operation::Kind::MODIFY, aligned_addr + offset, size});
+        }
+    }
+    return operations;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t num_operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    std::vector<Operation> operations = makeOperations(num_operations);
+
+    uint8_t payload[block_size];
+    for (unsigned i = 0; i < block_size; i++) { payload[i] = uint8_t(i * 7); }
+
+    uint64_t map_checksum = 0;
+    Map_Data map_data;
+    auto begin = std::chrono::steady_clock::now();
+    for (auto &op : operations)
+    {
+        if (op.kind == Operation::Kind::LOAD) { map_data.loadData(op.addr, payload, op.size); }
+        else if (op.kind == Operation::Kind::MODIFY)
+        {
+            map_data.modifyData(op.addr, payload, op.size);
+        }
+        else
+        {
+            std::vector<uint8_t> ori_data, new_data;
+            map_data.getData(op.addr, ori_data, new_data);
+            map_checksum += new_data[op.addr / block_size % block_size];
+            map_data.deleteData(op.addr);
+        }
+    }
+    std::chrono::duration<double> map_elapsed = std::chrono::steady_clock::now() - begin;
+
+    uint64_t slab_checksum = 0;
+    Data slab_data(block_size);
+    begin = std::chrono::steady_clock::now();
+    for (auto &op : operations)
+    {
+        if (op.kind == Operation::Kind::LOAD) { slab_data.loadData(op.addr, payload, op.size); }
+        else if (op.kind == Operation::Kind::MODIFY)
+        {
+            slab_data.modifyData(op.addr, payload, op.size);
+        }
+        else
+        {
+            Data::Line_View view;
+            if (!slab_data.getData(op.addr, view)) { return 1; }
+            slab_checksum += view.new_data[op.addr / block_size % block_size];
+            slab_data.deleteData(op.addr);
+        }
+    }
+    std::chrono::duration<double> slab_elapsed = std::chrono::steady_clock::now() - begin;
+
+    double map_rate = operations.size() / map_elapsed.count();
+    double slab_rate = operations.size() / slab_elapsed.count();
+    printf("unordered_map %7.1f M operations/s, slab %7.1f M operations/s (%.2fx)\n",
+           map_rate / 1e6, slab_rate / 1e6, slab_rate / map_rate);
+
+    if (map_checksum != slab_checksum || map_data.numLines() != slab_data.numLines())
+    {
+        std::cerr << "The two data storages disagree\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/Sim/config.hh"
+#include "../include/CacheSim/hierarchy.hh"
+#include "../include/CacheSim/static_configs.hh"
+
+// Accesses per second of the run-time cache hierarchy (Hierarchy, levels wired through
+// MemObject) and of the compile-time one (StaticHierarchy, see static_configs.hh) of each
+// configuration, on the same stream of fetches and data accesses spread over the cores. The
+// stream mixes a hot set that fits in L1 with a working set of 4MB, and both hierarchies must
+// end up with the same stats.
+//
+// Usage (from benchmarks): hierarchy [number of accesses (default 10M)] [config ...]
+//     The configurations default to those of ../configs.
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+static uint64_t rngNext()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+struct Access
+{
+    unsigned core;
+    bool fetch;
+    Request req;
+};
+
+template<typename H>
+static double run(H &caches, const std::vector<Access> &accesses, Stats &stats)
+{
+    auto begin = std::chrono::steady_clock::now();
+    for (auto access : accesses)
+    {
+        if (access.fetch) { caches.fetch(access.core, access.req); }
+        else { caches.access(access.core, access.req); }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    caches.registerStats(stats);
+    return accesses.size() / elapsed.count();
+}
+
+// Hierarchy has no fetch()/access(), the callers send to its L1s (as Platforms does).
+struct Runtime_Hierarchy
+{
+    CacheSimulator::Hierarchy &caches;
+
+    void fetch(unsigned core, Request &req)
+    {
+        if (!caches.L1Is.empty()) { caches.L1Is[core]->send(req); }
+    }
+
+    void access(unsigned core, Request &req)
+    {
+        if (!caches.L1Ds.empty()) { caches.L1Ds[core]->send(req); }
+    }
+
+    void registerStats(Stats &stats) { caches.registerStats(stats); }
+};
+
+static std::string statsString(Stats &stats, const std::string &file)
+{
+    stats.outputStats(file);
+    std::ifstream in(file);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t num_accesses = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    std::vector<std::string> cfg_files;
+    for (int arg = 2; arg < argc; arg++) { cfg_files.push_back(argv[arg]); }
+    if (cfg_files.empty())
+    {
+        const char *shipped[] = {"cortex-a76", "jetson", "pi3", "pi4", "power9", "skylake"};
+        for (auto name : shipped)
+        {
+            cfg_files.push_back(std::string("../configs/") + name + ".cfg");
+        }
+    }
+
+    for (auto &cfg_file : cfg_files)
+    {
+        Config cfg(cfg_file);
+
+        std::vector<Access> accesses(num_accesses);
+        for (auto &access : accesses)
+        {
+            uint64_t r = rngNext();
+            access.core = (r >> 60) % cfg.num_cores;
+            access.fetch = (r & 7) == 0;
+            uint64_t line = (r & 0x18) != 0 ? (r >> 8) % 256 : (r >> 8) % 65536;
+            access.req.addr = (access.fetch ? 0x40000000 : 0) + line * 64 + ((r >> 20) & 63);
+            access.req.instr_loading = access.fetch;
+            access.req.req_type = !access.fetch && (r & 0x60) == 0 ?
+                                  Request::Request_Type::WRITE : Request::Request_Type::READ;
+        }
+
+        CacheSimulator::StaticHierarchyBase *static_caches =
+            CacheSimulator::createStaticHierarchy(cfg);
+        if (static_caches == nullptr)
+        {
+            std::cerr << "No compile-time hierarchy for " << cfg_file << "\n";
+            return 1;
+        }
+
+        CacheSimulator::Hierarchy hierarchy(cfg);
+        Runtime_Hierarchy runtime = {hierarchy};
+        Stats runtime_stats, static_stats;
+        double dynamic_rate = run(runtime, accesses, runtime_stats);
+        double static_rate = run(*static_caches, accesses, static_stats);
+        delete static_caches;
+
+        printf("%-26s run-time %7.1f M accesses/s, compile-time %7.1f M accesses/s (%.2fx)\n",
+               cfg_file.c_str(), dynamic_rate / 1e6, static_rate / 1e6,
+               static_rate / dynamic_rate);
+
+        if (statsString(runtime_stats, "/tmp/hierarchy_runtime.stats") !=
+            statsString(static_stats, "/tmp/hierarchy_static.stats"))
+        {
+            std::cerr << "The two hierarchies disagree, see /tmp/hierarchy_runtime.stats and "
+                      << "/tmp/hierarchy_static.stats\n";
+            return 1;
+        }
+    }
+    return 0;
+}
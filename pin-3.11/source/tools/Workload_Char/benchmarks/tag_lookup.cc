@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/Sim/config.hh"
+#include "../include/CacheSim/cache.hh"
+
+// Accesses per second of a single cache level with the original tag store (one SetWayBlk
+// object per way, LRUSetWayAssocTags) and with the packed one (PackedLRUTags), for 8- and
+// 16-way caches of 64 sets. Both see the same stream, a mix of a small hot set and a working
+// set twice the size of the cache, and must end up with the same hits and evictions.
+//
+// Usage: tag_lookup [number of accesses (default 20M)]
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+static uint64_t rngNext()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static std::string writeConfig(unsigned assoc, unsigned num_sets)
+{
+    std::string cfg_file = "/tmp/tag_lookup_" + std::to_string(assoc) + "way.cfg";
+    std::ofstream cfg(cfg_file);
+    cfg << "num_cores = 1\n"
+        << "block_size = 64\n"
+        << "L1D_assoc = " << assoc << "\n"
+        << "L1D_size = " << assoc * num_sets * 64 / 1024 << "\n"
+        << "L1D_write_only = false\n"
+        << "L1D_shared = false\n";
+    return cfg_file;
+}
+
+template<typename T>
+static double run(Config &cfg, const std::vector<Request> &reqs, Stats &stats)
+{
+    CacheSimulator::Cache<T> cache(Config::Cache_Level::L1D, cfg);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (auto req : reqs) { cache.send(req); }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    cache.registerStats(stats);
+    return reqs.size() / elapsed.count();
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t num_accesses = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000000;
+    const unsigned num_sets = 64;
+
+    unsigned assocs[] = {8, 16};
+    for (auto assoc : assocs)
+    {
+        Config cfg(writeConfig(assoc, num_sets));
+
+        uint64_t num_lines = assoc * num_sets;
+        std::vector<Request> reqs(num_accesses);
+        for (auto &req : reqs)
+        {
+            uint64_t r = rngNext();
+            uint64_t line = (r & 3) != 0 ? (r >> 8) % (num_lines / 4) : (r >> 8) % (num_lines * 2);
+            req.addr = line * 64 + ((r >> 2) & 63);
+            req.req_type = (r & 0x30) == 0 ? Request::Request_Type::WRITE :
+                                             Request::Request_Type::READ;
+        }
+
+        Stats blk_stats, packed_stats;
+        double blk = run<CacheSimulator::LRUSetWayAssocTags>(cfg, reqs, blk_stats);
+        double packed = run<CacheSimulator::PackedLRUTags>(cfg, reqs, packed_stats);
+
+        printf("%2u-way: SetWayBlk %8.1f M accesses/s, packed %8.1f M accesses/s (%.2fx)\n",
+               assoc, blk / 1e6, packed / 1e6, packed / blk);
+
+        std::string blk_file = "/tmp/tag_lookup_blk.stats";
+        std::string packed_file = "/tmp/tag_lookup_packed.stats";
+        blk_stats.outputStats(blk_file);
+        packed_stats.outputStats(packed_file);
+        std::ifstream a(blk_file), b(packed_file);
+        std::string sa((std::istreambuf_iterator<char>(a)), std::istreambuf_iterator<char>());
+        std::string sb((std::istreambuf_iterator<char>(b)), std::istreambuf_iterator<char>());
+        if (sa != sb)
+        {
+            std::cerr << "The two tag stores disagree, see " << blk_file << " and "
+                      << packed_file << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -6,6 +6,7 @@
 
 #include "tags/cache_tags.hh"
 #include "tags/set_assoc_tags.hh"
+#include "tags/packed_set_assoc_tags.hh"
 
 #include <sstream>
 #include <string>
@@ -13,9 +14,16 @@
 // Let's consider an inclusive cache (easier to manage).
 namespace CacheSimulator
 {
-// TODO, the data-awareness is disabled for some other experiments.
-// Should be a template.
-template<typename T>
+// Data-aware tracing is off unless the data storage and the trace output are set (on the
+// LLC, see setStorageUnit() and traceOutput()): off-chip reads and write-backs then go to the
+// trace, the write-backs with the original and new contents of their line. With the data
+// storage, the write-backs can also go to an NVMWrites analysis (see analyzeWrites()).
+//
+// Next is the type of the next level. It is a MemObject (any level, called through send()) when
+// the hierarchy is wired at run time, or the exact Cache type of the next level in a
+// compile-time hierarchy (see static_hierarchy.hh), where the call to its send() (final) is
+// direct and can be inlined.
+template<typename T, typename Next = MemObject>
 class Cache : public MemObject
 {
   public:
@@ -27,7 +35,7 @@ class Cache : public MemObject
         tags.level_str = level_name;
     }
 
-    bool send(Request &request) override
+    bool send(Request &request) final
     {
         accesses++; // Emulate a timer for LRU.
         // Collect more stats
@@ -74,24 +82,21 @@ class Cache : public MemObject
             }
 
             // Send a loading request to next level.
-            if (next_level != nullptr)
+            if (next != nullptr)
             {
                 Request req;
+                req.core_id = request.core_id;
                 req.instr_loading = request.instr_loading;
 
                 req.addr = aligned_addr; // Address of the missed block.
                 req.req_type = Request::Request_Type::READ; // Loading (Always)
 
-                next_level_hit = next_level->send(req);
+                next_level_hit = next->send(req);
 
             }
-            /*
-            else
-            {
-                // Output off-chip read traffic
-                *trace_out << aligned_addr << " R\n";
-            }
-            */
+
+            // Data-aware tracing (the LLC): off-chip read traffic.
+            if (trace_out != nullptr) { *trace_out << aligned_addr << " R\n"; }
         }
 
         // Insert the missed block
@@ -107,48 +112,19 @@ class Cache : public MemObject
         {
             ++num_evicts;
 
-            if (next_level != nullptr)
+            if (next != nullptr)
             {
                 Request req;
+                req.core_id = request.core_id; // The core whose miss evicts the block.
 
                 req.addr = victim_addr; // Address of the evicted block.
                 req.req_type = Request::Request_Type::WRITE_BACK;
 
-                next_level->send(req); // send to lower levels
+                next->send(req); // send to lower levels
             }
-            /*
-            else
-            {
-                // Output off-chip write traffic
-                std::vector<uint8_t> ori_data;
-                std::vector<uint8_t> new_data;
-
-                assert(data != nullptr);
-                data->getData(victim_addr, ori_data, new_data);
-                assert(ori_data.size() > 0);
-                assert(new_data.size() > 0);
-
-                *trace_out << victim_addr << " W " << new_data.size() << " ";
-
-                for (unsigned int i = 0; i < ori_data.size(); i++)
-                {
-                    *trace_out << int(ori_data[i]) << " ";
-                }
-                
-                for (unsigned int i = 0; i < new_data.size() - 1; i++)
-                {
-                    *trace_out << int(new_data[i]) << " ";
-                }
-                *trace_out << int(new_data[new_data.size() - 1]) << "\n";
-
-                // unsigned num_diff = 0;
-                // for (unsigned int i = 0; i < ori_data.size(); i++)
-                // {
-                //     if (ori_data[i] != new_data[i]) { num_diff++; }
-                // }
-                // *trace_out << num_diff << "\n";
-            }
-            */
+
+            // Data-aware tracing (the LLC): off-chip write traffic.
+            if (data != nullptr) { traceWriteBack(victim_addr); }
         }
         
         // Invalidate upper levels (inclusive)
@@ -157,18 +133,18 @@ class Cache : public MemObject
             for (auto &prev_level : prev_levels) { prev_level->inval(victim_addr); }
         }
 
-        /*
         // Delete data from data storage when there is a (valid) eviction from LLC.
-        if (victim_addr != MaxAddr && next_level == nullptr)
-        {
-            assert(data != nullptr);
-            data->deleteData(victim_addr);
-        }
-        */
+        if (victim_addr != MaxAddr && data != nullptr) { data->deleteData(victim_addr); }
 
 	return next_level_hit;
     }
 
+    void setNextLevel(MemObject *_next_level) override
+    {
+        next_level = _next_level;
+        next = static_cast<Next*>(_next_level);
+    }
+
     void inval(uint64_t _addr) override
     {
         // Invalidate the block address
@@ -213,6 +189,25 @@ class Cache : public MemObject
   protected:
     const Addr MaxAddr = (Addr) - 1;
 
+    // "<addr> W <size> <original bytes> <new bytes>" to the trace, and the line to the NVM
+    // analysis, for the lines the data storage has (not those of instructions).
+    void traceWriteBack(Addr victim_addr)
+    {
+        Data::Line_View line;
+        if (!data->getData(victim_addr, line)) { return; }
+
+        if (nvm_writes != nullptr) { nvm_writes->writeBack(line.ori_data, line.new_data); }
+        if (trace_out == nullptr) { return; }
+
+        unsigned size = data->blockSize();
+        *trace_out << victim_addr << " W " << size << " ";
+        for (unsigned i = 0; i < size; i++) { *trace_out << int(line.ori_data[i]) << " "; }
+        for (unsigned i = 0; i < size - 1; i++) { *trace_out << int(line.new_data[i]) << " "; }
+        *trace_out << int(line.new_data[size - 1]) << "\n";
+    }
+
+    Next *next = nullptr; // next_level, as its type.
+
     Tick accesses = 0; // We are using this for LRU policy.
     
     uint64_t read_accesses = 0;
@@ -257,6 +252,6 @@ class Cache : public MemObject
     }
 };
 
-typedef Cache<LRUSetWayAssocTags> SetWayAssocCache;
+typedef Cache<LRUTags> SetWayAssocCache;
 }
 #endif
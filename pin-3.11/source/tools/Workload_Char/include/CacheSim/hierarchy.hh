@@ -0,0 +1,207 @@
+#ifndef __CACHE_HIERARCHY_HH__
+#define __CACHE_HIERARCHY_HH__
+
+#include "cache.hh"
+
+#include <algorithm>
+#include <vector>
+
+namespace CacheSimulator
+{
+// Passes requests on to target, showing them to an observer on the way.
+class Tap : public MemObject
+{
+  public:
+    Tap(MemObject *_target, MemObject *_observer) : target(_target), observer(_observer) {}
+
+    bool send(Request &req) override
+    {
+        Request copy = req;
+        observer->send(copy);
+        return target->send(req);
+    }
+
+  protected:
+    MemObject *target;
+    MemObject *observer;
+};
+
+// The cache hierarchy described by a configuration: per-core L1-I/L1-D, then L2, L3 and
+// eDRAM, each level either private (one cache per core) or shared (<level>_shared = true).
+// Every valid level is connected to the next valid level below it. Shared by the pintools
+// and the offline replay driver (trace_tools/replay.cc), so both simulate the same system.
+//
+// With Wiring::LEGACY, the caches are connected as wl_char_roi used to hard-code them (for the
+// Cortex-A76): core 0's L1-I and L1-D go to the first L2, nothing goes below the L2, and there
+// is no eDRAM.
+class Hierarchy
+{
+  public:
+    typedef SetWayAssocCache Cache;
+
+    enum class Wiring { LEVELS, LEGACY };
+
+    std::vector<Cache*> L1Is, L1Ds, L2s, L3s, eDRAMs;
+
+    Hierarchy(Config &cfg, Wiring _wiring = Wiring::LEVELS)
+        : num_cores(cfg.num_cores),
+          wiring(_wiring)
+    {
+        createLevel(cfg, Config::Cache_Level::L1I, L1Is);
+        createLevel(cfg, Config::Cache_Level::L1D, L1Ds);
+        createLevel(cfg, Config::Cache_Level::L2, L2s);
+        createLevel(cfg, Config::Cache_Level::L3, L3s);
+
+        if (wiring == Wiring::LEGACY)
+        {
+            if (L2s.empty()) { return; }
+            if (!L1Is.empty()) { link(L1Is[0], L2s[0]); }
+            if (!L1Ds.empty()) { link(L1Ds[0], L2s[0]); }
+            return;
+        }
+        createLevel(cfg, Config::Cache_Level::eDRAM, eDRAMs);
+
+        // Connect each level to the next valid one.
+        std::vector<std::vector<Cache*>*> lower_levels;
+        std::vector<Cache*> *candidates[] = {&L2s, &L3s, &eDRAMs};
+        for (auto level : candidates)
+        {
+            if (!level->empty()) { lower_levels.push_back(level); }
+        }
+        if (lower_levels.empty()) { return; }
+
+        connect(L1Is, *lower_levels[0]);
+        connect(L1Ds, *lower_levels[0]);
+        for (unsigned i = 0; i + 1 < lower_levels.size(); i++)
+        {
+            connect(*lower_levels[i], *lower_levels[i + 1]);
+        }
+    }
+
+    ~Hierarchy()
+    {
+        std::vector<Cache*> *levels[] = {&L1Is, &L1Ds, &L2s, &L3s, &eDRAMs};
+        for (auto level : levels)
+        {
+            for (auto cache : *level) { delete cache; }
+        }
+        for (auto tap : taps) { delete tap; }
+    }
+
+    std::vector<Cache*> &getLevel(Config::Cache_Level lev)
+    {
+        switch (lev)
+        {
+            case Config::Cache_Level::L1I: return L1Is;
+            case Config::Cache_Level::L1D: return L1Ds;
+            case Config::Cache_Level::L2: return L2s;
+            case Config::Cache_Level::L3: return L3s;
+            default: return eDRAMs;
+        }
+    }
+
+    // Show observer every request the level above sends down to lev (not the L1s, which
+    // have no level above).
+    void observe(Config::Cache_Level lev, MemObject *observer)
+    {
+        std::vector<Cache*> &lowers = getLevel(lev);
+        for (auto &link : links)
+        {
+            if (std::find(lowers.begin(), lowers.end(), link.lower) == lowers.end()) { continue; }
+
+            // In front of the taps already there.
+            Tap *tap = new Tap(link.next, observer);
+            taps.push_back(tap);
+            link.upper->setNextLevel(tap);
+            link.next = tap;
+        }
+    }
+
+    // The caches of the last level, what leaves them goes to memory (the L1s if there is no
+    // other level).
+    std::vector<Cache*> lastLevel()
+    {
+        std::vector<Cache*> *lasts[] = {&eDRAMs, &L3s, &L2s};
+        for (auto level : lasts)
+        {
+            if (wiring == Wiring::LEGACY && level != &L2s) { continue; }
+            if (!level->empty()) { return *level; }
+        }
+
+        std::vector<Cache*> L1s(L1Is);
+        L1s.insert(L1s.end(), L1Ds.begin(), L1Ds.end());
+        return L1s;
+    }
+
+    // "L1I", "L1D", "L2", "L3" or "eDRAM"; MAX if none.
+    static Config::Cache_Level parseLevel(const std::string &name)
+    {
+        if (name == "L1I") { return Config::Cache_Level::L1I; }
+        if (name == "L1D") { return Config::Cache_Level::L1D; }
+        if (name == "L2") { return Config::Cache_Level::L2; }
+        if (name == "L3") { return Config::Cache_Level::L3; }
+        if (name == "eDRAM") { return Config::Cache_Level::eDRAM; }
+        return Config::Cache_Level::MAX;
+    }
+
+    void registerStats(Stats &stats)
+    {
+        std::vector<Cache*> *levels[] = {&L1Is, &L1Ds, &L2s, &L3s, &eDRAMs};
+        for (auto level : levels)
+        {
+            for (auto cache : *level) { cache->registerStats(stats); }
+        }
+    }
+
+  protected:
+    unsigned num_cores;
+    Wiring wiring;
+
+    struct Link
+    {
+        Cache *upper;
+        Cache *lower;
+        MemObject *next; // What upper sends to: lower, or the first tap in front of it.
+    };
+    std::vector<Link> links;
+    std::vector<Tap*> taps;
+
+    void createLevel(Config &cfg, Config::Cache_Level lev, std::vector<Cache*> &caches)
+    {
+        const Config::Cache_Info &info = cfg.caches[int(lev)];
+        if (!info.valid) { return; }
+
+        // The L1s are always private.
+        if (info.shared && lev != Config::Cache_Level::L1I && lev != Config::Cache_Level::L1D)
+        {
+            caches.emplace_back(new Cache(lev, cfg));
+            return;
+        }
+
+        for (unsigned i = 0; i < num_cores; i++)
+        {
+            caches.emplace_back(new Cache(lev, cfg));
+            caches[i]->setId(i);
+        }
+    }
+
+    // A private upper level goes to the lower cache of the same core, or to the only one if
+    // the lower level is shared.
+    void connect(std::vector<Cache*> &uppers, std::vector<Cache*> &lowers)
+    {
+        for (unsigned i = 0; i < uppers.size(); i++)
+        {
+            link(uppers[i], lowers.size() == 1 ? lowers[0] : lowers[i]);
+        }
+    }
+
+    void link(Cache *upper, Cache *lower)
+    {
+        upper->setNextLevel(lower);
+        lower->setPrevLevel(upper);
+        links.push_back(Link{upper, lower, lower});
+    }
+};
+}
+
+#endif
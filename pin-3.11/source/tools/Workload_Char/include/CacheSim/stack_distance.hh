@@ -0,0 +1,387 @@
+#ifndef __STACK_DISTANCE_HH__
+#define __STACK_DISTANCE_HH__
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Sim/mem_object.hh"
+#include "../Sim/util.hh"
+
+namespace CacheSimulator
+{
+// Reuse (LRU stack) distances of one stream of lines: the number of distinct lines accessed
+// since the previous access to the same line. Every line keeps the timestamp of its latest
+// access, and a Fenwick tree over the timestamps marks the latest ones, so a distance is a
+// prefix-sum difference (O(log n)). When the timestamps run out, the live ones are
+// renumbered in order (compaction) and the tree is rebuilt, twice as large as there are live
+// lines.
+class Reuse_Tracker
+{
+  public:
+    static const uint64_t COLD = uint64_t(-1); // First access to a line.
+
+    Reuse_Tracker(uint64_t initial_capacity = 64) : tree(initial_capacity + 1, 0) {}
+
+    uint64_t access(Addr line)
+    {
+        if (now == capacity()) { compact(); }
+
+        uint64_t distance = COLD;
+        auto iter = last_access.find(line);
+        if (iter != last_access.end())
+        {
+            uint64_t prev = iter->second;
+            distance = prefix(now) - prefix(prev + 1);
+            add(prev, -1);
+            iter->second = now;
+        }
+        else
+        {
+            last_access.insert({line, now});
+        }
+
+        add(now, 1);
+        now++;
+        return distance;
+    }
+
+    // Forget a line (it is no longer sampled).
+    void remove(Addr line)
+    {
+        auto iter = last_access.find(line);
+        if (iter == last_access.end()) { return; }
+        add(iter->second, -1);
+        last_access.erase(iter);
+    }
+
+    uint64_t numLines() const { return last_access.size(); }
+
+  protected:
+    std::unordered_map<Addr, uint64_t> last_access; // Line -> timestamp of its latest access.
+    std::vector<int64_t> tree; // Fenwick tree (1-based) over the timestamps.
+    uint64_t now = 0;
+
+    uint64_t capacity() const { return tree.size() - 1; }
+
+    void add(uint64_t time, int64_t val)
+    {
+        for (uint64_t i = time + 1; i < tree.size(); i += i & -i) { tree[i] += val; }
+    }
+
+    // Number of latest accesses with timestamps in [0, time).
+    uint64_t prefix(uint64_t time) const
+    {
+        int64_t sum = 0;
+        for (uint64_t i = time; i > 0; i -= i & -i) { sum += tree[i]; }
+        return sum;
+    }
+
+    void compact()
+    {
+        std::vector<std::pair<uint64_t, Addr>> live;
+        live.reserve(last_access.size());
+        for (auto &entry : last_access) { live.emplace_back(entry.second, entry.first); }
+        std::sort(live.begin(), live.end());
+
+        for (uint64_t i = 0; i < live.size(); i++) { last_access[live[i].second] = i; }
+        now = live.size();
+
+        // Every timestamp below now is live: build the tree in O(n). The nodes past now
+        // still have to pass their children's sums up.
+        tree.assign(std::max<uint64_t>(2 * now, 64) + 1, 0);
+        for (uint64_t i = 1; i < tree.size(); i++)
+        {
+            if (i <= now) { tree[i] += 1; }
+            uint64_t parent = i + (i & -i);
+            if (parent < tree.size()) { tree[parent] += tree[i]; }
+        }
+    }
+};
+
+// Mattson stack-distance profiler: the miss-ratio curve of every LRU cache size in one pass.
+// With set_counts, it profiles each set count separately (the distance is then counted within
+// the set of the line), which gives the curve of every associativity for that number of sets;
+// one set is the fully-associative curve. It is a MemObject, so it can take the place of (or
+// sit after) any level, or be fed the access stream directly with send().
+//
+// Sampling (SHARDS, Waldspurger et al., FAST'15) bounds the cost for large footprints: only
+// the lines whose hash falls below a threshold T (out of MODULUS) are tracked, i.e., a rate
+// R = T / MODULUS of them, and their distances and counts are scaled by 1 / R.
+//     - Fixed rate: R stays as given.
+//     - Fixed size (max_lines): starting from the given rate, whenever more than max_lines
+//       lines are sampled, T drops to the largest sampled hash and the lines at or above it are
+//       dropped, so memory stays bounded whatever the footprint.
+// Miss ratios are normalized by the number of accesses rather than by the sampled count,
+// which is the SHARDS_adj correction (the difference would all be distance-0 hits). Sampled
+// distances go to log-linear buckets (within about 3% with BUCKET_BITS = 6) instead of one
+// bin per distance; the exact profiler keeps one bin per distance.
+class StackDistance : public MemObject
+{
+  public:
+    static const uint64_t MODULUS = uint64_t(1) << 24;
+    static const unsigned BUCKET_BITS = 6;
+
+    StackDistance(unsigned _block_size, const std::vector<unsigned> &set_counts,
+                  double rate = 1.0, uint64_t _max_lines = 0)
+        : block_size(_block_size),
+          block_shift(log2(block_size)),
+          threshold(uint64_t(rate * MODULUS + 0.5)),
+          max_lines(_max_lines),
+          sampling(threshold < MODULUS || max_lines > 0)
+    {
+        assert((1u << block_shift) == block_size);
+        assert(threshold > 0 && threshold <= MODULUS);
+        for (auto num_sets : set_counts)
+        {
+            assert(num_sets > 0 && (num_sets & (num_sets - 1)) == 0);
+            profiles.emplace_back();
+            profiles.back().num_sets = num_sets;
+            profiles.back().sets.resize(num_sets);
+        }
+    }
+
+    bool send(Request &req) override
+    {
+        Addr line = req.addr >> block_shift;
+        accesses++;
+
+        if (sampling)
+        {
+            uint64_t hash = hashLine(line) & (MODULUS - 1);
+            if (hash >= threshold) { return false; }
+
+            if (max_lines > 0 && sampled_lines.insert(std::make_pair(line, hash)).second)
+            {
+                by_hash.push(std::make_pair(hash, line));
+                if (sampled_lines.size() > max_lines) { lowerThreshold(); }
+                if (hash >= threshold) { return false; }
+            }
+        }
+
+        double scale = double(MODULUS) / double(threshold);
+        for (auto &profile : profiles)
+        {
+            Reuse_Tracker &set = profile.sets[line & (profile.num_sets - 1)];
+            uint64_t distance = set.access(line);
+            if (distance == Reuse_Tracker::COLD)
+            {
+                profile.cold += scale;
+                continue;
+            }
+
+            uint64_t bucket = sampling ? toBucket(uint64_t(distance * scale)) : distance;
+            if (bucket >= profile.hist.size()) { profile.hist.resize(bucket + 1, 0); }
+            profile.hist[bucket] += scale;
+        }
+        return false;
+    }
+
+    // "1,64,512" -> {1, 64, 512}
+    static std::vector<unsigned> parseSetCounts(const std::string &list)
+    {
+        std::vector<unsigned> set_counts;
+        std::istringstream in(list);
+        std::string token;
+        while (getline(in, token, ','))
+        {
+            if (!token.empty()) { set_counts.push_back(atoi(token.c_str())); }
+        }
+        return set_counts;
+    }
+
+    // Miss ratio of an LRU cache with num_sets (one of the profiled set counts) and assoc.
+    double missRatio(unsigned num_sets, uint64_t assoc) const
+    {
+        const Profile &profile = getProfile(num_sets);
+        return accesses == 0 ? 0 : misses(profile, assoc) / double(accesses);
+    }
+
+    // Smallest associativity a sampled profile resolves: with rate R, a distance is only
+    // known to about 1 / R.
+    uint64_t resolution() const { return uint64_t(ceil(double(MODULUS) / double(threshold))); }
+
+    // Mean absolute error of the miss ratios of approx against exact, over the power-of-two
+    // associativities from approx's resolution up to the largest distance exact has seen.
+    static double meanAbsoluteError(const StackDistance &exact, const StackDistance &approx,
+                                    unsigned num_sets)
+    {
+        uint64_t max_assoc = exact.maxAssoc(exact.getProfile(num_sets));
+        uint64_t assoc = 1;
+        while (assoc < approx.resolution() && assoc < max_assoc) { assoc *= 2; }
+
+        double error = 0;
+        unsigned num_points = 0;
+        for (; ; assoc *= 2)
+        {
+            error += std::abs(exact.missRatio(num_sets, assoc) -
+                              approx.missRatio(num_sets, assoc));
+            num_points++;
+            if (assoc >= max_assoc) { break; }
+        }
+        return error / num_points;
+    }
+
+    // Miss ratios at power-of-two associativities (and sizes, for one set), from the
+    // resolution() of a sampled profile.
+    void registerStats(Stats &stats) override
+    {
+        stats.registerStats("Stack distance: Number of accesses = " + to_string(accesses));
+        if (sampling)
+        {
+            stats.registerStats("Stack distance: Sampling rate = " +
+                                to_string(double(threshold) / double(MODULUS)));
+            uint64_t num_lines = 0;
+            for (auto &set : profiles[0].sets) { num_lines += set.numLines(); }
+            stats.registerStats("Stack distance: Number of sampled lines = " +
+                                to_string(num_lines));
+        }
+        for (auto &profile : profiles)
+        {
+            std::string name = "Stack distance (" + to_string(profile.num_sets) + " sets)";
+            stats.registerStats(name + ": Number of cold misses = " +
+                                to_string(uint64_t(profile.cold)));
+
+            uint64_t max_assoc = maxAssoc(profile);
+            uint64_t assoc = 1;
+            while (assoc < resolution() && assoc < max_assoc) { assoc *= 2; }
+            for (; ; assoc *= 2)
+            {
+                double size_kb = double(profile.num_sets * assoc * block_size) / 1024;
+                stats.registerStats(name + ": Assoc " + to_string(assoc) +
+                                    " (" + to_string(size_kb) + "kB): Miss ratio = " +
+                                    to_string(missRatio(profile.num_sets, assoc) * 100) + "%");
+                if (assoc >= max_assoc) { break; }
+            }
+            stats.registerStats("");
+        }
+    }
+
+    // The whole curves as CSV: one row wherever the miss ratio changes.
+    void outputCurves(const std::string &fn) const
+    {
+        std::ofstream out(fn.c_str());
+        out << "sets,assoc,size_bytes,miss_ratio\n";
+        for (auto &profile : profiles)
+        {
+            double num_misses = misses(profile, 1);
+            for (uint64_t bucket = 0; bucket < profile.hist.size(); bucket++)
+            {
+                // From assoc - 1 to assoc ways, the distances of the bucket turn into hits.
+                uint64_t assoc = lowerBound(bucket) + 1;
+                if (assoc > 1)
+                {
+                    if (profile.hist[bucket] == 0) { continue; }
+                    num_misses -= profile.hist[bucket];
+                }
+                out << profile.num_sets << "," << assoc << ","
+                    << uint64_t(profile.num_sets) * assoc * block_size << ","
+                    << std::max(num_misses, 0.0) / double(accesses) << "\n";
+            }
+        }
+    }
+
+  protected:
+    const unsigned block_size;
+    const unsigned block_shift;
+
+    uint64_t accesses = 0;
+
+    // Sampling state.
+    uint64_t threshold;
+    const uint64_t max_lines;
+    const bool sampling;
+    std::unordered_map<Addr, uint64_t> sampled_lines; // Line -> hash, fixed size only.
+    std::priority_queue<std::pair<uint64_t, Addr>> by_hash; // Sampled lines, largest hash first.
+
+    struct Profile
+    {
+        unsigned num_sets;
+        std::vector<Reuse_Tracker> sets;
+
+        std::vector<double> hist; // (Scaled) number of accesses in each distance bucket.
+        double cold = 0;
+    };
+    std::vector<Profile> profiles;
+
+    // splitmix64 finalizer.
+    static uint64_t hashLine(Addr line)
+    {
+        uint64_t x = line + 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // Drop the lines with the largest hash until there are at most max_lines.
+    void lowerThreshold()
+    {
+        threshold = by_hash.top().first;
+        while (!by_hash.empty() && by_hash.top().first >= threshold)
+        {
+            Addr line = by_hash.top().second;
+            by_hash.pop();
+            sampled_lines.erase(line);
+            for (auto &profile : profiles)
+            {
+                profile.sets[line & (profile.num_sets - 1)].remove(line);
+            }
+        }
+    }
+
+    // Log-linear buckets: exact below 2^BUCKET_BITS, then 2^(BUCKET_BITS - 1) buckets per
+    // power of two.
+    static uint64_t toBucket(uint64_t distance)
+    {
+        const uint64_t sub = uint64_t(1) << BUCKET_BITS;
+        if (distance < sub) { return distance; }
+        unsigned shift = 63 - __builtin_clzll(distance) - BUCKET_BITS + 1;
+        return shift * (sub / 2) + (distance >> shift);
+    }
+
+    // Smallest distance in a bucket.
+    uint64_t lowerBound(uint64_t bucket) const
+    {
+        const uint64_t sub = uint64_t(1) << BUCKET_BITS;
+        if (!sampling || bucket < sub) { return bucket; }
+        uint64_t shift = bucket / (sub / 2) - 1;
+        uint64_t mantissa = bucket - shift * (sub / 2);
+        return mantissa << shift;
+    }
+
+    // An access hits with assoc ways iff its distance is below assoc.
+    double misses(const Profile &profile, uint64_t assoc) const
+    {
+        double num_misses = profile.cold;
+        for (uint64_t bucket = 0; bucket < profile.hist.size(); bucket++)
+        {
+            if (lowerBound(bucket) >= assoc) { num_misses += profile.hist[bucket]; }
+        }
+        return num_misses;
+    }
+
+    uint64_t maxAssoc(const Profile &profile) const
+    {
+        return profile.hist.empty() ? 1 : lowerBound(profile.hist.size() - 1) + 1;
+    }
+
+    const Profile &getProfile(unsigned num_sets) const
+    {
+        for (auto &profile : profiles)
+        {
+            if (profile.num_sets == num_sets) { return profile; }
+        }
+        assert(false && "Set count not profiled");
+        return profiles[0];
+    }
+};
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef __CACHE_STATIC_CONFIGS_HH__
+#define __CACHE_STATIC_CONFIGS_HH__
+
+#include "static_hierarchy.hh"
+
+// Generated by trace_tools/gen_static_configs, do not edit (make -C trace_tools static_configs).
+namespace CacheSimulator
+{
+// cortex-a76.cfg
+typedef StaticConfig<1, 64,
+                     Level<64, 4>, Level<64, 4>,
+                     Level<128, 8>, NoLevel, NoLevel> Cortex_A76_Config;
+
+// jetson.cfg
+typedef StaticConfig<4, 64,
+                     NoLevel, Level<32, 2>,
+                     Level<2048, 16, true>, NoLevel, NoLevel> Jetson_Config;
+
+// pi3.cfg
+typedef StaticConfig<4, 64,
+                     NoLevel, Level<32, 4>,
+                     Level<512, 16, true>, NoLevel, NoLevel> Pi3_Config;
+
+// pi4.cfg
+typedef StaticConfig<4, 64,
+                     NoLevel, Level<32, 2>,
+                     Level<1024, 16, true>, NoLevel, NoLevel> Pi4_Config;
+
+// power9.cfg
+typedef StaticConfig<2, 128,
+                     NoLevel, Level<32, 8>,
+                     Level<512, 8, true>, Level<10240, 20, true>, NoLevel> Power9_Config;
+
+// skylake.cfg
+typedef StaticConfig<1, 64,
+                     Level<32, 8>, Level<32, 8>,
+                     Level<256, 4>, Level<2048, 16>, NoLevel> Skylake_Config;
+
+// The compile-time hierarchy of cfg, nullptr if none of the above is cfg.
+inline StaticHierarchyBase *createStaticHierarchy(Config &cfg)
+{
+    if (StaticHierarchy<Cortex_A76_Config>::matches(cfg))
+    {
+        return new StaticHierarchy<Cortex_A76_Config>(cfg);
+    }
+    if (StaticHierarchy<Jetson_Config>::matches(cfg))
+    {
+        return new StaticHierarchy<Jetson_Config>(cfg);
+    }
+    if (StaticHierarchy<Pi3_Config>::matches(cfg))
+    {
+        return new StaticHierarchy<Pi3_Config>(cfg);
+    }
+    if (StaticHierarchy<Pi4_Config>::matches(cfg))
+    {
+        return new StaticHierarchy<Pi4_Config>(cfg);
+    }
+    if (StaticHierarchy<Power9_Config>::matches(cfg))
+    {
+        return new StaticHierarchy<Power9_Config>(cfg);
+    }
+    if (StaticHierarchy<Skylake_Config>::matches(cfg))
+    {
+        return new StaticHierarchy<Skylake_Config>(cfg);
+    }
+    return nullptr;
+}
+}
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef __CACHE_STATIC_HIERARCHY_HH__
+#define __CACHE_STATIC_HIERARCHY_HH__
+
+#include "cache.hh"
+#include "tags/packed_set_assoc_tags.hh"
+
+#include <vector>
+
+namespace CacheSimulator
+{
+// A cache hierarchy fixed at compile time, for the configurations simulated all the time
+// (static_configs.hh has the ones of configs/, see trace_tools/gen_static_configs.cc). It is
+// the hierarchy Hierarchy builds from the same configuration (same levels, same wiring, same
+// stats), but every level knows its geometry and the exact type of the level below:
+//     1) the tags have constant strides, shifts and masks (PackedTags<BLOCK, ASSOC, SETS>);
+//     2) a miss calls the send() of the next level directly, not through MemObject.
+// An access that hits in L1 is then a single inlined call. Invalidations of the upper levels
+// (on evictions) still go through MemObject.
+//
+// A level, as in a configuration file: <level>_size (kB), <level>_assoc and <level>_shared.
+template<unsigned SIZE_KB, unsigned ASSOC, bool SHARED = false>
+struct Level
+{
+    static const bool valid = true;
+    static const unsigned size_kb = SIZE_KB;
+    static const unsigned assoc = ASSOC;
+    static const bool shared = SHARED;
+};
+
+// A level the configuration does not have.
+struct NoLevel
+{
+    static const bool valid = false;
+    static const unsigned size_kb = 0;
+    static const unsigned assoc = 1;
+    static const bool shared = false;
+};
+
+template<unsigned NUM_CORES, unsigned BLOCK_SIZE, typename L1I_, typename L1D_,
+         typename L2_ = NoLevel, typename L3_ = NoLevel, typename eDRAM_ = NoLevel>
+struct StaticConfig
+{
+    static const unsigned num_cores = NUM_CORES;
+    static const unsigned block_size = BLOCK_SIZE;
+    typedef L1I_ L1I;
+    typedef L1D_ L1D;
+    typedef L2_ L2;
+    typedef L3_ L3;
+    typedef eDRAM_ eDRAM;
+};
+
+// What Platforms needs of a compile-time hierarchy, whatever its configuration.
+class StaticHierarchyBase
+{
+  public:
+    virtual ~StaticHierarchyBase() {}
+
+    // Instruction fetch (nothing without an L1-I) and data access of a core.
+    virtual void fetch(unsigned core, Request &req) = 0;
+    virtual void access(unsigned core, Request &req) = 0;
+
+    // See Hierarchy::lastLevel().
+    virtual std::vector<MemObject*> lastLevel() = 0;
+
+    virtual void registerStats(Stats &stats) = 0;
+};
+
+template<bool COND, typename A, typename B> struct If { typedef A type; };
+template<typename A, typename B> struct If<false, A, B> { typedef B type; };
+
+template<typename C>
+class StaticHierarchy : public StaticHierarchyBase
+{
+  public:
+    template<typename L, typename Next>
+    struct Level_Cache
+    {
+        typedef Cache<PackedTags<C::block_size, L::assoc,
+                                 L::size_kb * 1024 / (C::block_size * L::assoc)>, Next> type;
+    };
+
+    // From the bottom up, each level sends to the next one the configuration has.
+    typedef typename Level_Cache<typename C::eDRAM, MemObject>::type eDRAM_Cache;
+    typedef typename If<C::eDRAM::valid, eDRAM_Cache, MemObject>::type Below_L3;
+    typedef typename Level_Cache<typename C::L3, Below_L3>::type L3_Cache;
+    typedef typename If<C::L3::valid, L3_Cache, Below_L3>::type Below_L2;
+    typedef typename Level_Cache<typename C::L2, Below_L2>::type L2_Cache;
+    typedef typename If<C::L2::valid, L2_Cache, Below_L2>::type Below_L1;
+    typedef typename Level_Cache<typename C::L1I, Below_L1>::type L1I_Cache;
+    typedef typename Level_Cache<typename C::L1D, Below_L1>::type L1D_Cache;
+
+    std::vector<L1I_Cache*> L1Is;
+    std::vector<L1D_Cache*> L1Ds;
+    std::vector<L2_Cache*> L2s;
+    std::vector<L3_Cache*> L3s;
+    std::vector<eDRAM_Cache*> eDRAMs;
+
+    // Whether cfg is the configuration C describes.
+    static bool matches(Config &cfg)
+    {
+        return cfg.num_cores == C::num_cores && cfg.block_size == C::block_size &&
+               matches<typename C::L1I>(cfg, Config::Cache_Level::L1I) &&
+               matches<typename C::L1D>(cfg, Config::Cache_Level::L1D) &&
+               matches<typename C::L2>(cfg, Config::Cache_Level::L2) &&
+               matches<typename C::L3>(cfg, Config::Cache_Level::L3) &&
+               matches<typename C::eDRAM>(cfg, Config::Cache_Level::eDRAM);
+    }
+
+    StaticHierarchy(Config &cfg)
+    {
+        assert(matches(cfg));
+
+        createLevel<typename C::L1I>(cfg, Config::Cache_Level::L1I, L1Is);
+        createLevel<typename C::L1D>(cfg, Config::Cache_Level::L1D, L1Ds);
+        createLevel<typename C::L2>(cfg, Config::Cache_Level::L2, L2s);
+        createLevel<typename C::L3>(cfg, Config::Cache_Level::L3, L3s);
+        createLevel<typename C::eDRAM>(cfg, Config::Cache_Level::eDRAM, eDRAMs);
+
+        connectBelowL1(L1Is);
+        connectBelowL1(L1Ds);
+        connectBelowL2(L2s);
+        connectBelowL3(L3s);
+    }
+
+    ~StaticHierarchy()
+    {
+        deleteLevel(L1Is);
+        deleteLevel(L1Ds);
+        deleteLevel(L2s);
+        deleteLevel(L3s);
+        deleteLevel(eDRAMs);
+    }
+
+    void fetch(unsigned core, Request &req) override
+    {
+        if constexpr (C::L1I::valid) { L1Is[core]->send(req); }
+    }
+
+    void access(unsigned core, Request &req) override
+    {
+        if constexpr (C::L1D::valid) { L1Ds[core]->send(req); }
+    }
+
+    std::vector<MemObject*> lastLevel() override
+    {
+        std::vector<MemObject*> caches;
+        if constexpr (C::eDRAM::valid) { addLevel(eDRAMs, caches); }
+        else if constexpr (C::L3::valid) { addLevel(L3s, caches); }
+        else if constexpr (C::L2::valid) { addLevel(L2s, caches); }
+        else
+        {
+            addLevel(L1Is, caches);
+            addLevel(L1Ds, caches);
+        }
+        return caches;
+    }
+
+    void registerStats(Stats &stats) override
+    {
+        registerLevel(L1Is, stats);
+        registerLevel(L1Ds, stats);
+        registerLevel(L2s, stats);
+        registerLevel(L3s, stats);
+        registerLevel(eDRAMs, stats);
+    }
+
+  protected:
+    template<typename L>
+    static bool matches(Config &cfg, Config::Cache_Level lev)
+    {
+        const Config::Cache_Info &info = cfg.caches[int(lev)];
+        if (info.valid != L::valid) { return false; }
+        if (!L::valid) { return true; }
+
+        // The L1s are always private (see Hierarchy).
+        bool private_only = lev == Config::Cache_Level::L1I || lev == Config::Cache_Level::L1D;
+        return unsigned(info.assoc) == L::assoc && info.size == L::size_kb &&
+               (private_only || info.shared == L::shared);
+    }
+
+    // As Hierarchy::createLevel().
+    template<typename L, typename T>
+    void createLevel(Config &cfg, Config::Cache_Level lev, std::vector<T*> &caches)
+    {
+        if constexpr (L::valid)
+        {
+            if (L::shared && lev != Config::Cache_Level::L1I && lev != Config::Cache_Level::L1D)
+            {
+                caches.push_back(new T(lev, cfg));
+                return;
+            }
+
+            for (unsigned i = 0; i < C::num_cores; i++)
+            {
+                caches.push_back(new T(lev, cfg));
+                caches[i]->setId(i);
+            }
+        }
+    }
+
+    // As Hierarchy::connect().
+    template<typename U, typename L>
+    static void connect(std::vector<U*> &uppers, std::vector<L*> &lowers)
+    {
+        for (unsigned i = 0; i < uppers.size(); i++)
+        {
+            L *lower = lowers.size() == 1 ? lowers[0] : lowers[i];
+            uppers[i]->setNextLevel(lower);
+            lower->setPrevLevel(uppers[i]);
+        }
+    }
+
+    template<typename U>
+    void connectBelowL1(std::vector<U*> &uppers)
+    {
+        if constexpr (C::L2::valid) { connect(uppers, L2s); }
+        else { connectBelowL2(uppers); }
+    }
+
+    template<typename U>
+    void connectBelowL2(std::vector<U*> &uppers)
+    {
+        if constexpr (C::L3::valid) { connect(uppers, L3s); }
+        else { connectBelowL3(uppers); }
+    }
+
+    template<typename U>
+    void connectBelowL3(std::vector<U*> &uppers)
+    {
+        if constexpr (C::eDRAM::valid) { connect(uppers, eDRAMs); }
+    }
+
+    template<typename T>
+    static void addLevel(std::vector<T*> &level, std::vector<MemObject*> &caches)
+    {
+        for (auto cache : level) { caches.push_back(cache); }
+    }
+
+    template<typename T>
+    static void registerLevel(std::vector<T*> &caches, Stats &stats)
+    {
+        for (auto cache : caches) { cache->registerStats(stats); }
+    }
+
+    template<typename T>
+    static void deleteLevel(std::vector<T*> &caches)
+    {
+        for (auto cache : caches) { delete cache; }
+    }
+};
+}
+
+#endif
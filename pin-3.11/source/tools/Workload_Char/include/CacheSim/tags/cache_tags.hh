@@ -25,6 +25,8 @@ class Tags
     {
     }
 
+    virtual ~Tags() {}
+
     std::string level_str;
 
   protected:
@@ -0,0 +1,303 @@
+#ifndef __CACHE_PACKED_SET_ASSOC_TAGS_HH__
+#define __CACHE_PACKED_SET_ASSOC_TAGS_HH__
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "../../Sim/config.hh"
+#include "../../Sim/request.hh"
+
+#include "set_assoc_tags.hh"
+
+namespace CacheSimulator
+{
+// LRU set-associative tags as a structure of arrays, for the caches that are looked up on every
+// access. Per set:
+//     1) the tags of the ways, contiguous (padded to a multiple of 4 ways);
+//     2) a valid and a dirty bitmask (bit w for way w, up to 64 ways);
+//     3) the LRU order, one byte per way (0 for the most recently used, assoc - 1 for the least
+//        recently used; padded to a multiple of 16 ways).
+// A lookup compares the tag against all the ways at once (SSE2, or AVX2 when the compiler
+// targets it), a touch ages all the ways at once, and nothing is allocated.
+//
+// Same interface as the Tags classes (see cache.hh), and the same decisions as
+// LRUSetWayAssocTags: a miss fills the first invalid way, otherwise the least recently used
+// one. The stats of a Cache are identical with either.
+//
+// Up to MAX_ASSOC ways (see LRUTags for any associativity).
+//
+// The geometry comes from the configuration (PackedLRUTags), or is fixed at compile time by
+// the template parameters (see static_hierarchy.hh), which turns the strides, shifts and masks
+// into constants and unrolls the loops over the ways.
+template<unsigned BLOCK_SIZE = 0, unsigned ASSOC = 0, unsigned NUM_SETS = 0>
+class PackedTags
+{
+  public:
+    static const unsigned MAX_ASSOC = 64; // The bits of a valid or dirty mask.
+    static_assert(ASSOC <= MAX_ASSOC, "Too many ways for the packed tags");
+
+    const Addr MaxAddr = (Addr) - 1;
+
+    std::string level_str;
+
+    PackedTags(int level, Config &cfg)
+        : cfg_block_size(cfg.block_size),
+          cfg_assoc(cfg.caches[level].assoc),
+          cfg_num_sets(cfg.caches[level].size * 1024ULL / (cfg_block_size * cfg_assoc)),
+          set_shift(log2(blockSize())),
+          tag_shift(set_shift + log2(numSets())),
+          tags(numSets() * tagStride(), 0),
+          ages(numSets() * ageStride(), PADDING_AGE),
+          valid(numSets(), 0),
+          dirty(numSets(), 0)
+    {
+        // A fixed geometry must be the configured one.
+        assert(BLOCK_SIZE == 0 || BLOCK_SIZE == cfg_block_size);
+        assert(ASSOC == 0 || ASSOC == cfg_assoc);
+        assert(NUM_SETS == 0 || NUM_SETS == cfg_num_sets);
+        assert(assoc() > 0 && assoc() <= MAX_ASSOC);
+
+        // Any order of the ways will do to start with, the invalid ones are filled first.
+        for (uint32_t set = 0; set < numSets(); set++)
+        {
+            for (unsigned way = 0; way < assoc(); way++) { ages[set * ageStride() + way] = way; }
+        }
+    }
+
+    // return val: <hit in cache?, block-aligned address>
+    std::pair<bool, Addr> accessBlock(Addr addr, bool modify, Tick cur_clk = 0)
+    {
+        Addr blk_aligned_addr = blkAlign(addr);
+        uint32_t set = extractSet(blk_aligned_addr);
+
+        int way = findWay(set, extractTag(blk_aligned_addr));
+        if (way < 0) { return std::make_pair(false, blk_aligned_addr); }
+
+        touch(set, way);
+        if (modify) { dirty[set] |= uint64_t(1) << way; }
+        return std::make_pair(true, blk_aligned_addr);
+    }
+
+    // return val: <write-back required?, write-back address>
+    std::pair<bool, Addr> insertBlock(Addr addr, bool modify, Tick cur_clk = 0)
+    {
+        uint32_t set = extractSet(addr);
+
+        bool wb_required = false;
+        Addr victim_addr = MaxAddr;
+
+        unsigned way;
+        uint64_t invalid = ~valid[set] & allWays();
+        if (invalid != 0)
+        {
+            way = __builtin_ctzll(invalid);
+        }
+        else
+        {
+            way = findLRU(set);
+            wb_required = (dirty[set] >> way) & 1;
+            victim_addr = regenerateAddr(set, way); // To be invalidated in the upper levels.
+        }
+
+        uint64_t bit = uint64_t(1) << way;
+        tags[set * tagStride() + way] = extractTag(addr);
+        valid[set] |= bit;
+        if (modify) { dirty[set] |= bit; }
+        else { dirty[set] &= ~bit; }
+        touch(set, way);
+
+        return std::make_pair(wb_required, victim_addr);
+    }
+
+    void inval(uint64_t _addr)
+    {
+        uint32_t set = extractSet(_addr);
+        int way = findWay(set, extractTag(_addr));
+        if (way < 0) { return; }
+
+        uint64_t bit = uint64_t(1) << way;
+        valid[set] &= ~bit;
+        dirty[set] &= ~bit;
+    }
+
+    void printTagInfo()
+    {
+        std::cout << "Assoc: " << assoc() << "\n";
+        std::cout << "Number of sets: " << numSets() << "\n";
+    }
+
+  protected:
+    // Never younger than a real way, so touches leave the padding alone.
+    static const uint8_t PADDING_AGE = 127;
+
+    const unsigned cfg_block_size;
+    const unsigned cfg_assoc;
+    const uint32_t cfg_num_sets;
+    const int set_shift;
+    const int tag_shift;
+
+    std::vector<Addr> tags;
+    std::vector<uint8_t> ages;
+    std::vector<uint64_t> valid;
+    std::vector<uint64_t> dirty;
+
+    unsigned blockSize() const { return BLOCK_SIZE != 0 ? BLOCK_SIZE : cfg_block_size; }
+    unsigned assoc() const { return ASSOC != 0 ? ASSOC : cfg_assoc; }
+    uint32_t numSets() const { return NUM_SETS != 0 ? NUM_SETS : cfg_num_sets; }
+    unsigned tagStride() const { return (assoc() + 3) & ~3u; }
+    unsigned ageStride() const { return (assoc() + 15) & ~15u; }
+
+    // Constants too when the geometry is fixed (both sizes are powers of two).
+    int setShift() const { return BLOCK_SIZE != 0 ? __builtin_ctz(BLOCK_SIZE) : set_shift; }
+    int tagShift() const
+    {
+        return BLOCK_SIZE != 0 && NUM_SETS != 0 ?
+               __builtin_ctz(BLOCK_SIZE) + __builtin_ctz(NUM_SETS) : tag_shift;
+    }
+
+    Addr blkAlign(Addr addr) const { return addr & ~Addr(blockSize() - 1); }
+
+    uint32_t extractSet(Addr addr) const { return (addr >> setShift()) & (numSets() - 1); }
+
+    Addr extractTag(Addr addr) const { return addr >> tagShift(); }
+
+    Addr regenerateAddr(uint32_t set, unsigned way) const
+    {
+        return (tags[set * tagStride() + way] << tagShift()) | (Addr(set) << setShift());
+    }
+
+    uint64_t allWays() const
+    {
+        return assoc() == 64 ? ~uint64_t(0) : (uint64_t(1) << assoc()) - 1;
+    }
+
+    // The valid way holding tag, -1 if none.
+    int findWay(uint32_t set, Addr tag) const
+    {
+        const Addr *set_tags = &tags[set * tagStride()];
+        uint64_t match = 0;
+#ifdef __AVX2__
+        __m256i key = _mm256_set1_epi64x(tag);
+        for (unsigned way = 0; way < assoc(); way += 4)
+        {
+            __m256i eq = _mm256_cmpeq_epi64(
+                _mm256_loadu_si256((const __m256i *)(set_tags + way)), key);
+            match |= uint64_t(_mm256_movemask_pd(_mm256_castsi256_pd(eq))) << way;
+        }
+#else
+        // No 64-bit compare in SSE2: both halves of a tag must match.
+        __m128i key = _mm_set1_epi64x(tag);
+        for (unsigned way = 0; way < assoc(); way += 2)
+        {
+            __m128i eq = _mm_cmpeq_epi32(
+                _mm_loadu_si128((const __m128i *)(set_tags + way)), key);
+            eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+            match |= uint64_t(_mm_movemask_pd(_mm_castsi128_pd(eq))) << way;
+        }
+#endif
+        match &= valid[set];
+        return match == 0 ? -1 : __builtin_ctzll(match);
+    }
+
+    // Make way the most recently used: the ways more recent than it age by one.
+    void touch(uint32_t set, unsigned way)
+    {
+        uint8_t *set_ages = &ages[set * ageStride()];
+        __m128i age = _mm_set1_epi8(set_ages[way]);
+        for (unsigned i = 0; i < ageStride(); i += 16)
+        {
+            __m128i *chunk = (__m128i *)(set_ages + i);
+            __m128i ages_16 = _mm_loadu_si128(chunk);
+            // Younger ways compare to all ones (-1), subtracting it adds one.
+            _mm_storeu_si128(chunk, _mm_sub_epi8(ages_16, _mm_cmplt_epi8(ages_16, age)));
+        }
+        set_ages[way] = 0;
+    }
+
+    // The way of age assoc - 1.
+    unsigned findLRU(uint32_t set) const
+    {
+        const uint8_t *set_ages = &ages[set * ageStride()];
+        __m128i oldest = _mm_set1_epi8(assoc() - 1);
+        uint64_t match = 0;
+        for (unsigned i = 0; i < ageStride(); i += 16)
+        {
+            __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(set_ages + i)), oldest);
+            match |= uint64_t(unsigned(_mm_movemask_epi8(eq))) << i;
+        }
+        match &= allWays();
+        assert(match != 0);
+        return __builtin_ctzll(match);
+    }
+};
+typedef PackedTags<> PackedLRUTags;
+
+// The tags of SetWayAssocCache: PackedLRUTags when the ways fit in its masks, otherwise (a
+// highly or fully associative level) LRUSetWayAssocTags, which takes any associativity. The
+// decisions, and so the stats, are the same with either.
+class LRUTags
+{
+  public:
+    std::string level_str;
+
+    LRUTags(int level, Config &cfg)
+    {
+        if (unsigned(cfg.caches[level].assoc) <= PackedLRUTags::MAX_ASSOC)
+        {
+            packed = new PackedLRUTags(level, cfg);
+        }
+        else
+        {
+            wide = new LRUSetWayAssocTags(level, cfg);
+        }
+    }
+
+    ~LRUTags()
+    {
+        delete packed;
+        delete wide;
+    }
+
+    LRUTags(const LRUTags &) = delete;
+    LRUTags &operator=(const LRUTags &) = delete;
+
+    std::pair<bool, Addr> accessBlock(Addr addr, bool modify, Tick cur_clk = 0)
+    {
+        if (packed != nullptr) { return packed->accessBlock(addr, modify, cur_clk); }
+        return wide->accessBlock(addr, modify, cur_clk);
+    }
+
+    std::pair<bool, Addr> insertBlock(Addr addr, bool modify, Tick cur_clk = 0)
+    {
+        if (packed != nullptr) { return packed->insertBlock(addr, modify, cur_clk); }
+        return wide->insertBlock(addr, modify, cur_clk);
+    }
+
+    void inval(uint64_t _addr)
+    {
+        if (packed != nullptr) { packed->inval(_addr); }
+        else { wide->inval(_addr); }
+    }
+
+    void printTagInfo()
+    {
+        if (packed != nullptr) { packed->printTagInfo(); }
+        else { wide->printTagInfo(); }
+    }
+
+  protected:
+    PackedLRUTags *packed = nullptr;
+    LRUSetWayAssocTags *wide = nullptr;
+};
+}
+
+#endif
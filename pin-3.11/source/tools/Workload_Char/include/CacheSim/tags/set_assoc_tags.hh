@@ -2,6 +2,8 @@
 #define __CACHE_SET_ASSOC_TAGS_HH__
 
 #include <assert.h>
+#include <cmath>
+#include <iostream>
 
 #include "../cache_blk.hh"
 
@@ -138,7 +140,7 @@ class SetWayAssocTags : public TagsWithSetWayBlk
         Addr tag = extractTag(addr);
 
         // Extract the set
-        const std::vector<SetWayBlk *> set = sets[extractSet(addr)];
+        const std::vector<SetWayBlk *> &set = sets[extractSet(addr)];
 
         for (const auto& way : set)
         {
@@ -153,7 +155,7 @@ class SetWayAssocTags : public TagsWithSetWayBlk
     victimRet findVictim(Addr addr) override
     {
         // Extract the set
-        const std::vector<SetWayBlk *> set = sets[extractSet(addr)];
+        const std::vector<SetWayBlk *> &set = sets[extractSet(addr)];
 
         // Get the victim block based on replacement policy
         auto ret = policy.findVictim(set);
@@ -0,0 +1,98 @@
+#ifndef __BUFFER_QUEUE_HH__
+#define __BUFFER_QUEUE_HH__
+
+#include <deque>
+
+#include "pin.H"
+
+// A FIFO of trace buffers (or anything else) between application threads and the tool's
+// internal threads, in the spirit of MemTrace/membuffer_threadpool.cpp but with Pin locks and
+// semaphores only (the Pin CRT has no condition variables).
+template<typename T>
+class Buffer_Queue
+{
+  public:
+    Buffer_Queue()
+    {
+        PIN_InitLock(&lock);
+        PIN_SemaphoreInit(&not_empty);
+    }
+
+    ~Buffer_Queue()
+    {
+        PIN_SemaphoreFini(&not_empty);
+    }
+
+    // Fails once the queue is closed.
+    bool push(const T &elem, THREADID t_id)
+    {
+        PIN_GetLock(&lock, t_id + 1);
+        if (closed)
+        {
+            PIN_ReleaseLock(&lock);
+            return false;
+        }
+        elems.push_back(elem);
+        PIN_SemaphoreSet(&not_empty);
+        PIN_ReleaseLock(&lock);
+        return true;
+    }
+
+    // Blocks until an element is available. Returns false only after close(), once the
+    // queue has been drained.
+    bool pop(T &elem, THREADID t_id)
+    {
+        while (true)
+        {
+            PIN_GetLock(&lock, t_id + 1);
+            if (!elems.empty())
+            {
+                elem = elems.front();
+                elems.pop_front();
+                PIN_ReleaseLock(&lock);
+                return true;
+            }
+            if (closed)
+            {
+                PIN_ReleaseLock(&lock);
+                return false;
+            }
+            // Cleared under the lock, so that a push() in between cannot be missed.
+            PIN_SemaphoreClear(&not_empty);
+            PIN_ReleaseLock(&lock);
+
+            PIN_SemaphoreWait(&not_empty);
+        }
+    }
+
+    // Non-blocking pop.
+    bool tryPop(T &elem, THREADID t_id)
+    {
+        PIN_GetLock(&lock, t_id + 1);
+        bool found = !elems.empty();
+        if (found)
+        {
+            elem = elems.front();
+            elems.pop_front();
+        }
+        PIN_ReleaseLock(&lock);
+        return found;
+    }
+
+    // Wake up all the consumers; pop() fails once the queue is empty.
+    void close(THREADID t_id)
+    {
+        PIN_GetLock(&lock, t_id + 1);
+        closed = true;
+        PIN_SemaphoreSet(&not_empty);
+        PIN_ReleaseLock(&lock);
+    }
+
+  private:
+    PIN_LOCK lock;
+    PIN_SEMAPHORE not_empty;
+    std::deque<T> elems;
+    bool closed = false;
+};
+
+#endif
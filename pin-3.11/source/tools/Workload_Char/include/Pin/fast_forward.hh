@@ -0,0 +1,130 @@
+#ifndef __FAST_FORWARD_HH__
+#define __FAST_FORWARD_HH__
+
+#include <algorithm>
+
+#include "pin.H"
+
+// Fast-forwarding support shared by the pintools.
+//
+// (1) Instrumentation versions. A tool instruments every trace according to
+//     TRACE_Version(trace), e.g., a count-only version used before the ROI and a full
+//     simulation version. setVersion() selects the version all threads switch to at their
+//     next basic block, so fast-forwarded code never carries the simulation calls.
+//
+// (2) Per-basic-block instruction counting into per-thread counters. The inlined
+//     countBbl() only adds BBL_NumIns and compares against the thread's check point; the
+//     tool's own fold routine runs (as a Then call) when the check point is reached.
+namespace FastForward
+{
+// Every trace starts out in version 0.
+static const ADDRINT DEFAULT_VERSION = 0;
+
+static REG version_reg = REG_INVALID();
+static volatile ADDRINT target_version = DEFAULT_VERSION;
+static ADDRINT num_versions = 1;
+
+inline void init(ADDRINT _num_versions)
+{
+    num_versions = _num_versions;
+
+    // Scratch register used to select instrumentation version.
+    version_reg = PIN_ClaimToolRegister();
+    if (!REG_valid(version_reg))
+    {
+        std::cerr << "[PINTOOL] Cannot allocate a scratch register for versioning."
+                  << std::endl;
+        PIN_ExitProcess(1);
+    }
+}
+
+// Threads pick up the new version at the head of their next basic block.
+inline void setVersion(ADDRINT version)
+{
+    assert(version < num_versions);
+    target_version = version;
+}
+
+inline ADDRINT PIN_FAST_ANALYSIS_CALL targetVersion() { return target_version; }
+
+// Must be called on every basic block of the trace, after all the other instrumentation of
+// the block's first instruction.
+inline void insertVersionSwitch(TRACE trace, BBL bbl)
+{
+    INS head = BBL_InsHead(bbl);
+    INS_InsertCall(head, IPOINT_BEFORE, (AFUNPTR)targetVersion,
+                   IARG_FAST_ANALYSIS_CALL,
+                   IARG_RETURN_REGS, version_reg,
+                   IARG_END);
+
+    ADDRINT version = TRACE_Version(trace);
+    for (ADDRINT v = 0; v < num_versions; v++)
+    {
+        if (v != version)
+        {
+            INS_InsertVersionCase(head, version_reg, INT32(v), v, IARG_END);
+        }
+    }
+}
+
+// Per-thread instruction counters, padded to a cache line so that threads never share one.
+struct Thread_Count
+{
+    UINT64 count = 0; // Instructions counted for this thread.
+    UINT64 check_at = 0; // Value of count at which the fold routine has to run.
+    UINT64 folded = 0; // Part of count already taken by the fold routine.
+    UINT8 pad[40];
+};
+static Thread_Count thread_counts[PIN_MAX_THREADS];
+
+inline ADDRINT PIN_FAST_ANALYSIS_CALL countBbl(THREADID t_id, UINT32 num_ins)
+{
+    Thread_Count &t_count = thread_counts[t_id];
+    t_count.count += num_ins;
+    return t_count.count >= t_count.check_at;
+}
+
+// Count the whole basic block once, at its first instruction. fold(THREADID) is called with
+// IARG_FAST_ANALYSIS_CALL once the thread reaches its check point.
+inline void insertCount(BBL bbl, AFUNPTR fold)
+{
+    INS_InsertIfCall(BBL_InsHead(bbl), IPOINT_BEFORE, (AFUNPTR)countBbl,
+                     IARG_FAST_ANALYSIS_CALL,
+                     IARG_THREAD_ID,
+                     IARG_UINT32, BBL_NumIns(bbl),
+                     IARG_END);
+    INS_InsertThenCall(BBL_InsHead(bbl), IPOINT_BEFORE, fold,
+                       IARG_FAST_ANALYSIS_CALL,
+                       IARG_THREAD_ID,
+                       IARG_END);
+}
+
+// For the fold routine: instructions counted since the last call.
+inline UINT64 takeCount(THREADID t_id)
+{
+    Thread_Count &t_count = thread_counts[t_id];
+    UINT64 delta = t_count.count - t_count.folded;
+    t_count.folded = t_count.count;
+    return delta;
+}
+
+// For the fold routine: run again after another num_ins instructions of this thread.
+inline void checkAgainIn(THREADID t_id, UINT64 num_ins)
+{
+    Thread_Count &t_count = thread_counts[t_id];
+    t_count.check_at = t_count.count + std::max(num_ins, UINT64(1));
+}
+
+// Instructions counted but not yet taken by the fold routine, over all threads.
+inline UINT64 takeAllCounts()
+{
+    UINT64 total = 0;
+    for (THREADID t_id = 0; t_id < PIN_MAX_THREADS; t_id++)
+    {
+        total += takeCount(t_id);
+    }
+    return total;
+}
+}
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef __OUTPUT_STREAM_HH__
+#define __OUTPUT_STREAM_HH__
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "pin.H"
+
+#include "buffer_queue.hh"
+#include "../Trace/lz_codec.hh"
+
+// Trace output stage. write() appends to a chunk of chunk_bytes of the writing thread, without
+// a lock; full chunks are handed to a background (internal) thread, which compresses them into
+// self-delimiting frames (see include/Trace/lz_codec.hh) and writes them out. A thread that
+// hands a chunk off continues in a free one, and only waits when all the others are queued
+// (backpressure). There are num_chunks chunks to start with, and one more for every writing
+// thread that finds none free.
+//
+// A chunk holds whole write()s of one thread, so the output of several threads interleaves at
+// chunk granularity.
+//
+// Life cycle: open() from main(), stop() from a PrepareForFini callback (internal threads are
+// gone by Fini), close() from Fini. Whatever is written after stop() is compressed in the
+// writing thread, under the lock.
+class Output_Stream
+{
+  public:
+    Output_Stream()
+    {
+        PIN_InitLock(&lock);
+    }
+
+    ~Output_Stream()
+    {
+        std::string *chunk;
+        while (free_chunks.tryPop(chunk, 0)) { delete chunk; }
+        for (auto &thread_chunk : thread_chunks) { delete thread_chunk.chunk; }
+    }
+
+    // prefix (e.g., a file header) goes out first, uncompressed.
+    bool open(const std::string &fn, bool _compress, const std::string &prefix = "",
+              UINT32 _chunk_bytes = 1 << 20, UINT32 num_chunks = 8)
+    {
+        compress = _compress;
+        chunk_bytes = _chunk_bytes;
+
+        out.open(fn.c_str(), std::ios::binary);
+        if (!out) { return false; }
+        out.write(prefix.data(), prefix.size());
+
+        for (UINT32 i = 0; i < num_chunks; i++) { free_chunks.push(newChunk(), 0); }
+
+        return PIN_SpawnInternalThread(writerThread, this, 0, &writer_uid) != INVALID_THREADID;
+    }
+
+    void write(const char *data, size_t size, THREADID t_id)
+    {
+        std::string *&chunk = thread_chunks[t_id].chunk;
+        if (chunk == NULL && !free_chunks.tryPop(chunk, t_id)) { chunk = newChunk(); }
+        chunk->append(data, size);
+        if (chunk->size() >= chunk_bytes) { handOff(chunk, t_id); }
+    }
+
+    void write(const std::string &data, THREADID t_id) { write(data.data(), data.size(), t_id); }
+
+    // Drain the queue and stop the background thread.
+    void stop(THREADID t_id)
+    {
+        PIN_GetLock(&lock, t_id + 1);
+        full_chunks.close(t_id);
+        INT32 exit_code;
+        PIN_WaitForThreadTermination(writer_uid, PIN_INFINITE_TIMEOUT, &exit_code);
+        __atomic_store_n(&stopped, true, __ATOMIC_RELEASE);
+        PIN_ReleaseLock(&lock);
+    }
+
+    // Write out the rest and report the counters.
+    void close(THREADID t_id)
+    {
+        PIN_GetLock(&lock, t_id + 1);
+        for (auto &thread_chunk : thread_chunks)
+        {
+            if (thread_chunk.chunk != NULL && !thread_chunk.chunk->empty())
+            {
+                flushChunk(*thread_chunk.chunk);
+                thread_chunk.chunk->clear();
+            }
+        }
+        PIN_ReleaseLock(&lock);
+        out.close();
+
+        std::cerr << "[PINTOOL] Trace output: " << num_chunks_written << " chunks, "
+                  << raw_bytes << " bytes";
+        if (compress)
+        {
+            std::cerr << " (" << stored_bytes << " compressed)";
+        }
+        std::cerr << "; max queue depth " << max_depth
+                  << "; " << num_stalls << " writes waited for a free chunk." << std::endl;
+    }
+
+  private:
+    std::string *newChunk() const
+    {
+        std::string *chunk = new std::string;
+        chunk->reserve(chunk_bytes + (chunk_bytes >> 4));
+        return chunk;
+    }
+
+    // Queue the full chunk of a thread, and continue in a free one. Once the writer thread is
+    // stopped (the queue is closed), the chunk is written out right away instead.
+    void handOff(std::string *&chunk, THREADID t_id)
+    {
+        if (!__atomic_load_n(&stopped, __ATOMIC_ACQUIRE) && full_chunks.push(chunk, t_id))
+        {
+            UINT64 cur_depth = __atomic_add_fetch(&depth, 1, __ATOMIC_RELAXED);
+            UINT64 old_max = __atomic_load_n(&max_depth, __ATOMIC_RELAXED);
+            while (cur_depth > old_max &&
+                   !__atomic_compare_exchange_n(&max_depth, &old_max, cur_depth, true,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+
+            if (!free_chunks.tryPop(chunk, t_id))
+            {
+                __atomic_add_fetch(&num_stalls, 1, __ATOMIC_RELAXED);
+                free_chunks.pop(chunk, t_id);
+            }
+            return;
+        }
+
+        PIN_GetLock(&lock, t_id + 1);
+        flushChunk(*chunk);
+        PIN_ReleaseLock(&lock);
+        chunk->clear();
+    }
+
+    // Compress (if enabled) and write one chunk; called by one thread at a time (the writer
+    // thread, or a thread holding the lock once it is stopped).
+    void flushChunk(const std::string &chunk)
+    {
+        const UINT8 *data = reinterpret_cast<const UINT8*>(chunk.data());
+        if (compress)
+        {
+            frame.clear();
+            compressor.compressFrame(data, chunk.size(), frame);
+            out.write(frame.data(), frame.size());
+            stored_bytes += frame.size();
+        }
+        else
+        {
+            out.write(chunk.data(), chunk.size());
+        }
+        raw_bytes += chunk.size();
+        num_chunks_written++;
+    }
+
+    static VOID writerThread(VOID *arg)
+    {
+        Output_Stream *stream = static_cast<Output_Stream*>(arg);
+        THREADID t_id = PIN_ThreadId();
+
+        std::string *chunk;
+        while (stream->full_chunks.pop(chunk, t_id))
+        {
+            stream->flushChunk(*chunk);
+            chunk->clear();
+            __atomic_sub_fetch(&stream->depth, 1, __ATOMIC_RELAXED);
+            stream->free_chunks.push(chunk, t_id);
+        }
+        PIN_ExitThread(0);
+    }
+
+    std::ofstream out;
+    bool compress = false;
+    UINT32 chunk_bytes = 0;
+
+    PIN_LOCK lock; // Serializes stop(), close() and the writes once stopped.
+
+    // The chunk being filled by each thread, on its own cache line.
+    struct Thread_Chunk
+    {
+        std::string *chunk = NULL;
+        UINT8 pad[64 - sizeof(std::string*)];
+    };
+    Thread_Chunk thread_chunks[PIN_MAX_THREADS];
+
+    Buffer_Queue<std::string*> full_chunks;
+    Buffer_Queue<std::string*> free_chunks;
+    PIN_THREAD_UID writer_uid;
+    bool stopped = false;
+
+    LZ::Compressor compressor;
+    std::string frame;
+
+    UINT64 depth = 0; // These three are atomic.
+    UINT64 max_depth = 0;
+    UINT64 num_stalls = 0;
+    UINT64 num_chunks_written = 0;
+    UINT64 raw_bytes = 0;
+    UINT64 stored_bytes = 0;
+};
+
+#endif
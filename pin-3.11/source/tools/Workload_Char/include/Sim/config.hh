@@ -1,6 +1,8 @@
 #ifndef __SIM_CONFIG_HH__
 #define __SIM_CONFIG_HH__
 
+#include <cassert>
+#include <cstdlib>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -30,7 +32,116 @@ class Config
     };
     std::vector<Cache_Info> caches;
 
-    Config(std::string fname) : caches(int(Cache_Level::MAX)) { parse(fname); }
+    // TLBs (<level>_entries, <level>_assoc), none if the file has no TLB section.
+    enum TLB_Level : int
+    {
+        ITLB, DTLB, STLB, MAX_TLB
+    };
+
+    struct TLB_Info
+    {
+        bool valid = false;
+
+        unsigned entries;
+        unsigned assoc;
+    };
+    std::vector<TLB_Info> tlbs;
+
+    // Page-walk cache, entries for each of the upper levels of the page table (PWC_<level>_entries,
+    // 0 caches nothing).
+    enum PWC_Level : int
+    {
+        PML4, PDPT, PD, MAX_PWC
+    };
+    std::vector<unsigned> pwc_entries;
+
+    // Estimated cycles of an STLB hit and of each memory reference of a page walk.
+    unsigned stlb_latency = 9;
+    unsigned walk_ref_latency = 20;
+
+    // Whether page walks also send their references to the L1-D of their core.
+    bool walk_refs_to_caches = false;
+
+    // Page sizes (page_policy): 4kB pages only (4KB), 4kB pages promoted to a 2MB page once
+    // thp_threshold of the 4kB pages of their 2MB region are touched (THP), or 2MB (2MB) or
+    // 1GB (1GB) pages for everything.
+    enum Page_Policy : int
+    {
+        PAGES_4KB, THP, PAGES_2MB, PAGES_1GB
+    };
+    Page_Policy page_policy = Page_Policy::PAGES_4KB;
+    unsigned thp_threshold = 256;
+
+    // NUMA memory, numa_nodes > 0 for a MultiNode MMU (see System/numa.hh). Per node, its size
+    // (numa_size_gb) and the cycles of a local and of a remote access (numa_local_latency,
+    // numa_remote_latency): comma-separated, or one value for all the nodes. New pages go to the
+    // node of their core (first_touch), round-robin by page (interleave), or to
+    // numa_preferred_node (preferred), to another node if that one is full. A 4kB page moves to
+    // the node of its core after numa_migration_threshold remote accesses (0 never).
+    enum NUMA_Placement : int
+    {
+        FIRST_TOUCH, INTERLEAVE, PREFERRED
+    };
+    unsigned numa_nodes = 0;
+    std::vector<unsigned> numa_size_gb;
+    std::vector<unsigned> numa_local_latency;
+    std::vector<unsigned> numa_remote_latency;
+    NUMA_Placement numa_placement = NUMA_Placement::FIRST_TOUCH;
+    unsigned numa_preferred_node = 0;
+    unsigned numa_migration_threshold = 0;
+
+    // NVM main memory, for the analysis of the write-backs of the LLC (see Sim/nvm_writes.hh):
+    // energy (pJ) to SET and to RESET a bit of single-level cells, to write a 2-bit cell of
+    // multi-level cells to a full state (00, 11) and to an intermediate one (01, 10, which
+    // takes more program-and-verify steps), the bits per word of Flip-N-Write (8, 16, 32 or
+    // 64, plus a flag bit), and write-backs per interval of the histograms.
+    double nvm_set_energy = 13.5;
+    double nvm_reset_energy = 19.2;
+    double nvm_mlc_full_energy = 19.2;
+    double nvm_mlc_mid_energy = 46.2;
+    unsigned nvm_fnw_word_bits = 32;
+    unsigned nvm_interval = 100000;
+
+    Config(std::string fname)
+        : caches(int(Cache_Level::MAX)),
+          tlbs(int(TLB_Level::MAX_TLB)),
+          pwc_entries(int(PWC_Level::MAX_PWC), 0)
+    {
+        parse(fname);
+    }
+
+    bool hasTLBs() const { return tlbs[int(TLB_Level::DTLB)].valid; }
+
+    // The value of a node in one of the numa_ lists.
+    static unsigned numaValue(const std::vector<unsigned> &list, unsigned node,
+                              unsigned default_value)
+    {
+        if (list.empty()) { return default_value; }
+        return list.size() == 1 ? list[0] : list[node];
+    }
+    unsigned numaSizeGB(unsigned node) const { return numaValue(numa_size_gb, node, 64); }
+    unsigned numaLocalLatency(unsigned node) const
+    {
+        return numaValue(numa_local_latency, node, 100);
+    }
+    unsigned numaRemoteLatency(unsigned node) const
+    {
+        return numaValue(numa_remote_latency, node, 160);
+    }
+
+    // Whether two configurations give the same mapping of addresses (see System::Platforms).
+    bool sameMMU(const Config &other) const
+    {
+        return num_cores == other.num_cores &&
+               page_policy == other.page_policy &&
+               (page_policy != Page_Policy::THP || thp_threshold == other.thp_threshold) &&
+               numa_nodes == other.numa_nodes &&
+               (numa_nodes == 0 ||
+                (numa_size_gb == other.numa_size_gb &&
+                 numa_placement == other.numa_placement &&
+                 numa_preferred_node == other.numa_preferred_node &&
+                 numa_migration_threshold == other.numa_migration_threshold));
+    }
 
     void parse(std::string &fname)
     {
@@ -86,6 +197,122 @@ class Config
             {
                 block_size = atoi(tokens[1].c_str());
             }
+            // Pages
+            else if(tokens[0] == "page_policy")
+            {
+                if (tokens[1] == "4KB") { page_policy = Page_Policy::PAGES_4KB; }
+                else if (tokens[1] == "THP") { page_policy = Page_Policy::THP; }
+                else if (tokens[1] == "2MB") { page_policy = Page_Policy::PAGES_2MB; }
+                else if (tokens[1] == "1GB") { page_policy = Page_Policy::PAGES_1GB; }
+                else { assert(false && "page_policy is one of 4KB, THP, 2MB and 1GB"); }
+            }
+            else if(tokens[0] == "thp_threshold")
+            {
+                thp_threshold = atoi(tokens[1].c_str());
+            }
+            // NUMA
+            else if(tokens[0] == "numa_nodes")
+            {
+                numa_nodes = atoi(tokens[1].c_str());
+            }
+            else if(tokens[0] == "numa_size_gb")
+            {
+                extractList(tokens[1], numa_size_gb);
+            }
+            else if(tokens[0] == "numa_local_latency")
+            {
+                extractList(tokens[1], numa_local_latency);
+            }
+            else if(tokens[0] == "numa_remote_latency")
+            {
+                extractList(tokens[1], numa_remote_latency);
+            }
+            else if(tokens[0] == "numa_placement")
+            {
+                if (tokens[1] == "first_touch")
+                {
+                    numa_placement = NUMA_Placement::FIRST_TOUCH;
+                }
+                else if (tokens[1] == "interleave")
+                {
+                    numa_placement = NUMA_Placement::INTERLEAVE;
+                }
+                else if (tokens[1] == "preferred")
+                {
+                    numa_placement = NUMA_Placement::PREFERRED;
+                }
+                else { assert(false && "numa_placement is first_touch, interleave or preferred"); }
+            }
+            else if(tokens[0] == "numa_preferred_node")
+            {
+                numa_preferred_node = atoi(tokens[1].c_str());
+            }
+            else if(tokens[0] == "numa_migration_threshold")
+            {
+                numa_migration_threshold = atoi(tokens[1].c_str());
+            }
+            // NVM write-backs
+            else if(tokens[0] == "nvm_set_energy")
+            {
+                nvm_set_energy = atof(tokens[1].c_str());
+            }
+            else if(tokens[0] == "nvm_reset_energy")
+            {
+                nvm_reset_energy = atof(tokens[1].c_str());
+            }
+            else if(tokens[0] == "nvm_mlc_full_energy")
+            {
+                nvm_mlc_full_energy = atof(tokens[1].c_str());
+            }
+            else if(tokens[0] == "nvm_mlc_mid_energy")
+            {
+                nvm_mlc_mid_energy = atof(tokens[1].c_str());
+            }
+            else if(tokens[0] == "nvm_fnw_word_bits")
+            {
+                nvm_fnw_word_bits = atoi(tokens[1].c_str());
+            }
+            else if(tokens[0] == "nvm_interval")
+            {
+                nvm_interval = atoi(tokens[1].c_str());
+            }
+            // TLBs and page walks
+            else if(tokens[0].find("ITLB") == 0)
+            {
+                extractTLBInfo(TLB_Level::ITLB, tokens);
+            }
+            else if(tokens[0].find("DTLB") == 0)
+            {
+                extractTLBInfo(TLB_Level::DTLB, tokens);
+            }
+            else if(tokens[0] == "STLB_latency")
+            {
+                stlb_latency = atoi(tokens[1].c_str());
+            }
+            else if(tokens[0].find("STLB") == 0)
+            {
+                extractTLBInfo(TLB_Level::STLB, tokens);
+            }
+            else if(tokens[0] == "PWC_PML4_entries")
+            {
+                pwc_entries[int(PWC_Level::PML4)] = atoi(tokens[1].c_str());
+            }
+            else if(tokens[0] == "PWC_PDPT_entries")
+            {
+                pwc_entries[int(PWC_Level::PDPT)] = atoi(tokens[1].c_str());
+            }
+            else if(tokens[0] == "PWC_PD_entries")
+            {
+                pwc_entries[int(PWC_Level::PD)] = atoi(tokens[1].c_str());
+            }
+            else if(tokens[0] == "walk_ref_latency")
+            {
+                walk_ref_latency = atoi(tokens[1].c_str());
+            }
+            else if(tokens[0] == "walk_refs_to_caches")
+            {
+                walk_refs_to_caches = tokens[1] == "false" ? 0 : 1;
+            }
             else if(tokens[0].find("L1I") != std::string::npos)
             {
                 extractCacheInfo(Cache_Level::L1I, tokens);
@@ -108,8 +335,46 @@ class Config
             }
         }
         file.close();
+
+        std::vector<unsigned> *lists[] = {&numa_size_gb, &numa_local_latency,
+                                          &numa_remote_latency};
+        for (auto list : lists)
+        {
+            assert((list->size() <= 1 || list->size() == numa_nodes) &&
+                   "One numa_ value per node, or one for all");
+        }
+        assert((numa_nodes == 0 || numa_preferred_node < numa_nodes) &&
+               "numa_preferred_node is not a node");
+    }
+
+    // "64,64" -> {64, 64}
+    static void extractList(const std::string &token, std::vector<unsigned> &list)
+    {
+        list.clear();
+        size_t start = 0;
+        while (start <= token.size())
+        {
+            size_t end = token.find(',', start);
+            if (end == std::string::npos) { end = token.size(); }
+            list.push_back(atoi(token.substr(start, end - start).c_str()));
+            start = end + 1;
+        }
     }
     
+    void extractTLBInfo(TLB_Level level, std::vector<std::string> &tokens)
+    {
+        tlbs[int(level)].valid = true;
+
+        if(tokens[0].find("entries") != std::string::npos)
+        {
+            tlbs[int(level)].entries = atoi(tokens[1].c_str());
+        }
+        else if(tokens[0].find("assoc") != std::string::npos)
+        {
+            tlbs[int(level)].assoc = atoi(tokens[1].c_str());
+        }
+    }
+
     void extractCacheInfo(Cache_Level level, std::vector<std::string> &tokens)
     {
         caches[int(level)].valid = true;
@@ -1,96 +1,214 @@
 #ifndef __DATA_HH__
 #define __DATA_HH__
 
-#include <unordered_map>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 
+// The contents of the cache lines the LLC holds, by block-aligned (physical) address: as they
+// were loaded from memory (ori_data) and as the stores since left them (new_data).
+//
+// Both copies of a line sit next to each other in a slot of a slab, a chunk of slots that never
+// moves (freed slots are reused), and an open-addressing table (linear probing, at most half
+// full, backward-shift deletion) maps the addresses to the slots. Loading and modifying a line
+// are a memcpy(), and getData() returns pointers into the slab, valid until the line is deleted.
 class Data
 {
   public:
-    Data(unsigned _block_size) : block_size(_block_size) {}
+    // A line, as getData() returns it (block_size bytes each).
+    struct Line_View
+    {
+        const uint8_t *ori_data;
+        const uint8_t *new_data;
+    };
+
+    Data(unsigned _block_size)
+        : block_size(_block_size),
+          table(min_capacity, Entry{EMPTY, 0})
+    {
+        // Block (cache-line) size must be a power of two.
+        assert(block_size > 0 && (block_size & (block_size - 1)) == 0);
+        while ((1u << block_shift) < block_size) { block_shift++; }
+        while ((uint64_t(1) << table_bits) < min_capacity) { table_bits++; }
+    }
+
+    unsigned blockSize() const { return block_size; }
+    uint64_t numLines() const { return num_lines; }
+
+    bool contains(uint64_t aligned_addr) const { return find(aligned_addr) != NONE; }
 
-    void loadData(uint64_t aligned_addr, uint8_t *data, unsigned size)
+    void loadData(uint64_t aligned_addr, const uint8_t *data, unsigned size)
     {
         // The address must be block(cache-line) aligned.
         assert(aligned_addr == (aligned_addr & ~((uint64_t)block_size - (uint64_t)1)));
         // Loading must be the block(cache-line) size.
         assert(size == block_size);
-
-        auto d_iter = data_storage.find(aligned_addr);
         // We only load data if there is miss from all the caches.
-        assert(d_iter == data_storage.end());
+        assert(find(aligned_addr) == NONE);
 
-        DUnit storage;
-        for (unsigned i = 0; i < size; i++)
-        {
-            storage.ori_data.push_back(data[i]);
-            storage.new_data.push_back(data[i]);
-        }
+        uint32_t slot = newSlot();
+        uint8_t *line = slotData(slot);
+        memcpy(line, data, size);
+        memcpy(line + block_size, data, size);
 
         // Insert the data.
-        data_storage.insert({aligned_addr, storage});
+        if ((num_lines + 1) * 2 > table.size()) { grow(); }
+        insert(aligned_addr, slot);
+        num_lines++;
     }
 
-    void getData(uint64_t aligned_addr,
-                 std::vector<uint8_t> &ori_data,
-                 std::vector<uint8_t> &new_data)
+    // The line at aligned_addr, false if it is not there.
+    bool getData(uint64_t aligned_addr, Line_View &view) const
     {
         // The loading address must be block(cache-line) aligned.
         assert(aligned_addr == (aligned_addr & ~((uint64_t)block_size - (uint64_t)1)));
-        
-	auto d_iter = data_storage.find(aligned_addr);
-        // The data has to be there.
-        assert(d_iter != data_storage.end());
 
-        for (unsigned i = 0; i < block_size; i++)
-        {
-            ori_data.push_back((d_iter->second).ori_data[i]);
-            new_data.push_back((d_iter->second).new_data[i]);
-        }
+        uint64_t index = find(aligned_addr);
+        if (index == NONE) { return false; }
+
+        const uint8_t *line = slotData(table[index].slot);
+        view.ori_data = line;
+        view.new_data = line + block_size;
+        return true;
     }
 
-    void deleteData(uint64_t aligned_addr)
+    // False if the line is not there (e.g., a line of instructions, which is never loaded).
+    bool deleteData(uint64_t aligned_addr)
     {
         // The address must be block(cache-line) aligned.
         assert(aligned_addr == (aligned_addr & ~((uint64_t)block_size - (uint64_t)1)));
 
-        auto d_iter = data_storage.find(aligned_addr);
-        // The data has to be there.
-        assert(d_iter != data_storage.end());
+        uint64_t index = find(aligned_addr);
+        if (index == NONE) { return false; }
 
         // Erase.
-        data_storage.erase(aligned_addr);
-        d_iter = data_storage.find(aligned_addr);
-        assert(d_iter == data_storage.end());
+        free_slots.push_back(table[index].slot);
+        erase(index);
+        num_lines--;
+        assert(find(aligned_addr) == NONE);
+        return true;
     }
 
-    void modifyData(uint64_t addr, uint8_t *data, unsigned size)
+    // False if the line is not there anymore (evicted since the store).
+    bool modifyData(uint64_t addr, const uint8_t *data, unsigned size)
     {
         unsigned offset = (addr & ((uint64_t)block_size - (uint64_t)1));
         uint64_t aligned_addr = (addr & ~((uint64_t)block_size - (uint64_t)1));
+        assert(offset + size <= block_size);
 
-        auto d_iter = data_storage.find(aligned_addr);
-        // Still, the data has to be there.
-        assert(d_iter != data_storage.end());
+        uint64_t index = find(aligned_addr);
+        if (index == NONE) { return false; }
 
-        for (unsigned i = 0; i < size; i++)
-        {
-            assert(i + offset < block_size);
-            (d_iter->second).new_data[i + offset] = data[i];
-        }
+        memcpy(slotData(table[index].slot) + block_size + offset, data, size);
+        return true;
     }
 
   protected:
-    unsigned block_size;
+    static const uint64_t EMPTY = ~uint64_t(0); // Never a block-aligned address.
+    static const uint64_t NONE = ~uint64_t(0);
+    static const uint64_t min_capacity = 1024;
+    static const unsigned slots_per_slab = 1024;
+
+    const unsigned block_size;
+    unsigned block_shift = 0;
 
-    struct DUnit
+    // The slots, 2 * block_size bytes each (original data, then new data).
+    std::vector<std::vector<uint8_t>> slabs;
+    uint32_t num_slots = 0;
+    std::vector<uint32_t> free_slots;
+
+    struct Entry
     {
-        std::vector<uint8_t> ori_data;
-        std::vector<uint8_t> new_data;
+        uint64_t addr;
+        uint32_t slot;
     };
+    std::vector<Entry> table;
+    unsigned table_bits = 0;
+    uint64_t num_lines = 0;
+
+    uint8_t *slotData(uint32_t slot)
+    {
+        return &slabs[slot / slots_per_slab][uint64_t(slot % slots_per_slab) * 2 * block_size];
+    }
+
+    const uint8_t *slotData(uint32_t slot) const
+    {
+        return &slabs[slot / slots_per_slab][uint64_t(slot % slots_per_slab) * 2 * block_size];
+    }
+
+    uint32_t newSlot()
+    {
+        if (!free_slots.empty())
+        {
+            uint32_t slot = free_slots.back();
+            free_slots.pop_back();
+            return slot;
+        }
 
-    std::unordered_map<uint64_t, DUnit> data_storage;
- 
+        if (num_slots % slots_per_slab == 0)
+        {
+            slabs.push_back(std::vector<uint8_t>(uint64_t(slots_per_slab) * 2 * block_size));
+        }
+        return num_slots++;
+    }
+
+    // Fibonacci hashing of the line number.
+    uint64_t home(uint64_t aligned_addr) const
+    {
+        return ((aligned_addr >> block_shift) * 0x9e3779b97f4a7c15ULL) >> (64 - table_bits);
+    }
+
+    uint64_t find(uint64_t aligned_addr) const
+    {
+        uint64_t mask = table.size() - 1;
+        for (uint64_t index = home(aligned_addr); ; index = (index + 1) & mask)
+        {
+            if (table[index].addr == aligned_addr) { return index; }
+            if (table[index].addr == EMPTY) { return NONE; }
+        }
+    }
+
+    void insert(uint64_t aligned_addr, uint32_t slot)
+    {
+        uint64_t mask = table.size() - 1;
+        uint64_t index = home(aligned_addr);
+        while (table[index].addr != EMPTY) { index = (index + 1) & mask; }
+        table[index] = Entry{aligned_addr, slot};
+    }
+
+    // Moves back the entries after index that would not be found anymore.
+    void erase(uint64_t index)
+    {
+        uint64_t mask = table.size() - 1;
+        uint64_t next = index;
+        while (true)
+        {
+            next = (next + 1) & mask;
+            if (table[next].addr == EMPTY) { break; }
+
+            // The entry stays if its home is cyclically in (index, next].
+            uint64_t h = home(table[next].addr);
+            bool stays = index <= next ? (index < h && h <= next) : (index < h || h <= next);
+            if (stays) { continue; }
+
+            table[index] = table[next];
+            index = next;
+        }
+        table[index].addr = EMPTY;
+    }
+
+    void grow()
+    {
+        std::vector<Entry> old;
+        old.swap(table);
+        table.assign(old.size() * 2, Entry{EMPTY, 0});
+        table_bits++;
+        for (auto &entry : old)
+        {
+            if (entry.addr != EMPTY) { insert(entry.addr, entry.slot); }
+        }
+    }
 };
-  
+
 #endif
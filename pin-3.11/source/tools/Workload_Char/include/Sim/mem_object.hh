@@ -7,6 +7,7 @@
 #include "stats.hh"
 
 #include "../Sim/data.hh"
+#include "../Sim/nvm_writes.hh"
 
 using std::ofstream;
 
@@ -33,6 +34,8 @@ class MemObject
 
     virtual void traceOutput(ofstream *_out) { trace_out = _out; }
 
+    virtual void analyzeWrites(NVMWrites *_nvm_writes) { nvm_writes = _nvm_writes; }
+
     virtual void registerStats(Stats &stats) {}
 
     virtual void reInitialize() {}
@@ -45,7 +48,9 @@ class MemObject
 
     int id = -1;
 
-    ofstream *trace_out;    
+    ofstream *trace_out = nullptr;
+
+    NVMWrites *nvm_writes = nullptr;
 };
 
 #endif
@@ -0,0 +1,276 @@
+#ifndef __NVM_WRITES_HH__
+#define __NVM_WRITES_HH__
+
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <emmintrin.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "config.hh"
+#include "stats.hh"
+#include "util.hh"
+
+using std::ofstream;
+
+// The cost of the write-backs of the LLC to an NVM (PCM) main memory, from the original and new
+// contents of their lines (see Data): the bits that flip, and the bits (or cells) and energy of
+//     1) a full write of the line (every bit is SET or RESET);
+//     2) Data-Comparison-Write (DCW): only the bits that flip;
+//     3) Flip-N-Write (FNW): per word, the flipped bits or, if more than half of them flip, the
+//        other ones and the flag bit of the word (the line is taken as stored uninverted; the
+//        energy is an average of SET and RESET);
+//     4) DCW on 2-bit multi-level cells (MLC): the cells whose value changes, an intermediate
+//        state costing more than a full one.
+// The parameters are those of the configuration (nvm_ parameters). A line is processed 16 bytes
+// at a time: XOR, then a per-byte popcount (SWAR, or a table lookup with SSSE3) summed by
+// _mm_sad_epu8(), and the Flip-N-Write words are folded from the byte counts.
+//
+// Every nvm_interval write-backs, a line goes to the output: the counts and energies of the
+// interval, then a histogram of the bit flips per write-back (the first bucket for the silent
+// write-backs, with no flip, then num_buckets buckets of equal width). The totals go to the
+// stats.
+class NVMWrites
+{
+  public:
+    static const unsigned num_buckets = 16;
+
+    NVMWrites(const Config &cfg, ofstream *_out)
+        : block_size(cfg.block_size),
+          fnw_word_bits(cfg.nvm_fnw_word_bits),
+          interval(cfg.nvm_interval),
+          set_energy(cfg.nvm_set_energy),
+          reset_energy(cfg.nvm_reset_energy),
+          mlc_full_energy(cfg.nvm_mlc_full_energy),
+          mlc_mid_energy(cfg.nvm_mlc_mid_energy),
+          out(_out)
+    {
+        assert(block_size % 16 == 0);
+        assert(fnw_word_bits == 8 || fnw_word_bits == 16 || fnw_word_bits == 32 ||
+               fnw_word_bits == 64);
+        assert(interval > 0);
+
+        *out << "# interval write-backs flips full_bits dcw_bits fnw_bits mlc_cells "
+             << "full_pJ dcw_pJ fnw_pJ mlc_pJ | flip histogram (0, then " << num_buckets
+             << " buckets of " << block_size * 8 / num_buckets << " bits)\n";
+    }
+
+    // A write-back of a line, block_size bytes each.
+    void writeBack(const uint8_t *ori_data, const uint8_t *new_data)
+    {
+        Counts line;
+        countLine(ori_data, new_data, line);
+
+        current.add(line);
+        unsigned bits = block_size * 8;
+        unsigned bucket = line.flips == 0 ? 0 : (line.flips - 1) * num_buckets / bits + 1;
+        histogram[bucket]++;
+
+        if (current.write_backs == interval) { endInterval(); }
+    }
+
+    // Outputs the last (partial) interval, and the totals to the stats.
+    void registerStats(Stats &stats)
+    {
+        if (current.write_backs > 0) { endInterval(); }
+
+        stats.registerStats("NVM: Number of write-backs = " + to_string(total.write_backs));
+        stats.registerStats("NVM: Number of silent write-backs = " +
+                            to_string(total.silent_write_backs));
+        stats.registerStats("NVM: Number of bit flips = " + to_string(total.flips));
+        stats.registerStats("NVM: Number of bits written (full) = " +
+                            to_string(total.write_backs * block_size * 8));
+        stats.registerStats("NVM: Number of bits written (DCW) = " + to_string(total.flips));
+        stats.registerStats("NVM: Number of bits written (FNW) = " + to_string(total.fnw_bits));
+        stats.registerStats("NVM: Number of MLC cells written = " +
+                            to_string(total.mlc_cells));
+        stats.registerStats("NVM: Write energy (full, pJ) = " + to_string(fullEnergy(total)));
+        stats.registerStats("NVM: Write energy (DCW, pJ) = " + to_string(dcwEnergy(total)));
+        stats.registerStats("NVM: Write energy (FNW, pJ) = " + to_string(fnwEnergy(total)));
+        stats.registerStats("NVM: Write energy (MLC, pJ) = " + to_string(mlcEnergy(total)) +
+                            "\n");
+    }
+
+  protected:
+    const unsigned block_size;
+    const unsigned fnw_word_bits;
+    const unsigned interval;
+    const double set_energy;
+    const double reset_energy;
+    const double mlc_full_energy;
+    const double mlc_mid_energy;
+
+    ofstream *out;
+
+    struct Counts
+    {
+        uint64_t write_backs = 0;
+        uint64_t silent_write_backs = 0;
+        uint64_t flips = 0;
+        uint64_t sets = 0; // Flips from 0 to 1.
+        uint64_t ones = 0; // Bits at 1 in the new data.
+        uint64_t fnw_bits = 0;
+        uint64_t mlc_cells = 0;
+        uint64_t mlc_mid_cells = 0; // Of those, written to an intermediate state.
+
+        void add(const Counts &other)
+        {
+            write_backs += other.write_backs;
+            silent_write_backs += other.silent_write_backs;
+            flips += other.flips;
+            sets += other.sets;
+            ones += other.ones;
+            fnw_bits += other.fnw_bits;
+            mlc_cells += other.mlc_cells;
+            mlc_mid_cells += other.mlc_mid_cells;
+        }
+    };
+    Counts current;
+    Counts total;
+    uint64_t histogram[num_buckets + 1] = {};
+    uint64_t num_intervals = 0;
+
+    void endInterval()
+    {
+        *out << num_intervals << " " << current.write_backs << " " << current.flips << " "
+             << current.write_backs * block_size * 8 << " " << current.flips << " "
+             << current.fnw_bits << " " << current.mlc_cells << " " << fullEnergy(current)
+             << " " << dcwEnergy(current) << " " << fnwEnergy(current) << " "
+             << mlcEnergy(current) << " |";
+        for (auto &count : histogram)
+        {
+            *out << " " << count;
+            count = 0;
+        }
+        *out << "\n";
+
+        total.add(current);
+        current = Counts();
+        num_intervals++;
+    }
+
+    double fullEnergy(const Counts &counts) const
+    {
+        uint64_t bits = counts.write_backs * block_size * 8;
+        return counts.ones * set_energy + (bits - counts.ones) * reset_energy;
+    }
+
+    double dcwEnergy(const Counts &counts) const
+    {
+        return counts.sets * set_energy + (counts.flips - counts.sets) * reset_energy;
+    }
+
+    double fnwEnergy(const Counts &counts) const
+    {
+        return counts.fnw_bits * (set_energy + reset_energy) / 2;
+    }
+
+    double mlcEnergy(const Counts &counts) const
+    {
+        return (counts.mlc_cells - counts.mlc_mid_cells) * mlc_full_energy +
+               counts.mlc_mid_cells * mlc_mid_energy;
+    }
+
+    // The number of bits set in each byte.
+    static __m128i popcount8(__m128i x)
+    {
+#ifdef __SSSE3__
+        const __m128i table = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m128i low_nibble = _mm_set1_epi8(0x0f);
+        return _mm_add_epi8(
+            _mm_shuffle_epi8(table, _mm_and_si128(x, low_nibble)),
+            _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(x, 4), low_nibble)));
+#else
+        const __m128i m1 = _mm_set1_epi8(0x55);
+        const __m128i m2 = _mm_set1_epi8(0x33);
+        const __m128i m4 = _mm_set1_epi8(0x0f);
+        x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), m1));
+        x = _mm_add_epi8(_mm_and_si128(x, m2), _mm_and_si128(_mm_srli_epi16(x, 2), m2));
+        return _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), m4);
+#endif
+    }
+
+    // The sum of the bytes of x into the two 64-bit halves of sum.
+    static void sumBytes(__m128i &sum, __m128i x)
+    {
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(x, _mm_setzero_si128()));
+    }
+
+    // The bits written by Flip-N-Write, per word, from the flips of each byte.
+    __m128i fnwBits(__m128i flips8) const
+    {
+        if (fnw_word_bits == 8)
+        {
+            return _mm_min_epu8(flips8, _mm_sub_epi8(_mm_set1_epi8(9), flips8));
+        }
+
+        // Every count stays in the low byte of its word, min_epi16 works for any word size.
+        const __m128i low_byte = _mm_set1_epi16(0x00ff);
+        __m128i flips = _mm_add_epi16(_mm_and_si128(flips8, low_byte), _mm_srli_epi16(flips8, 8));
+        __m128i flag_plus_word;
+        if (fnw_word_bits == 16) { flag_plus_word = _mm_set1_epi16(17); }
+        else if (fnw_word_bits == 32)
+        {
+            flips = _mm_add_epi32(_mm_and_si128(flips, _mm_set1_epi32(0xffff)),
+                                  _mm_srli_epi32(flips, 16));
+            flag_plus_word = _mm_set1_epi32(33);
+        }
+        else
+        {
+            flips = _mm_sad_epu8(flips8, _mm_setzero_si128());
+            flag_plus_word = _mm_set1_epi64x(65);
+        }
+        return _mm_min_epi16(flips, _mm_sub_epi16(flag_plus_word, flips));
+    }
+
+    void countLine(const uint8_t *ori_data, const uint8_t *new_data, Counts &line) const
+    {
+        const __m128i cell_low = _mm_set1_epi8(0x55); // Low bit of each 2-bit cell.
+        __m128i flips = _mm_setzero_si128(), sets = _mm_setzero_si128();
+        __m128i ones = _mm_setzero_si128(), fnw_bits = _mm_setzero_si128();
+        __m128i mlc_cells = _mm_setzero_si128(), mlc_mid_cells = _mm_setzero_si128();
+
+        for (unsigned i = 0; i < block_size; i += 16)
+        {
+            __m128i ori = _mm_loadu_si128((const __m128i *)(ori_data + i));
+            __m128i cur = _mm_loadu_si128((const __m128i *)(new_data + i));
+            __m128i diff = _mm_xor_si128(ori, cur);
+
+            __m128i flips8 = popcount8(diff);
+            sumBytes(flips, flips8);
+            sumBytes(sets, popcount8(_mm_and_si128(diff, cur)));
+            sumBytes(ones, popcount8(cur));
+            sumBytes(fnw_bits, fnwBits(flips8));
+
+            // A cell changes if either of its bits flips; its new state is intermediate if its
+            // two bits differ.
+            __m128i changed = _mm_and_si128(_mm_or_si128(diff, _mm_srli_epi16(diff, 1)), cell_low);
+            __m128i mid = _mm_and_si128(_mm_xor_si128(cur, _mm_srli_epi16(cur, 1)), changed);
+            sumBytes(mlc_cells, popcount8(changed));
+            sumBytes(mlc_mid_cells, popcount8(mid));
+        }
+
+        line.write_backs = 1;
+        line.flips = horizontalSum(flips);
+        line.silent_write_backs = line.flips == 0 ? 1 : 0;
+        line.sets = horizontalSum(sets);
+        line.ones = horizontalSum(ones);
+        line.fnw_bits = horizontalSum(fnw_bits);
+        line.mlc_cells = horizontalSum(mlc_cells);
+        line.mlc_mid_cells = horizontalSum(mlc_mid_cells);
+    }
+
+    static uint64_t horizontalSum(__m128i sum)
+    {
+        return uint64_t(_mm_cvtsi128_si64(sum)) +
+               uint64_t(_mm_cvtsi128_si64(_mm_unpackhi_epi64(sum, sum)));
+    }
+};
+
+#endif
@@ -2,12 +2,20 @@
 #define __MMU_HH__
 
 #include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "page_table.hh"
 #include "random.hh"
+#include "../Sim/config.hh"
 #include "../Sim/request.hh"
+#include "../Sim/stats.hh"
+#include "../Sim/util.hh"
 
 namespace System
 {
@@ -23,7 +31,8 @@ class Mapper
     static const uint64_t pa_core_size = 16;
     static const uint64_t pa_va_mask = ~(((uint64_t(1) << pa_core_size) - 1) << pa_core_shift);
 
-    static const unsigned page_size = 4096; // 4kB    
+    // Base pages, huge pages are multiples of them (see PageTable and SingleNode).
+    static const unsigned page_size = 4096; // 4kB
     static const uint64_t va_page_shift = 12;
     static const uint64_t va_page_mask = (uint64_t(1) << va_page_shift) - 1;
 
@@ -84,32 +93,235 @@ class MMU
     }
 };
 
+// A pseudo-random permutation of [0, size): a balanced Feistel network over the smallest even
+// number of bits that covers size, with cycle walking (permuted values outside [0, size) are
+// permuted again, at most a few times on average). O(1) memory, and at(i) is O(1), so the i-th
+// frame to hand out is computed when needed instead of shuffling all the frames up front.
+class FramePermutation
+{
+  public:
+    static const unsigned num_rounds = 4;
+
+    FramePermutation(uint64_t _size, uint64_t seed) : size(_size)
+    {
+        assert(size > 0);
+        unsigned bits = 2;
+        while (bits < 64 && (uint64_t(1) << bits) < size) { bits += 2; }
+        half_bits = bits / 2;
+        half_mask = (uint64_t(1) << half_bits) - 1;
+
+        uint64_t state = rng_seed(seed);
+        for (auto &key : keys)
+        {
+            uint64_t high = rng_next(state);
+            key = (high << 32) | rng_next(state);
+        }
+    }
+
+    uint64_t at(uint64_t i) const
+    {
+        assert(i < size);
+        do { i = permute(i); } while (i >= size);
+        return i;
+    }
+
+  protected:
+    const uint64_t size;
+    unsigned half_bits;
+    uint64_t half_mask;
+    uint64_t keys[num_rounds];
+
+    uint64_t permute(uint64_t x) const
+    {
+        uint64_t left = x >> half_bits;
+        uint64_t right = x & half_mask;
+        for (unsigned r = 0; r < num_rounds; r++)
+        {
+            uint64_t next = left ^ (round(right, keys[r]) & half_mask);
+            left = right;
+            right = next;
+        }
+        return (left << half_bits) | right;
+    }
+
+    // splitmix64 finalizer of the half and the round key.
+    static uint64_t round(uint64_t half, uint64_t key)
+    {
+        uint64_t x = half ^ key;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+};
+
+// The physical pages of [first_frame, first_frame + num_frames), handed out in a fixed random
+// order (FramePermutation, the same for the same seed), the next-th of the permutation next.
+// 2MB and 1GB pages take aligned frames of their size in orders of their own, skipping those
+// with a used 4kB frame, and 4kB pages skip the frames of huge pages. The used frames are
+// marked in a bitmap the caller owns, shared by all its pools. Frames are never handed out
+// twice, not even those released since (e.g., by a THP promotion).
+class FramePool
+{
+  public:
+    FramePool(Addr _first_frame, uint64_t _num_frames, uint64_t seed)
+        : first_frame(_first_frame),
+          num_frames(_num_frames)
+    {
+        for (unsigned lev = PageTable::leaf_1GB; lev < PageTable::num_levels; lev++)
+        {
+            uint64_t size = num_frames >> PageTable::pageShift(lev);
+            uint64_t order_seed = seed + (PageTable::leaf_4kB - lev); // 4kB pages: seed.
+            orders.push_back(FramePermutation(size > 0 ? size : 1, order_seed));
+            sizes.push_back(size);
+            nexts.push_back(0);
+        }
+    }
+
+    // The first frame of a free page of the size of a level (see PageTable), false if there is
+    // none left.
+    bool allocate(unsigned leaf_level, std::vector<uint64_t> &used_frame_pool, Addr &frame)
+    {
+        assert(leaf_level >= PageTable::leaf_1GB && leaf_level <= PageTable::leaf_4kB);
+        unsigned order = leaf_level - PageTable::leaf_1GB;
+        unsigned shift = PageTable::pageShift(leaf_level);
+        uint64_t &next = nexts[order];
+
+        if (leaf_level == PageTable::leaf_4kB)
+        {
+            while (next < sizes[order])
+            {
+                frame = first_frame + orders[order].at(next++);
+                uint64_t bit = uint64_t(1) << (frame % 64);
+                if ((used_frame_pool[frame / 64] & bit) != 0) { continue; }
+
+                used_frame_pool[frame / 64] |= bit;
+                return true;
+            }
+            return false;
+        }
+
+        // Whole words of the pool, a huge frame is 512 or 262144 frames.
+        uint64_t num_words = (uint64_t(1) << shift) / 64;
+        while (next < sizes[order])
+        {
+            frame = first_frame + (orders[order].at(next++) << shift);
+
+            uint64_t *words = &used_frame_pool[frame / 64];
+            bool free = true;
+            for (uint64_t w = 0; w < num_words && free; w++) { free = words[w] == 0; }
+            if (!free) { continue; }
+
+            for (uint64_t w = 0; w < num_words; w++) { words[w] = ~uint64_t(0); }
+            return true;
+        }
+        return false;
+    }
+
+    Addr firstFrame() const { return first_frame; }
+    uint64_t numFrames() const { return num_frames; }
+
+  protected:
+    const Addr first_frame; // Aligned to 1GB.
+    const uint64_t num_frames;
+
+    // By page size, from 1GB to 4kB.
+    std::vector<FramePermutation> orders;
+    std::vector<uint64_t> sizes;
+    std::vector<uint64_t> nexts;
+};
+
 class SingleNode : public MMU
 {
   protected:
+    const Config::Page_Policy page_policy;
+    const unsigned thp_threshold;
+
     // All the touched pages for each core (application/memory space).
-    std::vector<std::unordered_map<Addr,Addr>> pages_by_cores;
+    std::vector<PageTable> pages_by_cores;
+
+    // The latest translation of each core, in front of its page table.
+    struct Translation
+    {
+        Addr virtual_page_id; // In pages of its size.
+        Addr page_id; // First frame of the page.
+        unsigned leaf_level; // See PageTable.
+    };
+    std::vector<Translation> last_translations;
 
-    // A pool of free physical pages
-    std::vector<Addr> free_frame_pool;
+    // THP: the number of touched 4kB pages of each 2MB region not promoted yet, per core.
+    std::vector<std::unordered_map<Addr, unsigned>> thp_regions;
 
-    // A pool of used physical pages.
-    std::unordered_map<Addr,bool> used_frame_pool;
+    // TODO, hard-coded so far (128GB), only a MultiNode sets it (the total of its nodes).
+    const unsigned memory_size_gb;
+    const uint64_t num_frames;
+
+    // All the memory.
+    FramePool frame_pool;
+
+    // Used physical pages, one bit per frame.
+    std::vector<uint64_t> used_frame_pool;
+
+    // Frames of page-table nodes per core (64GB of page tables).
+    static const unsigned page_table_frames_shift = 24;
+
+    // Mapped pages, by level of their entry (PageTable::leaf_4kB, leaf_2MB, leaf_1GB).
+    uint64_t num_pages[PageTable::num_levels] = {};
+    uint64_t thp_promotions = 0;
+    uint64_t huge_page_failures = 0; // No free frame of the size, a smaller page instead.
 
-    // TODO, hard-coded so far.
-    const unsigned memory_size_gb = 128;
   public:
-    SingleNode(int num_of_cores)
-        : MMU(num_of_cores)
+    virtual ~SingleNode() {}
+
+    SingleNode(int num_of_cores,
+               Config::Page_Policy _page_policy = Config::Page_Policy::PAGES_4KB,
+               unsigned _thp_threshold = 256,
+               unsigned _memory_size_gb = 128)
+        : MMU(num_of_cores),
+          page_policy(_page_policy),
+          thp_threshold(_thp_threshold),
+          memory_size_gb(_memory_size_gb),
+          num_frames(uint64_t(memory_size_gb) * 1024 * 1024 / 4),
+          frame_pool(0, num_frames, 0),
+          used_frame_pool((num_frames + 63) / 64, 0)
     {
         pages_by_cores.resize(num_of_cores);
+        last_translations.resize(num_of_cores,
+                                 Translation{~Addr(0), 0, PageTable::leaf_4kB});
+        thp_regions.resize(num_of_cores);
+    }
+
+    bool isUsed(Addr frame) const { return (used_frame_pool[frame / 64] >> (frame % 64)) & 1; }
 
-        for (unsigned int i = 0; i < memory_size_gb * 1024 * 1024 / 4; i++)
+    // The level of the entry that maps a (translated) virtual page of a core (see PageTable).
+    unsigned pageLevel(int core_id, Addr virtual_page_id) const
+    {
+        const Translation &last = last_translations[core_id];
+        if (last.virtual_page_id == virtual_page_id >> PageTable::pageShift(last.leaf_level))
         {
-            // All available pages
-            free_frame_pool.push_back(i);
+            return last.leaf_level;
         }
-        std::random_shuffle(free_frame_pool.begin(), free_frame_pool.end());
+
+        unsigned leaf_level;
+        pages_by_cores[core_id].lookup(virtual_page_id, leaf_level);
+        return leaf_level;
+    }
+
+    // Physical addresses of the page-table entries a walk of a (translated) virtual page reads,
+    // one per level from the root down to the entry of the page; returns their number, 0 if the
+    // page has no radix path. The page tables are not in the simulated memory, their nodes get
+    // frames above it, apart for each core.
+    unsigned walkAddrs(int core_id, Addr virtual_page_id, Addr addrs[PageTable::num_levels]) const
+    {
+        uint64_t nodes[PageTable::num_levels];
+        unsigned num_levels = pages_by_cores[core_id].path(virtual_page_id, nodes);
+
+        Addr base = num_frames + (Addr(core_id) << page_table_frames_shift);
+        for (unsigned level = 0; level < num_levels; level++)
+        {
+            Addr entry = PageTable::index(virtual_page_id, level) * sizeof(uint64_t);
+            addrs[level] = ((base + nodes[level]) << Mapper::va_page_shift) | entry;
+        }
+        return num_levels;
     }
 
     void va2pa(Request &req) override
@@ -119,32 +331,139 @@ class SingleNode : public MMU
         Addr va = req.addr;
         Addr virtual_page_id = va >> Mapper::va_page_shift;
 
-        auto &pages = pages_by_cores[core_id];
-        
-        auto p_iter = pages.find(virtual_page_id);
-        if (p_iter != pages.end())
+        Translation &last = last_translations[core_id];
+        unsigned shift = PageTable::pageShift(last.leaf_level);
+        if (last.virtual_page_id != virtual_page_id >> shift)
         {
-            Addr page_id = p_iter->second;
-            req.addr = (page_id << Mapper::va_page_shift) |
-                       (va & Mapper::va_page_mask);
+            unsigned leaf_level;
+            uint64_t entry = pages_by_cores[core_id].lookup(virtual_page_id, leaf_level);
+            if (entry == PageTable::NONE) { entry = map(core_id, virtual_page_id, leaf_level); }
+
+            shift = PageTable::pageShift(leaf_level);
+            last.virtual_page_id = virtual_page_id >> shift;
+            last.page_id = PageTable::frameOf(entry);
+            last.leaf_level = leaf_level;
         }
-        else
+
+        Addr frame = last.page_id + (virtual_page_id & ((Addr(1) << shift) - 1));
+        req.addr = (frame << Mapper::va_page_shift) |
+                   (va & Mapper::va_page_mask);
+    }
+
+    virtual void registerStats(Stats &stats)
+    {
+        uint64_t num_nodes = 0;
+        for (auto &pages : pages_by_cores) { num_nodes += pages.numNodes(); }
+
+        stats.registerStats("MMU: Number of 4kB pages = " +
+                            to_string(num_pages[PageTable::leaf_4kB]));
+        stats.registerStats("MMU: Number of 2MB pages = " +
+                            to_string(num_pages[PageTable::leaf_2MB]));
+        stats.registerStats("MMU: Number of 1GB pages = " +
+                            to_string(num_pages[PageTable::leaf_1GB]));
+        stats.registerStats("MMU: Number of THP promotions = " + to_string(thp_promotions));
+        stats.registerStats("MMU: Number of huge page allocation failures = " +
+                            to_string(huge_page_failures));
+        stats.registerStats("MMU: Page-table memory (kB) = " +
+                            to_string(num_nodes * (Mapper::page_size / 1024)) + "\n");
+    }
+
+  protected:
+    // Maps a virtual page of a core as the policy says, no larger than the level lookup() found
+    // no entry at (a huge page of the policy may have been mapped as smaller pages), and returns
+    // its entry and level.
+    uint64_t map(int core_id, Addr virtual_page_id, unsigned &leaf_level)
+    {
+        PageTable &pages = pages_by_cores[core_id];
+        bool high = virtual_page_id >> PageTable::vpn_bits != 0;
+
+        // The pages above 48 bits are 4kB pages.
+        unsigned policy_level = PageTable::leaf_4kB;
+        if (!high && page_policy == Config::Page_Policy::PAGES_2MB)
+        {
+            policy_level = PageTable::leaf_2MB;
+        }
+        else if (!high && page_policy == Config::Page_Policy::PAGES_1GB)
+        {
+            policy_level = PageTable::leaf_1GB;
+        }
+        leaf_level = std::max(leaf_level, policy_level);
+
+        // Falls back to smaller pages, and stops the simulation if not even a 4kB frame is free
+        // (there is no smaller level to allocate from).
+        Addr frame;
+        while (!allocate(core_id, virtual_page_id, leaf_level, frame))
         {
-            auto &free_frames = free_frame_pool;
+            if (leaf_level == PageTable::leaf_4kB)
+            {
+                std::cerr << "MMU: Error: out of physical memory, no free 4kB frame left for "
+                          << "core " << core_id << " (" << memory_size_gb << " GB of memory)"
+                          << std::endl;
+                std::exit(1);
+            }
+            huge_page_failures++;
+            leaf_level++;
+        }
+
+        uint64_t entry = PageTable::entryOf(frame);
+        pages.entry(virtual_page_id, leaf_level) = entry;
+        num_pages[leaf_level]++;
+
+        if (page_policy == Config::Page_Policy::THP && !high)
+        {
+            promote(core_id, virtual_page_id, leaf_level, entry);
+        }
+        return entry;
+    }
 
-            auto &used_frames = used_frame_pool;
+    // THP: counts a new 4kB page of a 2MB region, and once the region has thp_threshold of
+    // them, replaces them by a 2MB page (their entry and level become those of the 2MB page).
+    void promote(int core_id, Addr virtual_page_id, unsigned &leaf_level, uint64_t &entry)
+    {
+        const unsigned region_shift = PageTable::pageShift(PageTable::leaf_2MB);
+        Addr region = virtual_page_id >> region_shift;
+
+        unsigned &touched = thp_regions[core_id][region];
+        if (++touched < thp_threshold) { return; }
 
-            // Choose a free frame
-            Addr free_frame = *(free_frames.begin());
+        // Tried again on every new page of the region if no 2MB frame is free.
+        Addr huge_frame;
+        if (!allocate(core_id, virtual_page_id, PageTable::leaf_2MB, huge_frame))
+        {
+            huge_page_failures++;
+            return;
+        }
+        thp_regions[core_id].erase(region);
 
-            free_frames.erase(free_frames.begin());
-            used_frames.insert({free_frame, true});
+        PageTable &pages = pages_by_cores[core_id];
+        Addr first = region << region_shift;
+        for (Addr vpn = first; vpn < first + (Addr(1) << region_shift); vpn++)
+        {
+            unsigned level;
+            uint64_t old = pages.lookup(vpn, level);
+            if (old == PageTable::NONE) { continue; }
 
-            req.addr = (free_frame << Mapper::va_page_shift) |
-                       (va & Mapper::va_page_mask);
-            // Insert the page
-            pages.insert({virtual_page_id, free_frame});
+            release(PageTable::frameOf(old));
+            num_pages[PageTable::leaf_4kB]--;
         }
+
+        entry = PageTable::entryOf(huge_frame);
+        pages.collapse(first, PageTable::leaf_2MB, entry);
+        leaf_level = PageTable::leaf_2MB;
+        num_pages[leaf_level]++;
+        thp_promotions++;
+    }
+
+    // The first frame of a free physical page of the size of a level for a virtual page of a
+    // core, false if there is none.
+    virtual bool allocate(int core_id, Addr virtual_page_id, unsigned leaf_level, Addr &frame)
+    {
+        return frame_pool.allocate(leaf_level, used_frame_pool, frame);
+    }
+
+    void release(Addr frame)
+    {
+        used_frame_pool[frame / 64] &= ~(uint64_t(1) << (frame % 64));
     }
 };
 }
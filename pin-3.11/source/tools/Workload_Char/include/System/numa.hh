@@ -0,0 +1,260 @@
+#ifndef __NUMA_HH__
+#define __NUMA_HH__
+
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mmu.hh"
+#include "../Sim/config.hh"
+#include "../Sim/mem_object.hh"
+#include "../Sim/stats.hh"
+#include "../Sim/util.hh"
+
+namespace System
+{
+// A SingleNode whose memory is split into nodes (numa_ parameters of the configuration), one
+// after the other in the physical address space, each with its own frame pool. The cores are
+// spread evenly over the nodes, in order (core i is on node i * nodes / cores). A new page goes
+// to the node the placement policy picks, or to the next node that has room. Pages are placed
+// as a whole, a huge page is on a single node.
+//
+// With a migration threshold, a 4kB page accessed that many times from a core of another node
+// (its core, each core has its own address space) moves to the node of that core if it has
+// room; the caches keep the lines of the old frame until they are evicted.
+class MultiNode : public SingleNode
+{
+  public:
+    MultiNode(Config &cfg)
+        : SingleNode(cfg.num_cores, cfg.page_policy, cfg.thp_threshold, totalSizeGB(cfg)),
+          num_nodes(cfg.numa_nodes),
+          placement(cfg.numa_placement),
+          preferred_node(cfg.numa_preferred_node),
+          migration_threshold(cfg.numa_migration_threshold)
+    {
+        assert(num_nodes > 0);
+
+        Addr first_frame = 0;
+        for (unsigned node = 0; node < num_nodes; node++)
+        {
+            uint64_t frames = uint64_t(cfg.numaSizeGB(node)) * 1024 * 1024 / 4;
+            nodes.push_back(Node{FramePool(first_frame, frames, 3 * node),
+                                 cfg.numaLocalLatency(node), cfg.numaRemoteLatency(node),
+                                 0, 0});
+            first_frame += frames;
+        }
+
+        for (unsigned core = 0; core < cfg.num_cores; core++)
+        {
+            core_nodes.push_back(unsigned(uint64_t(core) * num_nodes / cfg.num_cores));
+        }
+    }
+
+    unsigned numNodes() const { return num_nodes; }
+    unsigned numCores() const { return core_nodes.size(); }
+    unsigned coreNode(int core_id) const { return core_nodes[core_id]; }
+    unsigned localLatency(unsigned node) const { return nodes[node].local_latency; }
+    unsigned remoteLatency(unsigned node) const { return nodes[node].remote_latency; }
+
+    // The node of a physical address; the page tables, which are not in the simulated memory
+    // (see walkAddrs()), are on the node of the core that walks them.
+    unsigned addrNode(Addr pa, int core_id) const
+    {
+        Addr frame = pa >> Mapper::va_page_shift;
+        if (frame >= num_frames) { return core_nodes[core_id]; }
+
+        unsigned node = num_nodes - 1;
+        while (nodes[node].pool.firstFrame() > frame) { node--; }
+        return node;
+    }
+
+    void va2pa(Request &req) override
+    {
+        Addr va = req.addr;
+        SingleNode::va2pa(req);
+        if (migration_threshold == 0) { return; }
+
+        int core_id = req.core_id;
+        Translation &last = last_translations[core_id];
+        if (last.leaf_level != PageTable::leaf_4kB) { return; }
+
+        Addr frame = last.page_id;
+        unsigned core_node = core_nodes[core_id];
+        if (addrNode(frame << Mapper::va_page_shift, core_id) == core_node) { return; }
+
+        unsigned &count = remote_accesses[frame];
+        if (++count < migration_threshold) { return; }
+        remote_accesses.erase(frame);
+
+        Addr new_frame;
+        if (!nodes[core_node].pool.allocate(PageTable::leaf_4kB, used_frame_pool, new_frame))
+        {
+            return;
+        }
+        release(frame);
+
+        Addr virtual_page_id = va >> Mapper::va_page_shift;
+        pages_by_cores[core_id].entry(virtual_page_id) = PageTable::entryOf(new_frame);
+        last.page_id = new_frame;
+        migrations++;
+
+        req.addr = (new_frame << Mapper::va_page_shift) | (va & Mapper::va_page_mask);
+    }
+
+    void registerStats(Stats &stats) override
+    {
+        SingleNode::registerStats(stats);
+
+        for (unsigned node = 0; node < num_nodes; node++)
+        {
+            const FramePool &pool = nodes[node].pool;
+            uint64_t used = 0;
+            for (Addr word = pool.firstFrame() / 64;
+                 word < (pool.firstFrame() + pool.numFrames()) / 64; word++)
+            {
+                used += __builtin_popcountll(used_frame_pool[word]);
+            }
+
+            std::string name = "MMU node " + to_string(node);
+            stats.registerStats(name + ": Used memory (MB) = " + to_string(used * 4 / 1024));
+            stats.registerStats(name + ": Number of pages placed = " +
+                                to_string(nodes[node].placed));
+            stats.registerStats(name + ": Number of pages placed for another node = " +
+                                to_string(nodes[node].spilled));
+        }
+        stats.registerStats("MMU: Number of page migrations = " + to_string(migrations) + "\n");
+    }
+
+  protected:
+    const unsigned num_nodes;
+    const Config::NUMA_Placement placement;
+    const unsigned preferred_node;
+    const unsigned migration_threshold;
+
+    struct Node
+    {
+        FramePool pool;
+        unsigned local_latency;
+        unsigned remote_latency;
+
+        uint64_t placed; // Pages (of any size) placed on the node.
+        uint64_t spilled; // Those of them the policy wanted on another (full) node.
+    };
+    std::vector<Node> nodes;
+
+    std::vector<unsigned> core_nodes;
+
+    // Remote accesses of the 4kB pages since they were placed, by frame.
+    std::unordered_map<Addr, unsigned> remote_accesses;
+    uint64_t migrations = 0;
+
+    static unsigned totalSizeGB(Config &cfg)
+    {
+        unsigned size_gb = 0;
+        for (unsigned node = 0; node < cfg.numa_nodes; node++)
+        {
+            size_gb += cfg.numaSizeGB(node);
+        }
+        return size_gb;
+    }
+
+    bool allocate(int core_id, Addr virtual_page_id, unsigned leaf_level, Addr &frame) override
+    {
+        unsigned first = preferred_node;
+        if (placement == Config::NUMA_Placement::FIRST_TOUCH) { first = core_nodes[core_id]; }
+        else if (placement == Config::NUMA_Placement::INTERLEAVE)
+        {
+            first = (virtual_page_id >> PageTable::pageShift(leaf_level)) % num_nodes;
+        }
+
+        for (unsigned i = 0; i < num_nodes; i++)
+        {
+            Node &node = nodes[(first + i) % num_nodes];
+            if (!node.pool.allocate(leaf_level, used_frame_pool, frame)) { continue; }
+
+            node.placed++;
+            if (i != 0) { node.spilled++; }
+            return true;
+        }
+        return false;
+    }
+};
+
+// Main memory behind the last level of the caches of a platform, with the nodes of a MultiNode
+// MMU: every request that leaves the caches (the load of a missed block, a write-back) goes to
+// the node of its physical address, and is local or remote for the core it comes from. A
+// write-back of a shared level counts for the core whose miss evicted the block. The cycles are
+// estimated from the latencies of the nodes.
+class Memory : public MemObject
+{
+  public:
+    Memory(MultiNode &_mmu)
+        : mmu(_mmu),
+          num_cores(_mmu.numCores()),
+          counters(_mmu.numNodes() * _mmu.numCores())
+    {}
+
+    bool send(Request &req) override
+    {
+        unsigned node = mmu.addrNode(req.addr, req.core_id);
+        bool local = node == mmu.coreNode(req.core_id);
+        Counters &counter = counters[node * num_cores + req.core_id];
+
+        bool write = req.req_type != Request::Request_Type::READ;
+        if (local) { (write ? counter.local_writes : counter.local_reads)++; }
+        else { (write ? counter.remote_writes : counter.remote_reads)++; }
+        counter.cycles += local ? mmu.localLatency(node) : mmu.remoteLatency(node);
+        return true;
+    }
+
+    void registerStats(Stats &stats) override
+    {
+        uint64_t local = 0, remote = 0, cycles = 0;
+        for (unsigned node = 0; node < mmu.numNodes(); node++)
+        {
+            for (unsigned core = 0; core < num_cores; core++)
+            {
+                const Counters &counter = counters[node * num_cores + core];
+                std::string name = "Memory node " + to_string(node) + ", core " +
+                                   to_string(core);
+                stats.registerStats(name + ": Number of local reads = " +
+                                    to_string(counter.local_reads));
+                stats.registerStats(name + ": Number of remote reads = " +
+                                    to_string(counter.remote_reads));
+                stats.registerStats(name + ": Number of local writes = " +
+                                    to_string(counter.local_writes));
+                stats.registerStats(name + ": Number of remote writes = " +
+                                    to_string(counter.remote_writes));
+                stats.registerStats(name + ": Estimated cycles = " + to_string(counter.cycles));
+
+                local += counter.local_reads + counter.local_writes;
+                remote += counter.remote_reads + counter.remote_writes;
+                cycles += counter.cycles;
+            }
+        }
+
+        double remote_ratio = local + remote == 0 ? 0 :
+                              double(remote) / double(local + remote) * 100;
+        stats.registerStats("Memory: Remote access ratio = " + to_string(remote_ratio) + "%");
+        stats.registerStats("Memory: Estimated cycles = " + to_string(cycles) + "\n");
+    }
+
+  protected:
+    MultiNode &mmu;
+    const unsigned num_cores;
+
+    struct Counters
+    {
+        uint64_t local_reads = 0;
+        uint64_t remote_reads = 0;
+        uint64_t local_writes = 0;
+        uint64_t remote_writes = 0;
+        uint64_t cycles = 0;
+    };
+    std::vector<Counters> counters; // By node, then core.
+};
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef __PAGE_TABLE_HH__
+#define __PAGE_TABLE_HH__
+
+#include <cassert>
+#include <unordered_map>
+#include <vector>
+
+#include "../Sim/request.hh"
+
+namespace System
+{
+// The page table of one address space, as on x86-64: four levels of 512 entries, indexed by
+// 9 bits of the virtual page number each (48-bit virtual addresses, 4kB pages). An entry of the
+// PDPT (level 1) or of the PD (level 2) can also map a whole 1GB or 2MB page instead of pointing
+// to a node of the level below. Nodes are only allocated when a page under them is mapped, from
+// an arena of fixed-size chunks (a node never moves, a freed one is reused). Virtual pages above
+// 48 bits, which Pin does not hand out in user space, go to a hash map instead (4kB pages only).
+class PageTable
+{
+  public:
+    static const unsigned num_levels = 4;
+    static const unsigned index_bits = 9;
+    static const uint64_t fanout = uint64_t(1) << index_bits;
+    static const unsigned vpn_bits = num_levels * index_bits;
+
+    // Levels an entry can map a page at.
+    static const unsigned leaf_4kB = num_levels - 1;
+    static const unsigned leaf_2MB = num_levels - 2;
+    static const unsigned leaf_1GB = num_levels - 3;
+
+    static const uint64_t NONE = 0; // No child / unmapped page.
+    static const uint64_t LEAF = uint64_t(1) << 63; // The entry maps a page (see entryOf()).
+
+    PageTable() { newNode(); } // The root, node 0.
+
+    // The entry that maps the page of vpn at a level, allocating the nodes above it: NONE if the
+    // page is not mapped, its first frame with the LEAF bit otherwise (see frameOf() and
+    // entryOf()). No page above that level may map vpn.
+    uint64_t &entry(Addr vpn, unsigned leaf_level = leaf_4kB)
+    {
+        if (vpn >> vpn_bits != 0)
+        {
+            assert(leaf_level == leaf_4kB);
+            return high_pages[vpn];
+        }
+
+        uint64_t node = 0;
+        for (unsigned level = 0; level < leaf_level; level++)
+        {
+            uint64_t child = getNode(node).entries[index(vpn, level)];
+            assert(!isLeaf(child));
+            if (child == NONE)
+            {
+                child = newNode(); // May add a chunk, look the entry up again.
+                getNode(node).entries[index(vpn, level)] = child;
+            }
+            node = child;
+        }
+        return getNode(node).entries[index(vpn, leaf_level)];
+    }
+
+    // The entry that maps the page of vpn, and its level, without allocating anything (NONE if
+    // the page is not mapped).
+    uint64_t lookup(Addr vpn, unsigned &leaf_level) const
+    {
+        leaf_level = leaf_4kB;
+        if (vpn >> vpn_bits != 0)
+        {
+            auto iter = high_pages.find(vpn);
+            return iter == high_pages.end() ? NONE : iter->second;
+        }
+
+        uint64_t node = 0;
+        for (unsigned level = 0; level < num_levels - 1; level++)
+        {
+            uint64_t child = getNode(node).entries[index(vpn, level)];
+            if (child == NONE || isLeaf(child))
+            {
+                leaf_level = level;
+                return child;
+            }
+            node = child;
+        }
+        return getNode(node).entries[index(vpn, num_levels - 1)];
+    }
+
+    // Maps the page of vpn at a level (a 2MB or 1GB page) in place of whatever the entry held,
+    // freeing the nodes below it (the caller releases the frames of the pages they mapped).
+    void collapse(Addr vpn, unsigned leaf_level, uint64_t leaf_entry)
+    {
+        assert(isLeaf(leaf_entry));
+        uint64_t &slot = entry(vpn, leaf_level);
+        if (slot != NONE && !isLeaf(slot)) { freeNodes(slot, leaf_level + 1); }
+        slot = leaf_entry;
+    }
+
+    // The nodes a walk of a mapped virtual page goes through, from the root down to the level
+    // of its page; returns the number of them, 0 for the pages above 48 bits, which have none.
+    unsigned path(Addr vpn, uint64_t nodes[num_levels]) const
+    {
+        if (vpn >> vpn_bits != 0) { return 0; }
+
+        uint64_t node = 0;
+        for (unsigned level = 0; level < num_levels; level++)
+        {
+            nodes[level] = node;
+            if (level + 1 == num_levels) { break; }
+
+            node = getNode(node).entries[index(vpn, level)];
+            if (node == NONE || isLeaf(node)) { return level + 1; }
+        }
+        return num_levels;
+    }
+
+    // The index of the entry of vpn in its node of a level.
+    static unsigned index(Addr vpn, unsigned level)
+    {
+        return (vpn >> ((num_levels - 1 - level) * index_bits)) & (fanout - 1);
+    }
+
+    // log2 of the number of 4kB pages of a page mapped at a level.
+    static unsigned pageShift(unsigned leaf_level)
+    {
+        return (num_levels - 1 - leaf_level) * index_bits;
+    }
+
+    static bool isLeaf(uint64_t entry) { return (entry & LEAF) != 0; }
+    static Addr frameOf(uint64_t entry) { return entry & ~LEAF; }
+    static uint64_t entryOf(Addr frame) { return frame | LEAF; }
+
+    // Nodes in use.
+    uint64_t numNodes() const { return num_nodes - free_nodes.size(); }
+
+  protected:
+    struct Node
+    {
+        uint64_t entries[fanout];
+    };
+
+    static const unsigned chunk_bits = 6; // 64 nodes (256kB) per chunk.
+    std::vector<std::vector<Node>> chunks;
+    uint64_t num_nodes = 0;
+    std::vector<uint64_t> free_nodes;
+
+    // Only the entries above the vpn_bits.
+    std::unordered_map<Addr, uint64_t> high_pages;
+
+    Node &getNode(uint64_t node)
+    {
+        return chunks[node >> chunk_bits][node & ((uint64_t(1) << chunk_bits) - 1)];
+    }
+
+    const Node &getNode(uint64_t node) const
+    {
+        return chunks[node >> chunk_bits][node & ((uint64_t(1) << chunk_bits) - 1)];
+    }
+
+    uint64_t newNode()
+    {
+        if (!free_nodes.empty())
+        {
+            uint64_t node = free_nodes.back();
+            free_nodes.pop_back();
+            for (auto &entry : getNode(node).entries) { entry = NONE; }
+            return node;
+        }
+
+        if ((num_nodes & ((uint64_t(1) << chunk_bits) - 1)) == 0)
+        {
+            chunks.emplace_back();
+            chunks.back().reserve(uint64_t(1) << chunk_bits);
+        }
+        chunks.back().emplace_back();
+        for (auto &entry : chunks.back().back().entries) { entry = NONE; }
+        return num_nodes++;
+    }
+
+    // A node of a level and the nodes below it.
+    void freeNodes(uint64_t node, unsigned level)
+    {
+        if (level + 1 < num_levels)
+        {
+            for (auto child : getNode(node).entries)
+            {
+                if (child != NONE && !isLeaf(child)) { freeNodes(child, level + 1); }
+            }
+        }
+        free_nodes.push_back(node);
+    }
+};
+}
+
+#endif
@@ -0,0 +1,437 @@
+#ifndef __PLATFORMS_HH__
+#define __PLATFORMS_HH__
+
+#include <string>
+#include <vector>
+
+#include "mmu.hh"
+#include "numa.hh"
+#include "tlb.hh"
+#include "../Sim/config.hh"
+#include "../CacheSim/hierarchy.hh"
+#include "../CacheSim/static_configs.hh"
+
+namespace System
+{
+// Several platforms (configurations) simulated side by side on the same accesses. The work
+// that does not depend on the caches is done once per access: the virtual address is split
+// into lines once per distinct block size, and translated once per core of each distinct
+// memory system (number of cores, page policy, NUMA nodes, see Config::sameMMU()). Platforms
+// with the same memory system share an MMU (the frame allocation interleaves the cores, and
+// depends on the page sizes and nodes, so sharing it otherwise would not give the mapping of a
+// separate run). Every platform then only updates its own hierarchy, and ends up with the stats
+// it would have on its own. A platform with NUMA nodes gets a MultiNode MMU, and a Memory
+// behind its caches.
+//
+// As in wl_char_roi, every access goes to all the cores of a platform. Platforms without an
+// L1-I (or L1-D) skip instruction fetches (or data accesses).
+//
+// A platform whose configuration has a compile-time hierarchy (CacheSim/static_configs.hh)
+// uses it, unless disabled; the others, and the first platform when an observer watches one of
+// its lower levels, get the run-time Hierarchy. Both give the same stats. With the legacy
+// wiring (see CacheSimulator::Hierarchy), every platform gets the run-time Hierarchy.
+//
+// A platform whose configuration has TLBs (see tlb.hh) looks up every page it fetches from or
+// accesses in them, and its page walks read the page tables through its L1-D if the
+// configuration says so (walk_refs_to_caches); observers do not see those reads.
+//
+// Observers (e.g., a StackDistance profiler) see the requests going into one level of the first
+// platform: the data accesses of its first core for L1-D, its instruction fetches for L1-I,
+// or whatever the levels above send down for L2, L3 and eDRAM.
+class Platforms
+{
+  public:
+    struct Platform
+    {
+        std::string name; // Configuration file name, without directory and extension.
+        Config *cfg;
+        CacheSimulator::Hierarchy *caches; // nullptr if static_caches is used.
+        CacheSimulator::StaticHierarchyBase *static_caches;
+        TLBs *tlbs; // nullptr if the configuration has none.
+        Memory *memory; // nullptr without NUMA nodes, set by init().
+        Data *data; // Data-aware tracing of its LLC, see traceData().
+        ofstream *trace_out;
+        NVMWrites *nvm_writes; // Analysis of the write-backs of its LLC, see traceData().
+        unsigned space; // Its MMU, see init().
+    };
+
+    Platforms(bool _use_static = true,
+              CacheSimulator::Hierarchy::Wiring _wiring =
+                  CacheSimulator::Hierarchy::Wiring::LEVELS)
+        : use_static(_use_static && _wiring == CacheSimulator::Hierarchy::Wiring::LEVELS),
+          wiring(_wiring)
+    {}
+
+    ~Platforms()
+    {
+        for (auto &platform : platforms)
+        {
+            delete platform.caches;
+            delete platform.static_caches;
+            delete platform.tlbs;
+            delete platform.memory;
+            delete platform.cfg;
+        }
+        for (auto &space : spaces) { delete space.mmu; }
+    }
+
+    // Add all the platforms first, then init().
+    void add(const std::string &cfg_file)
+    {
+        Platform platform;
+        platform.cfg = new Config(cfg_file);
+        platform.static_caches = use_static ?
+                                 CacheSimulator::createStaticHierarchy(*platform.cfg) : nullptr;
+        platform.caches = platform.static_caches == nullptr ?
+                          new CacheSimulator::Hierarchy(*platform.cfg, wiring) : nullptr;
+        platform.tlbs = platform.cfg->hasTLBs() ? new TLBs(*platform.cfg) : nullptr;
+        platform.memory = nullptr;
+        platform.data = nullptr;
+        platform.trace_out = nullptr;
+        platform.nvm_writes = nullptr;
+
+        size_t begin = cfg_file.find_last_of('/');
+        begin = begin == std::string::npos ? 0 : begin + 1;
+        size_t end = cfg_file.find_last_of('.');
+        end = end == std::string::npos || end < begin ? cfg_file.size() : end;
+        platform.name = cfg_file.substr(begin, end - begin);
+
+        platforms.push_back(platform);
+    }
+
+    void init()
+    {
+        for (unsigned p = 0; p < platforms.size(); p++)
+        {
+            Config &cfg = *platforms[p].cfg;
+            if (cfg.num_cores > num_cores) { num_cores = cfg.num_cores; }
+
+            unsigned split = 0;
+            while (split < splits.size() && splits[split].block_size != cfg.block_size)
+            {
+                split++;
+            }
+            if (split == splits.size())
+            {
+                splits.emplace_back();
+                splits[split].block_size = cfg.block_size;
+            }
+
+            unsigned s = 0;
+            while (s < spaces.size() && !spaces[s].cfg->sameMMU(cfg)) { s++; }
+            if (s == spaces.size())
+            {
+                spaces.emplace_back();
+                spaces[s].cfg = &cfg;
+                spaces[s].num_cores = cfg.num_cores;
+                spaces[s].mmu = cfg.numa_nodes > 0 ? new MultiNode(cfg) :
+                                new SingleNode(cfg.num_cores, cfg.page_policy,
+                                               cfg.thp_threshold);
+            }
+            Address_Space &space = spaces[s];
+            platforms[p].space = s;
+
+            if (cfg.numa_nodes > 0)
+            {
+                platforms[p].memory = new Memory(*static_cast<MultiNode*>(space.mmu));
+                connectLastLevel(p);
+            }
+
+            unsigned g = 0;
+            while (g < space.groups.size() && space.groups[g].split != split) { g++; }
+            if (g == space.groups.size())
+            {
+                space.groups.emplace_back();
+                space.groups[g].split = split;
+            }
+            space.groups[g].platforms.push_back(p);
+        }
+    }
+
+    // Call after init().
+    void addObserver(MemObject *observer,
+                     Config::Cache_Level lev = Config::Cache_Level::L1D)
+    {
+        if (lev == Config::Cache_Level::L1D) { observers.push_back(observer); }
+        else if (lev == Config::Cache_Level::L1I) { fetch_observers.push_back(observer); }
+        else
+        {
+            // The taps go into the run-time hierarchy.
+            Platform &platform = platforms[0];
+            if (platform.caches == nullptr)
+            {
+                delete platform.static_caches;
+                platform.static_caches = nullptr;
+                platform.caches = new CacheSimulator::Hierarchy(*platform.cfg, wiring);
+                connectLastLevel(0);
+            }
+            platform.caches->observe(lev, observer);
+        }
+    }
+
+    // Data-aware tracing of the LLC of a platform (see CacheSimulator::Cache): the caller loads
+    // the lines into data as they come into the caches, and keeps it up to date. The trace
+    // (trace_out) and the analysis of the write-backs (nvm_writes) are optional.
+    void traceData(unsigned p, Data *data, ofstream *trace_out, NVMWrites *nvm_writes = nullptr)
+    {
+        platforms[p].data = data;
+        platforms[p].trace_out = trace_out;
+        platforms[p].nvm_writes = nvm_writes;
+        connectLastLevel(p);
+    }
+
+    // The caches of the last level of a platform (see Hierarchy::lastLevel()).
+    std::vector<MemObject*> lastLevel(unsigned p)
+    {
+        if (platforms[p].static_caches != nullptr)
+        {
+            return platforms[p].static_caches->lastLevel();
+        }
+
+        std::vector<MemObject*> caches;
+        for (auto cache : platforms[p].caches->lastLevel()) { caches.push_back(cache); }
+        return caches;
+    }
+
+    unsigned size() const { return platforms.size(); }
+    unsigned numCores() const { return num_cores; }
+    Platform &operator[](unsigned p) { return platforms[p]; }
+
+    void registerStats(unsigned p, Stats &stats)
+    {
+        if (platforms[p].static_caches != nullptr)
+        {
+            platforms[p].static_caches->registerStats(stats);
+        }
+        else { platforms[p].caches->registerStats(stats); }
+
+        if (platforms[p].tlbs != nullptr) { platforms[p].tlbs->registerStats(stats); }
+        if (platforms[p].memory != nullptr) { platforms[p].memory->registerStats(stats); }
+        if (platforms[p].nvm_writes != nullptr) { platforms[p].nvm_writes->registerStats(stats); }
+        spaces[platforms[p].space].mmu->registerStats(stats);
+    }
+
+    // Stats file of a platform: stats_file itself if there is a single platform, otherwise
+    // stats_file.<platform name>.
+    std::string statsFile(unsigned p, const std::string &stats_file) const
+    {
+        if (platforms.size() == 1) { return stats_file; }
+        return stats_file + "." + platforms[p].name;
+    }
+
+    // Instruction fetch of eip.
+    void fetch(Addr eip)
+    {
+        Request req;
+        req.instr_loading = true;
+        req.req_type = Request::Request_Type::READ;
+        req.eip = eip;
+
+        for (auto &space : spaces)
+        {
+            for (unsigned i = 0; i < space.num_cores; i++)
+            {
+                req.core_id = i;
+                req.addr = eip;
+                space.mmu->va2pa(req);
+
+                for (auto &group : space.groups)
+                {
+                    for (auto p : group.platforms)
+                    {
+                        translate(platforms[p], *space.mmu, i, eip >> Mapper::va_page_shift,
+                                  true);
+
+                        if (platforms[p].static_caches != nullptr)
+                        {
+                            platforms[p].static_caches->fetch(i, req);
+                        }
+                        else
+                        {
+                            auto &L1Is = platforms[p].caches->L1Is;
+                            if (!L1Is.empty()) { L1Is[i]->send(req); }
+                        }
+
+                        if (p == 0 && i == 0)
+                        {
+                            for (auto observer : fetch_observers) { observer->send(req); }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Data access of size bytes at addr, split at block boundaries (the first line keeps the
+    // unaligned address).
+    void access(Addr eip, Addr addr, unsigned size, bool is_store)
+    {
+        for (auto &split : splits) { splitLines(addr, size, split.block_size, split.lines); }
+
+        // Two pages at most, the access is smaller than a page.
+        Addr last_byte = addr + (size > 0 ? size - 1 : 0);
+        Addr first_page = addr >> Mapper::va_page_shift;
+        bool crosses_page = (last_byte >> Mapper::va_page_shift) != first_page;
+
+        Request req;
+        req.eip = eip;
+        req.req_type = is_store ? Request::Request_Type::WRITE : Request::Request_Type::READ;
+
+        for (auto &space : spaces)
+        {
+            for (unsigned i = 0; i < space.num_cores; i++)
+            {
+                req.core_id = i;
+                req.addr = addr;
+                space.mmu->va2pa(req);
+                Addr first_frame = req.addr >> Mapper::va_page_shift;
+
+                Addr second_frame = first_frame;
+                if (crosses_page)
+                {
+                    req.addr = last_byte;
+                    space.mmu->va2pa(req);
+                    second_frame = req.addr >> Mapper::va_page_shift;
+                }
+
+                for (auto &group : space.groups)
+                {
+                    for (auto p : group.platforms)
+                    {
+                        translate(platforms[p], *space.mmu, i, first_page, false);
+                        if (crosses_page)
+                        {
+                            translate(platforms[p], *space.mmu, i, first_page + 1, false);
+                        }
+                    }
+                }
+
+                for (auto &group : space.groups)
+                {
+                    for (auto line : splits[group.split].lines)
+                    {
+                        Addr frame = (line >> Mapper::va_page_shift) == first_page ?
+                                     first_frame : second_frame;
+                        req.addr = (frame << Mapper::va_page_shift) |
+                                   (line & Mapper::va_page_mask);
+
+                        for (auto p : group.platforms)
+                        {
+                            sendData(platforms[p], i, req);
+
+                            if (p == 0 && i == 0)
+                            {
+                                for (auto observer : observers) { observer->send(req); }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // The lines an access touches, and how many of its bytes fall in each.
+    static void splitLines(Addr addr, unsigned size, unsigned block_size,
+                           std::vector<Addr> &lines, std::vector<unsigned> *sizes = nullptr)
+    {
+        Addr block_mask = Addr(block_size) - 1;
+        Addr end = addr + (size > 0 ? size : 1);
+
+        lines.clear();
+        if (sizes != nullptr) { sizes->clear(); }
+        for (Addr line = addr; line < end; line = (line & ~block_mask) + block_size)
+        {
+            lines.push_back(line);
+            if (sizes != nullptr)
+            {
+                Addr next = (line & ~block_mask) + block_size;
+                sizes->push_back(unsigned((next < end ? next : end) - line));
+            }
+        }
+    }
+
+    // The MMU of the first platform (and of those with its memory system).
+    SingleNode &getMMU() { return *spaces[platforms[0].space].mmu; }
+
+  protected:
+    const bool use_static;
+    const CacheSimulator::Hierarchy::Wiring wiring;
+
+    // Memory and data-aware tracing of the last level of a platform, if any.
+    void connectLastLevel(unsigned p)
+    {
+        Platform &platform = platforms[p];
+        for (auto cache : lastLevel(p))
+        {
+            if (platform.memory != nullptr) { cache->setNextLevel(platform.memory); }
+            cache->setStorageUnit(platform.data);
+            cache->traceOutput(platform.trace_out);
+            cache->analyzeWrites(platform.nvm_writes);
+        }
+    }
+
+    // Data request of a core into a platform's caches.
+    static void sendData(Platform &platform, unsigned core, Request &req)
+    {
+        if (platform.static_caches != nullptr)
+        {
+            platform.static_caches->access(core, req);
+        }
+        else
+        {
+            auto &L1Ds = platform.caches->L1Ds;
+            if (!L1Ds.empty()) { L1Ds[core]->send(req); }
+        }
+    }
+
+    // TLB lookup of a page by a core of a platform, and the reads of its page walk if any.
+    void translate(Platform &platform, SingleNode &mmu, unsigned core, Addr virtual_page_id,
+                   bool instr)
+    {
+        if (platform.tlbs == nullptr) { return; }
+
+        platform.tlbs->translate(mmu, core, virtual_page_id, instr, walk_addrs);
+        for (auto addr : walk_addrs)
+        {
+            Request walk_req;
+            walk_req.core_id = core;
+            walk_req.eip = 0;
+            walk_req.addr = addr;
+            walk_req.req_type = Request::Request_Type::READ;
+            sendData(platform, core, walk_req);
+        }
+    }
+    std::vector<Addr> walk_addrs;
+
+    std::vector<Platform> platforms;
+    std::vector<MemObject*> observers;
+    std::vector<MemObject*> fetch_observers;
+
+    // The lines of the current access for one block size.
+    struct Line_Split
+    {
+        unsigned block_size;
+        std::vector<Addr> lines;
+    };
+    std::vector<Line_Split> splits;
+
+    // The platforms with the same number of cores, grouped by block size.
+    struct Platform_Group
+    {
+        unsigned split;
+        std::vector<unsigned> platforms;
+    };
+    struct Address_Space
+    {
+        const Config *cfg; // That of its first platform.
+        unsigned num_cores;
+        SingleNode *mmu;
+        std::vector<Platform_Group> groups;
+    };
+    std::vector<Address_Space> spaces;
+
+    unsigned num_cores = 0;
+};
+}
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef __TLB_HH__
+#define __TLB_HH__
+
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "mmu.hh"
+#include "../Sim/config.hh"
+#include "../Sim/stats.hh"
+#include "../Sim/util.hh"
+
+namespace System
+{
+// A set-associative LRU cache of translations, keyed by virtual page (or by the upper bits of its
+// number, for the page-walk cache). The set is the key modulo the number of sets, which
+// need not be a power of two (e.g., 1536 entries, 12-way).
+class TLB
+{
+  public:
+    TLB(unsigned entries, unsigned _assoc)
+        : assoc(_assoc),
+          num_sets(entries / _assoc),
+          keys(entries),
+          stamps(entries, 0)
+    {
+        assert(assoc > 0 && num_sets > 0 && num_sets * assoc == entries);
+    }
+
+    // Whether key is cached, inserting it (in place of the least recently used) if not.
+    bool access(Addr key)
+    {
+        accesses++;
+        clock++;
+
+        unsigned first = (key % num_sets) * assoc;
+        unsigned victim = first;
+        for (unsigned way = first; way < first + assoc; way++)
+        {
+            if (stamps[way] != 0 && keys[way] == key)
+            {
+                stamps[way] = clock;
+                hits++;
+                return true;
+            }
+            if (stamps[way] < stamps[victim]) { victim = way; }
+        }
+
+        keys[victim] = key;
+        stamps[victim] = clock;
+        return false;
+    }
+
+    // The keys it holds.
+    std::vector<Addr> validKeys() const
+    {
+        std::vector<Addr> valid;
+        for (unsigned way = 0; way < keys.size(); way++)
+        {
+            if (stamps[way] != 0) { valid.push_back(keys[way]); }
+        }
+        return valid;
+    }
+
+    uint64_t accesses = 0;
+    uint64_t hits = 0;
+
+  protected:
+    const unsigned assoc;
+    const unsigned num_sets;
+
+    std::vector<Addr> keys;
+    std::vector<uint64_t> stamps; // Last access, 0 for an empty way.
+    uint64_t clock = 0;
+};
+
+// The TLBs of a platform, per core: L1 ITLB and DTLB, a unified STLB (both optional), then a
+// page walk through the page-walk cache. A walk reads one entry per level of the page table
+// (PageTable), from the first level the page-walk cache does not skip down to the entry of the
+// page: for a 4kB page, a PD hit leaves only the PTE to read, a PDPT hit the PD and PTE, a PML4
+// hit three, a miss all four; a 2MB page stops at the PD, a 1GB page at the PDPT. Those
+// references go to the caches if the configuration says so (walk_refs_to_caches), see
+// Platforms.
+//
+// An entry of the TLBs holds a page of any size (the MMU decides, see SingleNode), the TLBs are
+// looked up with the size of the page.
+//
+// Walk cycles are estimated from the configuration: stlb_latency per STLB hit, walk_ref_latency
+// per walk reference.
+class TLBs
+{
+  public:
+    TLBs(Config &cfg)
+        : stlb_latency(cfg.stlb_latency),
+          walk_ref_latency(cfg.walk_ref_latency),
+          walk_refs_to_caches(cfg.walk_refs_to_caches)
+    {
+        assert(cfg.hasTLBs());
+        for (unsigned i = 0; i < cfg.num_cores; i++)
+        {
+            cores.emplace_back();
+            Core_TLBs &core = cores.back();
+            for (int lev = 0; lev < int(Config::TLB_Level::MAX_TLB); lev++)
+            {
+                const Config::TLB_Info &info = cfg.tlbs[lev];
+                core.tlbs.push_back(info.valid ? new TLB(info.entries, info.assoc) : nullptr);
+            }
+            for (int lev = 0; lev < int(Config::PWC_Level::MAX_PWC); lev++)
+            {
+                unsigned entries = cfg.pwc_entries[lev];
+                core.pwcs.push_back(entries > 0 ? new TLB(entries, entries) : nullptr);
+            }
+        }
+    }
+
+    ~TLBs()
+    {
+        for (auto &core : cores)
+        {
+            for (auto tlb : core.tlbs) { delete tlb; }
+            for (auto pwc : core.pwcs) { delete pwc; }
+        }
+    }
+
+    // Translation of a virtual page (already mapped by mmu) for an instruction fetch or a data
+    // access of a core. Returns the number of page-table references of the walk if there is one
+    // (0 otherwise), and their addresses in walk_addrs if they are to go to the caches.
+    unsigned translate(SingleNode &mmu, unsigned core_id, Addr virtual_page_id, bool instr,
+                       std::vector<Addr> &walk_addrs)
+    {
+        walk_addrs.clear();
+        Core_TLBs &core = cores[core_id];
+
+        unsigned leaf_level = mmu.pageLevel(core_id, virtual_page_id);
+        Addr key = pageKey(virtual_page_id, leaf_level);
+
+        TLB *l1 = core.tlbs[int(instr ? Config::TLB_Level::ITLB : Config::TLB_Level::DTLB)];
+        if (l1 != nullptr && l1->access(key)) { return 0; }
+
+        TLB *stlb = core.tlbs[int(Config::TLB_Level::STLB)];
+        if (stlb != nullptr && stlb->access(key))
+        {
+            stlb_hits++;
+            return 0;
+        }
+
+        // Deepest level the page-walk cache knows the node of (a level's entries are keyed
+        // by the bits of the virtual page number above it), filling all of them on the way.
+        unsigned first_level = 0;
+        for (unsigned lev = 0; lev < leaf_level && lev < unsigned(Config::PWC_Level::MAX_PWC);
+             lev++)
+        {
+            TLB *pwc = core.pwcs[lev];
+            if (pwc == nullptr) { continue; }
+
+            Addr node_key = virtual_page_id >> PageTable::pageShift(lev);
+            if (pwc->access(node_key)) { first_level = lev + 1; }
+        }
+
+        unsigned num_refs = leaf_level + 1 - first_level;
+        walks++;
+        walk_refs += num_refs;
+
+        Addr addrs[PageTable::num_levels];
+        if (walk_refs_to_caches && mmu.walkAddrs(core_id, virtual_page_id, addrs) != 0)
+        {
+            for (unsigned lev = first_level; lev <= leaf_level; lev++)
+            {
+                walk_addrs.push_back(addrs[lev]);
+            }
+        }
+        return num_refs;
+    }
+
+    void registerStats(Stats &stats)
+    {
+        const char *tlb_names[] = {"ITLB", "DTLB", "STLB"};
+        for (int lev = 0; lev < int(Config::TLB_Level::MAX_TLB); lev++)
+        {
+            registerTLB(stats, tlb_names[lev], lev, false);
+        }
+        const char *pwc_names[] = {"PWC-PML4", "PWC-PDPT", "PWC-PD"};
+        for (int lev = 0; lev < int(Config::PWC_Level::MAX_PWC); lev++)
+        {
+            registerTLB(stats, pwc_names[lev], lev, true);
+        }
+
+        stats.registerStats("Page walks: Number of walks = " + to_string(walks));
+        stats.registerStats("Page walks: Number of memory references = " +
+                            to_string(walk_refs));
+        stats.registerStats("Page walks: Estimated cycles (STLB hits and walks) = " +
+                            to_string(stlb_hits * stlb_latency + walk_refs * walk_ref_latency) +
+                            "\n");
+    }
+
+  protected:
+    const uint64_t stlb_latency;
+    const uint64_t walk_ref_latency;
+    const bool walk_refs_to_caches;
+
+    struct Core_TLBs
+    {
+        std::vector<TLB*> tlbs; // Config::TLB_Level, nullptr if absent.
+        std::vector<TLB*> pwcs; // Config::PWC_Level, nullptr if absent.
+    };
+    std::vector<Core_TLBs> cores;
+
+    uint64_t stlb_hits = 0;
+    uint64_t walks = 0;
+    uint64_t walk_refs = 0;
+
+    // TLB key of a page: its number in pages of its size, and the level of its entry in the top
+    // bits (the set is picked by the low bits).
+    static Addr pageKey(Addr virtual_page_id, unsigned leaf_level)
+    {
+        return (virtual_page_id >> PageTable::pageShift(leaf_level)) | (Addr(leaf_level) << 62);
+    }
+
+    // All cores together.
+    void registerTLB(Stats &stats, const std::string &name, int lev, bool pwc)
+    {
+        uint64_t accesses = 0, hits = 0, reach_kb = 0;
+        for (auto &core : cores)
+        {
+            TLB *tlb = pwc ? core.pwcs[lev] : core.tlbs[lev];
+            if (tlb == nullptr) { return; }
+            accesses += tlb->accesses;
+            hits += tlb->hits;
+
+            if (pwc) { continue; }
+            for (auto key : tlb->validKeys())
+            {
+                reach_kb += (Mapper::page_size / 1024) << PageTable::pageShift(key >> 62);
+            }
+        }
+
+        stats.registerStats(name + ": Number of accesses = " + to_string(accesses));
+        stats.registerStats(name + ": Number of hits = " + to_string(hits));
+        stats.registerStats(name + ": Number of misses = " + to_string(accesses - hits));
+        double hit_ratio = accesses == 0 ? 0 : double(hits) / double(accesses) * 100;
+        stats.registerStats(name + ": Hit ratio = " + to_string(hit_ratio) + "%");
+        if (!pwc)
+        {
+            stats.registerStats(name + ": Reach at the end (kB) = " + to_string(reach_kb));
+        }
+    }
+};
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef __LZ_CODEC_HH__
+#define __LZ_CODEC_HH__
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// A small LZ77 codec (byte-oriented, LZ4-style sequences) for trace output, so that the
+// pintools do not depend on zlib. Compressed output is organized in self-delimiting frames:
+//     Frame_Header { raw_bytes, stored_bytes }, stored_bytes of data
+// A frame decompresses to exactly raw_bytes, independently of every other frame, so readers
+// can locate the frames first and decompress them in parallel. A frame whose data did not
+// compress is stored as is (stored_bytes == raw_bytes).
+//
+// Sequence format: token (literal length << 4 | (match length - MIN_MATCH)), extra literal
+// length bytes (255 continues), literals, 2-byte little-endian offset, extra match length
+// bytes. The last sequence has literals only.
+namespace LZ
+{
+struct Frame_Header
+{
+    uint32_t raw_bytes = 0;
+    uint32_t stored_bytes = 0;
+};
+
+static const unsigned MIN_MATCH = 4;
+static const unsigned HASH_BITS = 14;
+static const uint32_t MAX_OFFSET = 65535;
+
+inline uint32_t read32(const uint8_t *pos)
+{
+    uint32_t val;
+    memcpy(&val, pos, sizeof(val));
+    return val;
+}
+
+inline uint32_t hash(uint32_t val) { return (val * 2654435761u) >> (32 - HASH_BITS); }
+
+inline void putLength(std::string &out, size_t len)
+{
+    while (len >= 255)
+    {
+        out.push_back(char(255));
+        len -= 255;
+    }
+    out.push_back(char(len));
+}
+
+inline void putSequence(std::string &out, const uint8_t *literals, size_t num_literals,
+                        uint32_t offset, size_t match_len)
+{
+    size_t match_code = match_len >= MIN_MATCH ? match_len - MIN_MATCH : 0;
+    uint8_t token = uint8_t((num_literals < 15 ? num_literals : 15) << 4 |
+                            (match_code < 15 ? match_code : 15));
+    out.push_back(char(token));
+    if (num_literals >= 15) { putLength(out, num_literals - 15); }
+    out.append(reinterpret_cast<const char*>(literals), num_literals);
+
+    if (match_len == 0) { return; } // Last sequence.
+    out.push_back(char(offset & 0xff));
+    out.push_back(char(offset >> 8));
+    if (match_code >= 15) { putLength(out, match_code - 15); }
+}
+
+// Compress size bytes of src, appending to out. table has 1 << HASH_BITS entries (kept off the
+// stack: the pintools run this on internal threads).
+inline void compress(const uint8_t *src, size_t size, std::string &out, uint32_t *table)
+{
+    memset(table, 0, sizeof(uint32_t) << HASH_BITS);
+
+    size_t anchor = 0; // Start of the pending literals.
+    size_t pos = 0;
+    // Leave room so that read32 never runs past the end.
+    size_t match_limit = size >= MIN_MATCH ? size - MIN_MATCH : 0;
+    while (pos < match_limit)
+    {
+        uint32_t cur = read32(src + pos);
+        uint32_t &slot = table[hash(cur)];
+        size_t cand = slot;
+        slot = uint32_t(pos);
+
+        if (cand >= pos || pos - cand > MAX_OFFSET || read32(src + cand) != cur)
+        {
+            pos++;
+            continue;
+        }
+
+        size_t match_len = MIN_MATCH;
+        while (pos + match_len < size && src[cand + match_len] == src[pos + match_len])
+        {
+            match_len++;
+        }
+
+        putSequence(out, src + anchor, pos - anchor, uint32_t(pos - cand), match_len);
+        pos += match_len;
+        anchor = pos;
+    }
+    putSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+// Decompress src into exactly raw_bytes at dst; false on malformed input.
+inline bool decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t raw_bytes)
+{
+    const uint8_t *end = src + size;
+    size_t out = 0;
+    while (src < end)
+    {
+        uint8_t token = *src++;
+
+        size_t num_literals = token >> 4;
+        if (num_literals == 15)
+        {
+            uint8_t byte;
+            do
+            {
+                if (src >= end) { return false; }
+                byte = *src++;
+                num_literals += byte;
+            } while (byte == 255);
+        }
+        if (size_t(end - src) < num_literals || raw_bytes - out < num_literals) { return false; }
+        memcpy(dst + out, src, num_literals);
+        src += num_literals;
+        out += num_literals;
+
+        if (src == end) { break; } // Last sequence.
+
+        if (end - src < 2) { return false; }
+        size_t offset = size_t(src[0]) | size_t(src[1]) << 8;
+        src += 2;
+
+        size_t match_len = (token & 0xf) + MIN_MATCH;
+        if ((token & 0xf) == 15)
+        {
+            uint8_t byte;
+            do
+            {
+                if (src >= end) { return false; }
+                byte = *src++;
+                match_len += byte;
+            } while (byte == 255);
+        }
+        if (offset == 0 || offset > out || raw_bytes - out < match_len) { return false; }
+
+        // Byte by byte, matches may overlap their own output.
+        for (size_t i = 0; i < match_len; i++, out++) { dst[out] = dst[out - offset]; }
+    }
+    return out == raw_bytes;
+}
+
+// Append one frame holding size bytes of src to out.
+inline void compressFrame(const uint8_t *src, size_t size, std::string &out, uint32_t *table)
+{
+    size_t header_pos = out.size();
+    out.append(sizeof(Frame_Header), '\0');
+    compress(src, size, out, table);
+
+    Frame_Header header;
+    header.raw_bytes = uint32_t(size);
+    header.stored_bytes = uint32_t(out.size() - header_pos - sizeof(Frame_Header));
+    if (header.stored_bytes >= header.raw_bytes)
+    {
+        out.resize(header_pos + sizeof(Frame_Header));
+        out.append(reinterpret_cast<const char*>(src), size);
+        header.stored_bytes = header.raw_bytes;
+    }
+    memcpy(&out[header_pos], &header, sizeof(header));
+}
+
+// Frame compressor with its own hash table.
+class Compressor
+{
+  public:
+    Compressor() : table(new uint32_t[1 << HASH_BITS]) {}
+    ~Compressor() { delete[] table; }
+
+    void compressFrame(const uint8_t *src, size_t size, std::string &out)
+    {
+        LZ::compressFrame(src, size, out, table);
+    }
+
+  private:
+    uint32_t *table;
+
+    Compressor(const Compressor&);
+    Compressor &operator=(const Compressor&);
+};
+
+inline bool decompressFrame(const Frame_Header &header, const uint8_t *data, uint8_t *dst)
+{
+    if (header.stored_bytes == header.raw_bytes)
+    {
+        memcpy(dst, data, header.raw_bytes);
+        return true;
+    }
+    return decompress(data, header.stored_bytes, dst, header.raw_bytes);
+}
+}
+
+#endif
@@ -0,0 +1,397 @@
+#ifndef __TRACE_FORMAT_HH__
+#define __TRACE_FORMAT_HH__
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lz_codec.hh"
+
+// Trace formats written by trace_extr and read back by the offline tools.
+//
+// Text: one event per line,
+//     tid count eip L|S addr
+//     tid count eip B taken
+// where count is the number of other (neither memory nor branch) instructions the thread
+// executed since its previous event.
+//
+// Binary (version 1):
+//     File_Header
+//     { Block_Header, payload } ...
+// A block holds num_records consecutive events of a single thread. Within a block, each record
+// is encoded as
+//     1 byte  : type (bits 0-1), taken (bit 2), count (bits 3-7, 31 = count follows)
+//     [varint : count, only if count >= 31]
+//     varint  : zigzag(eip - previous eip)
+//     [varint : zigzag(addr - previous addr), loads and stores only]
+// The previous eip/addr start from 0 in every block, so blocks decode independently.
+// trace_extr buffers each thread's events into its own blocks, so its binary traces keep the
+// order of the events across threads only at block granularity; trace_convert ends a block
+// whenever the thread changes, and keeps the order of a text trace.
+//
+// With FLAG_COMPRESSED, everything after the File_Header is a sequence of LZ frames (see
+// lz_codec.hh) that decompress to whole blocks, or to whole lines of the text format if
+// FLAG_TEXT is set as well.
+namespace Trace
+{
+enum class Type : uint8_t { LOAD = 0, STORE = 1, BRANCH = 2 };
+
+struct Record
+{
+    uint32_t tid = 0;
+    uint64_t count = 0;
+    uint64_t eip = 0;
+    Type type = Type::LOAD;
+    uint64_t addr = 0; // Loads and stores only.
+    bool taken = false; // Branches only.
+};
+
+static const uint32_t MAGIC = 0x52544c57; // "WLTR"
+static const uint16_t VERSION = 1;
+
+static const uint16_t FLAG_COMPRESSED = 1 << 0;
+static const uint16_t FLAG_TEXT = 1 << 1;
+
+struct File_Header
+{
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    uint16_t flags = 0;
+};
+
+struct Block_Header
+{
+    uint32_t tid = 0;
+    uint32_t num_records = 0;
+    uint32_t payload_bytes = 0;
+};
+
+static const uint64_t INLINE_COUNT_MAX = 31;
+
+inline void putVarint(std::string &out, uint64_t val)
+{
+    while (val >= 0x80)
+    {
+        out.push_back(char(uint8_t(val) | 0x80));
+        val >>= 7;
+    }
+    out.push_back(char(val));
+}
+
+// Returns the position after the varint, or nullptr if it runs past end.
+inline const uint8_t *getVarint(const uint8_t *pos, const uint8_t *end, uint64_t &val)
+{
+    val = 0;
+    for (unsigned shift = 0; pos < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *pos++;
+        val |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) { return pos; }
+    }
+    return nullptr;
+}
+
+inline uint64_t zigzag(uint64_t delta) { return (delta << 1) ^ -(delta >> 63); }
+inline uint64_t unzigzag(uint64_t val) { return (val >> 1) ^ -(val & 1); }
+
+// Encodes the events of one thread into a block.
+class Block_Encoder
+{
+  public:
+    void reset(uint32_t _tid)
+    {
+        tid = _tid;
+        num_records = 0;
+        prev_eip = 0;
+        prev_addr = 0;
+        payload.clear();
+    }
+
+    void append(const Record &record)
+    {
+        assert(record.tid == tid);
+
+        uint8_t head = uint8_t(record.type);
+        if (record.type == Type::BRANCH && record.taken) { head |= 1 << 2; }
+        head |= uint8_t(std::min(record.count, INLINE_COUNT_MAX) << 3);
+        payload.push_back(char(head));
+        if (record.count >= INLINE_COUNT_MAX) { putVarint(payload, record.count); }
+
+        putVarint(payload, zigzag(record.eip - prev_eip));
+        prev_eip = record.eip;
+
+        if (record.type != Type::BRANCH)
+        {
+            putVarint(payload, zigzag(record.addr - prev_addr));
+            prev_addr = record.addr;
+        }
+        num_records++;
+    }
+
+    uint32_t numRecords() const { return num_records; }
+
+    // Append the block (header and payload) to out.
+    void finish(std::string &out) const
+    {
+        Block_Header header;
+        header.tid = tid;
+        header.num_records = num_records;
+        header.payload_bytes = uint32_t(payload.size());
+        out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.append(payload);
+    }
+
+  private:
+    uint32_t tid = 0;
+    uint32_t num_records = 0;
+    uint64_t prev_eip = 0;
+    uint64_t prev_addr = 0;
+    std::string payload;
+};
+
+// Decodes a block payload; returns false on a malformed block.
+inline bool decodeBlock(const Block_Header &header, const uint8_t *payload,
+                        std::vector<Record> &records)
+{
+    const uint8_t *pos = payload;
+    const uint8_t *end = payload + header.payload_bytes;
+
+    uint64_t prev_eip = 0;
+    uint64_t prev_addr = 0;
+    records.resize(header.num_records);
+    for (auto &record : records)
+    {
+        if (pos >= end) { return false; }
+        uint8_t head = *pos++;
+
+        record.tid = header.tid;
+        record.type = Type(head & 0x3);
+        record.taken = head & (1 << 2);
+        record.count = head >> 3;
+        if (record.count == INLINE_COUNT_MAX &&
+            !(pos = getVarint(pos, end, record.count))) { return false; }
+
+        uint64_t delta;
+        if (!(pos = getVarint(pos, end, delta))) { return false; }
+        record.eip = prev_eip + unzigzag(delta);
+        prev_eip = record.eip;
+
+        record.addr = 0;
+        if (record.type != Type::BRANCH)
+        {
+            if (!(pos = getVarint(pos, end, delta))) { return false; }
+            record.addr = prev_addr + unzigzag(delta);
+            prev_addr = record.addr;
+        }
+    }
+    return pos == end;
+}
+
+inline void appendUInt(std::string &out, uint64_t val)
+{
+    char digits[20];
+    int len = 0;
+    do
+    {
+        digits[len++] = char('0' + val % 10);
+        val /= 10;
+    } while (val != 0);
+    while (len > 0) { out.push_back(digits[--len]); }
+}
+
+// Append the record as a line of the text format.
+inline void formatText(const Record &record, std::string &out)
+{
+    appendUInt(out, record.tid);
+    out.push_back(' ');
+    appendUInt(out, record.count);
+    out.push_back(' ');
+    appendUInt(out, record.eip);
+    switch (record.type)
+    {
+        case Type::LOAD: out.append(" L "); appendUInt(out, record.addr); break;
+        case Type::STORE: out.append(" S "); appendUInt(out, record.addr); break;
+        case Type::BRANCH: out.append(record.taken ? " B 1" : " B 0"); break;
+    }
+    out.push_back('\n');
+}
+
+// Parse a line of the text format; returns false if it is not an event line.
+inline bool parseText(const char *line, Record &record)
+{
+    char *pos;
+    record.tid = uint32_t(strtoul(line, &pos, 10));
+    if (pos == line) { return false; }
+    record.count = strtoull(pos, &pos, 10);
+    record.eip = strtoull(pos, &pos, 10);
+
+    while (*pos == ' ') { pos++; }
+    char type = *pos++;
+    uint64_t val = strtoull(pos, &pos, 10);
+    record.addr = 0;
+    record.taken = false;
+    switch (type)
+    {
+        case 'L': record.type = Type::LOAD; record.addr = val; return true;
+        case 'S': record.type = Type::STORE; record.addr = val; return true;
+        case 'B': record.type = Type::BRANCH; record.taken = val != 0; return true;
+    }
+    return false;
+}
+
+// Reads either format, telling them apart by the file header, compressed or not.
+class Reader
+{
+  public:
+    Reader(const std::string &fn)
+    {
+        file = fopen(fn.c_str(), "rb");
+        if (file == nullptr) { return; }
+
+        File_Header header;
+        if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == MAGIC)
+        {
+            valid = header.version == VERSION;
+            flags = header.flags;
+            binary = !(flags & FLAG_TEXT);
+            compressed = flags & FLAG_COMPRESSED;
+        }
+        else
+        {
+            rewind(file);
+            valid = true;
+        }
+    }
+
+    ~Reader()
+    {
+        if (file != nullptr) { fclose(file); }
+    }
+
+    bool isValid() const { return valid; }
+    bool isBinary() const { return binary; }
+    bool isCompressed() const { return compressed; }
+    uint16_t fileFlags() const { return flags; }
+
+    // Next event of the trace; false at the end (or on a malformed trace, see isValid()).
+    bool next(Record &record)
+    {
+        if (!valid) { return false; }
+        if (!binary) { return nextText(record); }
+
+        while (cur == records.size())
+        {
+            if (!nextBlock(records)) { return false; }
+            cur = 0;
+        }
+        record = records[cur++];
+        return true;
+    }
+
+    // The next binary block as a whole.
+    bool nextBlock(std::vector<Record> &block)
+    {
+        if (!valid) { return false; }
+
+        Block_Header header;
+        const uint8_t *data;
+        if (compressed)
+        {
+            if (frame_pos == frame_end && !nextFrame()) { return false; }
+            if (frame_end - frame_pos < sizeof(header)) { return invalid(); }
+            memcpy(&header, &frame[frame_pos], sizeof(header));
+            frame_pos += sizeof(header);
+
+            if (frame_end - frame_pos < header.payload_bytes) { return invalid(); }
+            data = &frame[frame_pos];
+            frame_pos += header.payload_bytes;
+        }
+        else
+        {
+            if (fread(&header, sizeof(header), 1, file) != 1) { return false; }
+
+            payload.resize(header.payload_bytes);
+            if (fread(&payload[0], 1, payload.size(), file) != payload.size())
+            {
+                return invalid();
+            }
+            data = &payload[0];
+        }
+
+        if (!decodeBlock(header, data, block)) { return invalid(); }
+        return true;
+    }
+
+  private:
+    bool invalid()
+    {
+        valid = false;
+        return false;
+    }
+
+    // Decompress the next frame into frame (followed by a '\0' for the text parser).
+    bool nextFrame()
+    {
+        LZ::Frame_Header header;
+        if (fread(&header, sizeof(header), 1, file) != 1) { return false; }
+
+        payload.resize(header.stored_bytes);
+        frame.resize(header.raw_bytes + 1);
+        if (fread(&payload[0], 1, payload.size(), file) != payload.size() ||
+            !LZ::decompressFrame(header, &payload[0], &frame[0]))
+        {
+            return invalid();
+        }
+        frame[header.raw_bytes] = '\0';
+        frame_end = header.raw_bytes;
+        frame_pos = 0;
+        return true;
+    }
+
+    bool nextText(Record &record)
+    {
+        if (!compressed)
+        {
+            while (fgets(line, sizeof(line), file) != nullptr)
+            {
+                if (parseText(line, record)) { return true; }
+            }
+            return false;
+        }
+
+        while (true)
+        {
+            if (frame_pos == frame_end && !nextFrame()) { return false; }
+
+            // Frames hold whole lines, and the byte after the frame is a '\0'.
+            const char *line_begin = reinterpret_cast<const char*>(&frame[frame_pos]);
+            const void *line_end = memchr(line_begin, '\n', frame_end - frame_pos);
+            frame_pos = line_end ? static_cast<const uint8_t*>(line_end) - &frame[0] + 1
+                                 : frame_end;
+            if (parseText(line_begin, record)) { return true; }
+        }
+    }
+
+    FILE *file = nullptr;
+    bool valid = false;
+    bool binary = false;
+    bool compressed = false;
+    uint16_t flags = 0;
+
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> frame;
+    size_t frame_pos = 0;
+    size_t frame_end = 0;
+    std::vector<Record> records;
+    size_t cur = 0;
+
+    char line[256];
+};
+}
+
+#endif
@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Error of the SHARDS-sampled miss-ratio curves of test_app against the exact ones, at a few
+# fixed rates and fixed sizes. test_app is traced once, the trace is then replayed offline
+# (trace_tools/replay) for every setting.
+#
+# Usage (from Workload_Char): ./test_apps/mrc_error.bash [config] [level] [sets]
+
+CFG=${1:-configs/skylake.cfg}
+LEVEL=${2:-L1D}
+SETS=${3:-1,64}
+PIN=../../../pin
+TRACE=/tmp/mrc_error.trace
+
+make obj-intel64/trace_extr.so
+make -C trace_tools/
+make -C test_apps/
+
+# -s 1: trace from the start of the ROI (the default skips its first 1B instructions, more
+# than test_app has).
+$PIN -t obj-intel64/trace_extr.so -o $TRACE -s 1 -- test_apps/test_app > /dev/null
+
+run()
+{
+    trace_tools/replay -c $CFG -s /tmp/mrc_error.stats -bp none \
+        -mrc /tmp/mrc_error.mrc -mrc_sets $SETS -mrc_level $LEVEL -mrc_check 1 "$@" \
+        $TRACE > /dev/null
+    echo "$@"
+    grep "Mean absolute error" /tmp/mrc_error.mrc
+}
+
+for rate in 0.1 0.01 0.001; do
+    run -mrc_rate $rate
+done
+
+for lines in 8192 2048 512; do
+    run -mrc_max_lines $lines
+done
+
+make clean -C test_apps/
@@ -0,0 +1,41 @@
+#!/bin/bash
+
+# Slowdown of wl_char_roi over native execution of test_app, with the original
+# per-instruction instruction counter (-count_mode ins) and the per-basic-block
+# counter (-count_mode bbl).
+#
+# Usage (from Workload_Char): ./test_apps/slowdown.bash [config] [runs]
+
+CFG=${1:-configs/skylake.cfg}
+RUNS=${2:-3}
+PIN=../../../pin
+TOOL=obj-intel64/wl_char_roi.so
+
+make obj-intel64/wl_char_roi.so
+make -C test_apps/
+
+# Average wall-clock seconds of RUNS executions of "$@".
+time_it()
+{
+    local start end
+    start=$(date +%s.%N)
+    for ((i = 0; i < RUNS; i++)); do
+        "$@" > /dev/null
+    done
+    end=$(date +%s.%N)
+    echo "($end - $start) / $RUNS" | bc -l
+}
+
+native=$(time_it test_apps/test_app)
+printf "%-10s %10.3fs\n" "native" "$native"
+
+for mode in ins bbl; do
+    t=$(time_it $PIN -t $TOOL -c $CFG -s /tmp/slowdown_$mode.stats -count_mode $mode \
+        -- test_apps/test_app)
+    printf "%-10s %10.3fs %8.1fx\n" "$mode" "$t" "$(echo "$t / $native" | bc -l)"
+done
+
+# Both modes should report the same count (up to a basic block at each ROI edge).
+grep "Number of instructions" /tmp/slowdown_ins.stats /tmp/slowdown_bbl.stats
+
+make clean -C test_apps/
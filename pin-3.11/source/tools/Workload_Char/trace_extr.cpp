@@ -9,10 +9,12 @@
 #include <sys/stat.h>
 
 // Data trace output
-using std::ofstream;
-ofstream trace_out;
+#include "include/Pin/output_stream.hh"
+static Output_Stream trace_out;
 KNOB<std::string> TraceOut(KNOB_MODE_WRITEONCE, "pintool",
     "o", "", "specify output trace file name");
+KNOB<BOOL> CompressTrace(KNOB_MODE_WRITEONCE, "pintool",
+    "z", "0", "compress the trace output");
 
 KNOB<uint64_t> NumInstrsToSkip(KNOB_MODE_WRITEONCE, "pintool",
     "s", "", "number of instructions to skip before extraction");
@@ -40,21 +42,36 @@ PIN_LOCK pinLock;
 static const uint64_t LIMIT = 1000000000; // Maximum of instructions (all threads) 
                                           // to be extracted.
 static uint64_t insn_count = 0; // Track how many instructions we have already instrumented.
-static void increCount(THREADID t_id) 
+
+// Instrumentation versions. Outside the ROI only the magic ops are instrumented; while
+// skipping the first roi_skippings instructions of the ROI only the instruction counter is;
+// the extraction version carries the full tracing. See include/Pin/fast_forward.hh.
+#include "include/Pin/fast_forward.hh"
+enum Version : ADDRINT
+{
+    VERSION_FAST_FORWARD = FastForward::DEFAULT_VERSION,
+    VERSION_SKIP,
+    VERSION_EXTRACT,
+    NUM_VERSIONS
+};
+
+// Instructions are counted once per basic block into per-thread counters; a thread folds its
+// count into insn_count (under pinLock) every COUNT_QUANTUM instructions, or earlier when it
+// could reach the end of the skipping or the LIMIT.
+static const uint64_t COUNT_QUANTUM = 1 << 16;
+static void PIN_FAST_ANALYSIS_CALL foldCount(THREADID t_id)
 {
     // When entered into ROI, skip the first 1 billion of instructions then extract the next 
     // 1 billion of instructions.
-
-    if (!entering_roi) { return; }
-
     PIN_GetLock(&pinLock, t_id + 1);
 
+    uint64_t prev_count = insn_count;
+    insn_count += FastForward::takeCount(t_id);
+
     if (fast_forwarding)
     {
         // Entered into ROI but still in fast-forwarding mode.
-        ++insn_count;
-
-        if (insn_count % (LIMIT / 2) == 0)
+        if (insn_count / (LIMIT / 2) != prev_count / (LIMIT / 2))
         {
              std::cerr << "[PINTOOL] Skipping instructions " << insn_count << std::endl;
         }
@@ -62,125 +79,231 @@ static void increCount(THREADID t_id)
         {
             insn_count = 0;
             fast_forwarding = false;
+            FastForward::setVersion(VERSION_EXTRACT);
             std::cerr << "[PINTOOL] Begin trace extraction." << std::endl;
             std::cerr << "[PINTOOL] Instruction count is set to " << insn_count
                       << std::endl;
         }
-        PIN_ReleaseLock(&pinLock); // Release the lock before exiting.
-        return;
     }
-
-    assert(entering_roi == true);
-    assert(fast_forwarding == false);
-    ++insn_count; // Increment
     // Exit if it exceeds a threshold.
-    if (insn_count >= LIMIT)
+    else if (insn_count >= LIMIT)
     {
         // std::cerr << "Done trace extraction." << std::endl;
         std::cerr << "[PINTOOL] End trace extraction." << std::endl;
         std::cerr << "[PINTOOL] Instruction count is reached " << insn_count
                   << std::endl;
-        trace_out << std::flush;
-	trace_out.close();
-        exit(0);
-        // PIN_ExitApplication(0);
+        // Fini() flushes the trace once the writers have drained the buffers.
+        PIN_ReleaseLock(&pinLock);
+        PIN_ExitApplication(0);
     }
 
+    uint64_t until_event = (fast_forwarding ? roi_skippings : LIMIT) - insn_count;
+    FastForward::checkAgainIn(t_id, std::min(COUNT_QUANTUM, until_event));
+
     PIN_ReleaseLock(&pinLock);
 }
 
-// Thread local data
-class thread_data_t
+// Trace records are filled inline into per-thread buffers (PIN_DefineTraceBuffer) and
+// written out by internal writer threads, see BufferFull() and writerThread(). A thread's
+// buffers always go to the same writer, so that its records stay in order.
+KNOB<std::string> TraceFormat(KNOB_MODE_WRITEONCE, "pintool",
+    "f", "text", "trace format: text or bin");
+static bool binary_trace = false;
+#include "include/Trace/trace_format.hh"
+
+KNOB<UINT32> NumWriters(KNOB_MODE_WRITEONCE, "pintool",
+    "writers", "2", "number of trace writer threads");
+KNOB<UINT32> NumPagesInBuffer(KNOB_MODE_WRITEONCE, "pintool",
+    "buffer_pages", "256", "number of (4KB) pages in a trace buffer");
+KNOB<UINT32> NumBuffersPerThread(KNOB_MODE_WRITEONCE, "pintool",
+    "buffers_per_thread", "3", "number of trace buffers per application thread");
+
+enum Record_Type : UINT32 { LOAD, STORE, BRANCH_TAKEN, BRANCH_NOT_TAKEN };
+struct Trace_Record
+{
+    ADDRINT eip;
+    ADDRINT addr; // Memory address (LOAD/STORE only).
+    ADDRINT others; // others_reg at the record, see below.
+    UINT32 others_after; // Non-memory, non-branch instructions of the basic block
+                         // after this one.
+    UINT32 type;
+};
+static BUFFER_ID buf_id;
+
+// Per-thread count of the instructions that are neither memory accesses nor branches, kept in
+// a tool register. It is advanced by a whole basic block at the block's head, so the count at
+// a record is others - others_after.
+static REG others_reg;
+static ADDRINT PIN_FAST_ANALYSIS_CALL addOthers(ADDRINT others, UINT32 num_others)
 {
-  public:
-    thread_data_t() {}
+    return others + num_others;
+}
+
+#include "include/Pin/buffer_queue.hh"
+struct Thread_Buffers;
+struct Full_Buffer
+{
+    VOID *buf;
+    UINT64 num_records;
+    THREADID t_id;
+    ADDRINT prev_others; // Count at the last record of the thread's previous buffer.
+    Thread_Buffers *owner;
+};
 
-    unsigned num_exes_before_mem_or_bra = 0;
+// Thread local data
+struct Thread_Buffers
+{
+    Buffer_Queue<VOID*> free_bufs;
+    UINT32 num_allocated = 1; // Pin allocates the first one.
+    VOID *cur_buf = NULL;
+    ADDRINT last_others = 0;
 };
 
 static TLS_KEY tls_key = INVALID_TLS_KEY;
 
-INT32 numThreads = 0;
-VOID ThreadStart(THREADID threadid, CONTEXT *ctxt, INT32 flags, VOID *v)
+static std::vector<Buffer_Queue<Full_Buffer>*> writer_queues;
+static std::vector<PIN_THREAD_UID> writer_uids;
+
+// Format a full buffer as text lines (tid count eip L|S addr, or tid count eip B taken), or
+// as one binary block, see include/Trace/trace_format.hh.
+static void writeBuffer(const Full_Buffer &full, std::string &out, THREADID writer_id)
 {
-    numThreads++;
-    thread_data_t* tdata = new thread_data_t;
-    if (PIN_SetThreadData(tls_key, tdata, threadid) == FALSE)
+    out.clear();
+
+    Trace::Block_Encoder block;
+    block.reset(full.t_id);
+
+    Trace::Record event;
+    event.tid = full.t_id;
+
+    ADDRINT prev_others = full.prev_others;
+    const Trace_Record *records = static_cast<const Trace_Record*>(full.buf);
+    for (UINT64 i = 0; i < full.num_records; i++)
     {
-        std::cerr << "PIN_SetThreadData failed" << std::endl;
-        PIN_ExitProcess(1);
+        const Trace_Record &record = records[i];
+        ADDRINT others = record.others - record.others_after;
+
+        event.count = others - prev_others;
+        event.eip = record.eip;
+        event.addr = record.addr;
+        switch (record.type)
+        {
+            case LOAD: event.type = Trace::Type::LOAD; break;
+            case STORE: event.type = Trace::Type::STORE; break;
+            default: event.type = Trace::Type::BRANCH; break;
+        }
+        event.taken = record.type == BRANCH_TAKEN;
+
+        if (binary_trace) { block.append(event); }
+        else { Trace::formatText(event, out); }
+
+        prev_others = others;
     }
-}
+    if (binary_trace) { block.finish(out); }
 
-VOID ThreadFini(THREADID threadIndex, const CONTEXT *ctxt, INT32 code, VOID *v)
-{
-    thread_data_t* tdata = static_cast<thread_data_t*>(PIN_GetThreadData(tls_key, threadIndex));
-    delete tdata;
+    trace_out.write(out, writer_id);
 }
 
-static void nonBranchNorMem(THREADID t_id)
+static VOID writerThread(VOID *arg)
 {
-    if (fast_forwarding) { return; }
-
-    thread_data_t* t_data = static_cast<thread_data_t*>(PIN_GetThreadData(tls_key, t_id));
+    Buffer_Queue<Full_Buffer> *queue = static_cast<Buffer_Queue<Full_Buffer>*>(arg);
+    THREADID writer_id = PIN_ThreadId();
 
-    // Only increment thread data.
-    ++(t_data->num_exes_before_mem_or_bra);
+    std::string out;
+    Full_Buffer full;
+    while (queue->pop(full, writer_id))
+    {
+        writeBuffer(full, out, writer_id);
+        full.owner->free_bufs.push(full.buf, writer_id);
+    }
+    PIN_ExitThread(0);
 }
 
-#include "include/Sim/util.hh"
-static void bpTrace(THREADID t_id,
-                    ADDRINT eip,
-		    BOOL taken,
-                    ADDRINT target)
+// Called in the application thread when its buffer is full, or when the thread exits.
+static VOID *BufferFull(BUFFER_ID id, THREADID t_id, const CONTEXT *ctxt, VOID *buf,
+                        UINT64 num_records, VOID *v)
 {
-    if (fast_forwarding) { return; }
+    Thread_Buffers *t_bufs = static_cast<Thread_Buffers*>(PIN_GetThreadData(tls_key, t_id));
+    t_bufs->cur_buf = buf;
+    if (num_records == 0) { return buf; }
+
+    Full_Buffer full;
+    full.buf = buf;
+    full.num_records = num_records;
+    full.t_id = t_id;
+    full.prev_others = t_bufs->last_others;
+    full.owner = t_bufs;
+
+    const Trace_Record &last = static_cast<const Trace_Record*>(buf)[num_records - 1];
+    t_bufs->last_others = last.others - last.others_after;
+
+    Buffer_Queue<Full_Buffer> *queue = writer_queues[t_id % writer_queues.size()];
+    if (!queue->push(full, t_id))
+    {
+        // The writers are gone (process exit), write it out from this thread.
+        std::string out;
+        writeBuffer(full, out, t_id);
+        return buf;
+    }
 
-    thread_data_t* t_data = static_cast<thread_data_t*>(PIN_GetThreadData(tls_key, t_id));
+    if (t_bufs->num_allocated < NumBuffersPerThread.Value())
+    {
+        t_bufs->num_allocated++;
+        t_bufs->cur_buf = PIN_AllocateBuffer(buf_id);
+        return t_bufs->cur_buf;
+    }
 
-    // Lock the print out
-    PIN_GetLock(&pinLock, t_id + 1);
+    // Wait until a writer hands one of the thread's buffers back.
+    t_bufs->free_bufs.pop(t_bufs->cur_buf, t_id);
+    return t_bufs->cur_buf;
+}
 
-    trace_out << t_id << " "
-              << t_data->num_exes_before_mem_or_bra << " "
-              << eip << " "
-              << "B "
-              << taken << std::endl;
+INT32 numThreads = 0;
+VOID ThreadStart(THREADID threadid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    numThreads++;
+    PIN_SetContextReg(ctxt, others_reg, 0);
 
-    PIN_ReleaseLock(&pinLock);
-    
-    t_data->num_exes_before_mem_or_bra = 0;
+    Thread_Buffers* tdata = new Thread_Buffers;
+    if (PIN_SetThreadData(tls_key, tdata, threadid) == FALSE)
+    {
+        std::cerr << "PIN_SetThreadData failed" << std::endl;
+        PIN_ExitProcess(1);
+    }
 }
 
-static void memTrace(THREADID t_id,
-                     ADDRINT eip,
-                     bool is_store,
-                     ADDRINT mem_addr,
-                     UINT32 payload_size)
+VOID ThreadFini(THREADID threadIndex, const CONTEXT *ctxt, INT32 code, VOID *v)
 {
-    if (fast_forwarding) { return; }
-
-    thread_data_t* t_data = static_cast<thread_data_t*>(PIN_GetThreadData(tls_key, t_id));
-    
-    // Lock the print out
-    PIN_GetLock(&pinLock, t_id + 1);
+    Thread_Buffers* tdata = static_cast<Thread_Buffers*>(PIN_GetThreadData(tls_key, threadIndex));
 
-    trace_out << t_id << " "
-              << t_data->num_exes_before_mem_or_bra << " "
-              << eip << " ";
-    if (is_store)
+    // Wait for the thread's other buffers to come back from the writers.
+    for (UINT32 i = 1; i < tdata->num_allocated; i++)
     {
-        trace_out << "S ";
+        VOID *buf = NULL;
+        tdata->free_bufs.pop(buf, threadIndex);
+        PIN_DeallocateBuffer(buf_id, buf);
     }
-    else
+    if (tdata->cur_buf != NULL) { PIN_DeallocateBuffer(buf_id, tdata->cur_buf); }
+    delete tdata;
+    PIN_SetThreadData(tls_key, NULL, threadIndex);
+}
+
+// Let the writers drain their queues before the application threads are torn down.
+static VOID PrepareForFini(VOID *v)
+{
+    THREADID t_id = PIN_ThreadId();
+    for (auto queue : writer_queues) { queue->close(t_id); }
+    for (auto uid : writer_uids)
     {
-        trace_out << "L ";
+        INT32 exit_code;
+        PIN_WaitForThreadTermination(uid, PIN_INFINITE_TIMEOUT, &exit_code);
     }
-    trace_out << mem_addr << std::endl;
+    trace_out.stop(t_id);
+}
 
-    PIN_ReleaseLock(&pinLock);
-    
-    t_data->num_exes_before_mem_or_bra = 0;
+VOID Fini(INT32 code, VOID *v)
+{
+    trace_out.close(PIN_ThreadId());
 }
 
 #define ROI_BEGIN    (1025)
@@ -192,23 +315,75 @@ void HandleMagicOp(THREADID t_id, ADDRINT op)
         case ROI_BEGIN:
             PIN_GetLock(&pinLock, t_id + 1);
             entering_roi = true;
+            FastForward::setVersion(fast_forwarding ? VERSION_SKIP : VERSION_EXTRACT);
             PIN_ReleaseLock(&pinLock);
             // std::cout << "Captured roi_begin() \n";
             return;
         case ROI_END:
             PIN_GetLock(&pinLock, t_id + 1);
             entering_roi = false;
+            FastForward::setVersion(VERSION_FAST_FORWARD);
             PIN_ReleaseLock(&pinLock);
             // std::cout << "Captured roi_end() \n";
             return;
     }
 }
 
-// "Main" function: decode and simulate the instruction
-static void instructionSim(INS ins)
+static bool isOther(INS ins)
+{
+    return !(INS_IsMemoryRead(ins) || INS_IsMemoryWrite(ins)) &&
+           !(INS_IsBranch(ins) && INS_HasFallThrough(ins)) &&
+           !(INS_IsXchg(ins) &&
+             INS_OperandReg(ins, 0) == REG_RCX &&
+             INS_OperandReg(ins, 1) == REG_RCX);
+}
+
+static void fillRecord(INS ins, IPOINT action, Record_Type type, UINT32 others_after,
+                       UINT32 mem_op = 0)
+{
+    if (type == LOAD || type == STORE)
+    {
+        // For conditional move, the memory access is only executed when predicated true.
+        INS_InsertFillBufferPredicated(ins, action, buf_id,
+            IARG_INST_PTR, offsetof(Trace_Record, eip),
+            IARG_MEMORYOP_EA, mem_op, offsetof(Trace_Record, addr),
+            IARG_REG_VALUE, others_reg, offsetof(Trace_Record, others),
+            IARG_UINT32, others_after, offsetof(Trace_Record, others_after),
+            IARG_UINT32, type, offsetof(Trace_Record, type),
+            IARG_END);
+    }
+    else
+    {
+        INS_InsertFillBuffer(ins, action, buf_id,
+            IARG_INST_PTR, offsetof(Trace_Record, eip),
+            IARG_REG_VALUE, others_reg, offsetof(Trace_Record, others),
+            IARG_UINT32, others_after, offsetof(Trace_Record, others_after),
+            IARG_UINT32, type, offsetof(Trace_Record, type),
+            IARG_END);
+    }
+}
+
+// "Main" function: decode and simulate the instruction. Without extract, only the magic ops
+// are instrumented.
+static void instructionSim(INS ins, bool extract, UINT32 others_after)
 {
-    // Count number of instructions.
-    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)increCount, IARG_THREAD_ID, IARG_END);
+    // Instruction count is incremented per basic block, see traceCallback().
+
+    if (INS_IsXchg(ins) &&
+        INS_OperandReg(ins, 0) == REG_RCX &&
+        INS_OperandReg(ins, 1) == REG_RCX)
+    {
+        INS_InsertCall(
+            ins,
+            IPOINT_BEFORE,
+            (AFUNPTR) HandleMagicOp,
+            IARG_THREAD_ID,
+            IARG_REG_VALUE, REG_ECX,
+            IARG_END);
+        return;
+    }
+
+    if (!extract) { return; }
 
     if (INS_IsMemoryRead (ins) || INS_IsMemoryWrite (ins))
     {
@@ -216,91 +391,64 @@ static void instructionSim(INS ins)
         {
             if (INS_MemoryOperandIsRead(ins, i))
             {
-                INS_InsertPredicatedCall(
-                    ins,
-                    IPOINT_BEFORE,
-                    (AFUNPTR)memTrace,
-		    IARG_THREAD_ID,
-                    IARG_ADDRINT, INS_Address(ins),
-                    IARG_BOOL, FALSE,
-                    IARG_MEMORYOP_EA, i,
-                    IARG_UINT32, INS_MemoryOperandSize(ins, i),
-                    IARG_END);
+                fillRecord(ins, IPOINT_BEFORE, LOAD, others_after, i);
             }
 
             if (INS_MemoryOperandIsWritten(ins, i))
             {
-                INS_InsertPredicatedCall(
-                    ins,
-                    IPOINT_BEFORE,
-                    (AFUNPTR)memTrace,
-		    IARG_THREAD_ID,
-                    IARG_ADDRINT, INS_Address(ins),
-                    IARG_BOOL, TRUE,
-                    IARG_MEMORYOP_EA, i,
-                    IARG_UINT32, INS_MemoryOperandSize(ins, i),
-                    IARG_END);
+                fillRecord(ins, IPOINT_BEFORE, STORE, others_after, i);
             }
         }
     }
     else if (INS_IsBranch(ins) && INS_HasFallThrough(ins))
     {
-        // Why two calls for a branch?
+        // Why two records for a branch?
         // A branch has two path: a taken path and a fall-through path.
-        INS_InsertCall(
-            ins,
-            IPOINT_TAKEN_BRANCH, // Insert a call on the taken edge 
-                                 // of the control-flow instruction
-            (AFUNPTR)bpTrace,
-            IARG_THREAD_ID,
-            IARG_ADDRINT, INS_Address(ins),
-            IARG_BOOL, TRUE,
-            IARG_BRANCH_TARGET_ADDR,
-            IARG_END);
-
-        INS_InsertCall(
-            ins,
-            IPOINT_AFTER, // Insert a call on the fall-through path of 
-                          // the last instruction of the instrumented object
-            (AFUNPTR)bpTrace,
-            IARG_THREAD_ID,
-            IARG_ADDRINT, INS_Address(ins),
-            IARG_BOOL, FALSE,
-            IARG_BRANCH_TARGET_ADDR,
-            IARG_END);
-    }
-    else if (INS_IsXchg(ins) &&
-             INS_OperandReg(ins, 0) == REG_RCX &&
-             INS_OperandReg(ins, 1) == REG_RCX)
-    {
-        INS_InsertCall(
-            ins,
-            IPOINT_BEFORE,
-            (AFUNPTR) HandleMagicOp,
-            IARG_THREAD_ID,
-            IARG_REG_VALUE, REG_ECX,
-            IARG_END);
-    }
-    else
-    {
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)nonBranchNorMem, IARG_THREAD_ID, IARG_END);
+        fillRecord(ins, IPOINT_TAKEN_BRANCH, BRANCH_TAKEN, others_after);
+        fillRecord(ins, IPOINT_AFTER, BRANCH_NOT_TAKEN, others_after);
     }
 }
 
 static void traceCallback(TRACE trace, VOID *v)
 {
+    ADDRINT version = TRACE_Version(trace);
+
     BBL bbl_head = TRACE_BblHead(trace);
 
     for (BBL bbl = bbl_head; BBL_Valid(bbl); bbl = BBL_Next(bbl))
     {
+        // Count the whole basic block once, at its first instruction.
+        if (version != VERSION_FAST_FORWARD)
+        {
+            FastForward::insertCount(bbl, (AFUNPTR)foldCount);
+        }
+
+        UINT32 others_after = 0;
+        if (version == VERSION_EXTRACT)
+        {
+            for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins))
+            {
+                if (isOther(ins)) { others_after++; }
+            }
+            INS_InsertCall(BBL_InsHead(bbl), IPOINT_BEFORE, (AFUNPTR)addOthers,
+                           IARG_FAST_ANALYSIS_CALL,
+                           IARG_REG_VALUE, others_reg,
+                           IARG_UINT32, others_after,
+                           IARG_RETURN_REGS, others_reg,
+                           IARG_END);
+        }
+
         for(INS ins = BBL_InsHead(bbl); ; ins = INS_Next(ins))
         {
-            instructionSim(ins);
+            if (isOther(ins)) { others_after--; }
+            instructionSim(ins, version == VERSION_EXTRACT, others_after);
             if (ins == BBL_InsTail(bbl))
             {
                 break;
             }
         }
+
+        FastForward::insertVersionSwitch(trace, bbl);
     }
 }
 
@@ -325,7 +473,40 @@ main(int argc, char *argv[])
     }
     assert(!TraceOut.Value().empty());
 
-    trace_out.open(TraceOut.Value().c_str());
+    FastForward::init(NUM_VERSIONS);
+
+    others_reg = PIN_ClaimToolRegister();
+    if (!REG_valid(others_reg))
+    {
+        std::cerr << "[PINTOOL] Cannot allocate a scratch register." << std::endl;
+        PIN_ExitProcess(1);
+    }
+
+    buf_id = PIN_DefineTraceBuffer(sizeof(Trace_Record), NumPagesInBuffer.Value(),
+                                   BufferFull, 0);
+    if (buf_id == BUFFER_ID_INVALID)
+    {
+        std::cerr << "[PINTOOL] Error: could not allocate initial buffer." << std::endl;
+        PIN_ExitProcess(1);
+    }
+
+    assert(TraceFormat.Value() == "text" || TraceFormat.Value() == "bin");
+    binary_trace = TraceFormat.Value() == "bin";
+
+    // Plain text traces have no file header.
+    std::string file_header;
+    if (binary_trace || CompressTrace.Value())
+    {
+        Trace::File_Header header;
+        if (CompressTrace.Value()) { header.flags |= Trace::FLAG_COMPRESSED; }
+        if (!binary_trace) { header.flags |= Trace::FLAG_TEXT; }
+        file_header.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    if (!trace_out.open(TraceOut.Value(), CompressTrace.Value(), file_header))
+    {
+        std::cerr << "[PINTOOL] Error: could not open the trace output." << std::endl;
+        PIN_ExitProcess(1);
+    }
 
     if (NumInstrsToSkip.Value() == 0)
     {
@@ -338,12 +519,31 @@ main(int argc, char *argv[])
     // std::cerr << roi_skippings << std::endl;
     // exit(0);
 
+    // Writer threads
+    assert(NumWriters.Value() > 0);
+    for (UINT32 i = 0; i < NumWriters.Value(); i++)
+    {
+        writer_queues.emplace_back(new Buffer_Queue<Full_Buffer>);
+
+        PIN_THREAD_UID uid;
+        if (PIN_SpawnInternalThread(writerThread, writer_queues[i], 0, &uid)
+            == INVALID_THREADID)
+        {
+            std::cerr << "[PINTOOL] Error: could not spawn a writer thread." << std::endl;
+            PIN_ExitProcess(1);
+        }
+        writer_uids.push_back(uid);
+    }
+
     // Register ThreadStart to be called when a thread starts.
     PIN_AddThreadStartFunction(ThreadStart, NULL);
 
     // Register Fini to be called when thread exits.
     PIN_AddThreadFiniFunction(ThreadFini, NULL);
 
+    PIN_AddPrepareForFiniFunction(PrepareForFini, NULL);
+    PIN_AddFiniFunction(Fini, NULL);
+
     PIN_AddFollowChildProcessFunction(FollowChild, 0);
 
     // RTN_AddInstrumentFunction(routineCallback, 0);
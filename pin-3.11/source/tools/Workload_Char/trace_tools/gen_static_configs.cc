@@ -0,0 +1,140 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/Sim/config.hh"
+
+// Writes the compile-time hierarchies (include/CacheSim/static_hierarchy.hh) of configuration
+// files to a header, along with createStaticHierarchy(), which returns the one matching a
+// Config (nullptr if none does, the caller then builds the run-time Hierarchy). Configurations
+// the packed tags cannot hold (more than 64 ways, a number of sets that is not a power of two)
+// are left to the run-time hierarchy too.
+//
+// Usage: gen_static_configs <output header> <config> [<config> ...]
+//     make static_configs regenerates include/CacheSim/static_configs.hh from ../configs.
+
+// "configs/cortex-a76.cfg" -> "Cortex_A76_Config"
+static std::string typeName(const std::string &cfg_file)
+{
+    size_t begin = cfg_file.find_last_of('/');
+    begin = begin == std::string::npos ? 0 : begin + 1;
+    size_t end = cfg_file.find_last_of('.');
+    end = end == std::string::npos || end < begin ? cfg_file.size() : end;
+
+    std::string name;
+    bool word_start = true;
+    for (size_t i = begin; i < end; i++)
+    {
+        char c = cfg_file[i];
+        if (!isalnum(c))
+        {
+            name += '_';
+            word_start = true;
+            continue;
+        }
+        name += word_start ? toupper(c) : c;
+        word_start = false;
+    }
+    return name + "_Config";
+}
+
+static bool isPowerOfTwo(uint64_t x) { return x != 0 && (x & (x - 1)) == 0; }
+
+static bool supported(Config &cfg, std::string &reason)
+{
+    if (!isPowerOfTwo(cfg.block_size))
+    {
+        reason = "block size is not a power of two";
+        return false;
+    }
+    for (auto &info : cfg.caches)
+    {
+        if (!info.valid) { continue; }
+        if (info.assoc <= 0 || info.assoc > 64)
+        {
+            reason = "more than 64 ways";
+            return false;
+        }
+        uint64_t bytes = uint64_t(info.size) * 1024;
+        if (bytes % (uint64_t(cfg.block_size) * info.assoc) != 0 ||
+            !isPowerOfTwo(bytes / (uint64_t(cfg.block_size) * info.assoc)))
+        {
+            reason = "number of sets is not a power of two";
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string level(Config &cfg, Config::Cache_Level lev)
+{
+    const Config::Cache_Info &info = cfg.caches[int(lev)];
+    if (!info.valid) { return "NoLevel"; }
+
+    std::ostringstream out;
+    out << "Level<" << info.size << ", " << info.assoc;
+    bool private_only = lev == Config::Cache_Level::L1I || lev == Config::Cache_Level::L1D;
+    if (!private_only && info.shared) { out << ", true"; }
+    out << ">";
+    return out.str();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <output header> <config> [<config> ...]\n";
+        return 1;
+    }
+
+    std::ostringstream configs, creates;
+    for (int arg = 2; arg < argc; arg++)
+    {
+        std::string cfg_file = argv[arg];
+        Config cfg(cfg_file);
+
+        std::string reason;
+        if (!supported(cfg, reason))
+        {
+            std::cerr << "Skipping " << cfg_file << ": " << reason << "\n";
+            continue;
+        }
+
+        std::string name = typeName(cfg_file);
+        size_t slash = cfg_file.find_last_of('/');
+        configs << "// " << (slash == std::string::npos ? cfg_file : cfg_file.substr(slash + 1))
+                << "\n"
+                << "typedef StaticConfig<" << cfg.num_cores << ", " << cfg.block_size << ",\n"
+                << "                     " << level(cfg, Config::Cache_Level::L1I) << ", "
+                << level(cfg, Config::Cache_Level::L1D) << ",\n"
+                << "                     " << level(cfg, Config::Cache_Level::L2) << ", "
+                << level(cfg, Config::Cache_Level::L3) << ", "
+                << level(cfg, Config::Cache_Level::eDRAM) << "> " << name << ";\n\n";
+
+        creates << "    if (StaticHierarchy<" << name << ">::matches(cfg))\n"
+                << "    {\n"
+                << "        return new StaticHierarchy<" << name << ">(cfg);\n"
+                << "    }\n";
+    }
+
+    std::ofstream out(argv[1]);
+    out << "#ifndef __CACHE_STATIC_CONFIGS_HH__\n"
+        << "#define __CACHE_STATIC_CONFIGS_HH__\n\n"
+        << "#include \"static_hierarchy.hh\"\n\n"
+        << "// Generated by trace_tools/gen_static_configs, do not edit (make -C trace_tools "
+        << "static_configs).\n"
+        << "namespace CacheSimulator\n"
+        << "{\n"
+        << configs.str()
+        << "// The compile-time hierarchy of cfg, nullptr if none of the above is cfg.\n"
+        << "inline StaticHierarchyBase *createStaticHierarchy(Config &cfg)\n"
+        << "{\n"
+        << creates.str()
+        << "    return nullptr;\n"
+        << "}\n"
+        << "}\n\n"
+        << "#endif\n";
+    return out.good() ? 0 : 1;
+}
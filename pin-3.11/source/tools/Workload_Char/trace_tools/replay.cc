@@ -0,0 +1,265 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../include/Sim/stats.hh"
+#include "../include/Sim/util.hh"
+#include "../include/Sim/config.hh"
+#include "../include/System/platforms.hh"
+#include "../include/CacheSim/stack_distance.hh"
+#include "../include/Trace/trace_format.hh"
+
+// The branch predictors of Workload_Analysis (they do not include its Sim/).
+#include "../../Workload_Analysis/src/Branch_Predictor/branch_predictor_factory.hh"
+
+// Replays a trace_extr trace (any format, see include/Trace/trace_format.hh) through the
+// simulated system of wl_char_roi: SingleNode MMU, the cache hierarchy of the configuration
+// and branch predictors, and writes the same stats (plus the predictors').
+//
+// Usage: replay -c <config> [-c <config> ...] -s <stats output> [-bp <predictor>[,...]]
+//               [-bp_threads 1] [-n <max instructions>] <trace>
+//     -c: repeat to simulate several platforms in one pass; the stats of each go to
+//         <stats output>.<config name> (see include/System/platforms.hh).
+//     -bp: two_bit_local (default), tournament, pentium_m, tage_sc_l, hashed_perceptron or
+//          none; a comma-separated list runs them all on the same branches, each with its
+//          own stats (see BP::Predictor_Ensemble).
+//     -bp_threads 1: run each predictor of -bp on its own thread.
+//     -bp_param <name>=<value>: a table parameter of the predictors, named as in the profiler's
+//                               configuration (e.g., tage_num_tables=8, see
+//                               Workload_Analysis/src/Branch_Predictor/branch_predictor_params.hh);
+//                               repeat for several.
+//     -n: stop after this many instructions (0, the default, replays the whole trace).
+//     -static 0: always build the run-time cache hierarchy, even for the configurations that
+//                have a compile-time one (include/CacheSim/static_configs.hh).
+//     -mrc: miss-ratio curves of the first platform's L1-D stream (see
+//           include/CacheSim/stack_distance.hh); summary to <mrc>, curves to <mrc>.csv.
+//     -mrc_sets: comma-separated set counts to profile (default 1, fully associative).
+//     -mrc_level: profile the requests going into L1D (default), L1I, L2, L3 or eDRAM.
+//     -mrc_rate, -mrc_max_lines: SHARDS sampling, at a fixed rate and/or with at most this
+//                                many sampled lines (fixed size).
+//     -mrc_check 1: also profile exactly, and report the mean absolute error of the
+//                   sampled curves.
+//
+// Differences with simulating under Pin:
+//     1) The trace only holds the PCs of memory and branch instructions, so L1-I only sees
+//        those (wl_char_roi fetches every instruction).
+//     2) Accesses are not split at block boundaries (the trace has no access sizes).
+//     3) Instructions are counted from the records: the other instructions in between, plus
+//        one per record but for the extra memory operands of an instruction (same PC, no
+//        instruction in between).
+// Everything is deterministic (the MMU shuffles its frames with a fixed seed), so a trace
+// replays to the same stats every time.
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> cfg_files;
+    std::string stats_file, bp_name = "two_bit_local";
+    std::string mrc_file, mrc_sets = "1", mrc_level = "L1D";
+    double mrc_rate = 1.0;
+    uint64_t mrc_max_lines = 0;
+    bool mrc_check = false;
+    bool use_static = true;
+    bool bp_threads = false;
+    BP::TAGE_Params tage;
+    BP::Perceptron_Params perceptron;
+    uint64_t max_insts = 0;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+        if (strcmp(argv[arg], "-c") == 0) { cfg_files.push_back(argv[arg + 1]); }
+        else if (strcmp(argv[arg], "-s") == 0) { stats_file = argv[arg + 1]; }
+        else if (strcmp(argv[arg], "-bp") == 0) { bp_name = argv[arg + 1]; }
+        else if (strcmp(argv[arg], "-bp_threads") == 0) { bp_threads = atoi(argv[arg + 1]); }
+        else if (strcmp(argv[arg], "-bp_param") == 0)
+        {
+            std::string param = argv[arg + 1];
+            size_t eq = param.find('=');
+            if (eq == std::string::npos ||
+                !BP::setParam(param.substr(0, eq), atoi(param.c_str() + eq + 1), tage,
+                              perceptron))
+            {
+                std::cerr << "Unknown branch predictor parameter " << param << "\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "-mrc") == 0) { mrc_file = argv[arg + 1]; }
+        else if (strcmp(argv[arg], "-mrc_sets") == 0) { mrc_sets = argv[arg + 1]; }
+        else if (strcmp(argv[arg], "-mrc_level") == 0) { mrc_level = argv[arg + 1]; }
+        else if (strcmp(argv[arg], "-mrc_rate") == 0) { mrc_rate = atof(argv[arg + 1]); }
+        else if (strcmp(argv[arg], "-mrc_max_lines") == 0)
+        {
+            mrc_max_lines = strtoull(argv[arg + 1], nullptr, 10);
+        }
+        else if (strcmp(argv[arg], "-mrc_check") == 0) { mrc_check = atoi(argv[arg + 1]); }
+        else if (strcmp(argv[arg], "-static") == 0) { use_static = atoi(argv[arg + 1]); }
+        else if (strcmp(argv[arg], "-n") == 0) { max_insts = strtoull(argv[arg + 1], nullptr, 10); }
+        else { break; }
+    }
+    if (argc - arg != 1 || cfg_files.empty() || stats_file.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " -c <config> [-c <config> ...] -s <stats output> "
+                  << "[-bp <predictor>[,<predictor>...]|none] [-bp_threads 1] "
+                  << "[-bp_param <name>=<value> ...] "
+                  << "[-n <max instructions>] "
+                  << "[-static 0] "
+                  << "[-mrc <output> [-mrc_sets <n,n,...>] [-mrc_level <level>] "
+                  << "[-mrc_rate <rate>] [-mrc_max_lines <n>] [-mrc_check 1]] <trace>\n";
+        return 1;
+    }
+
+    BP::Branch_Predictor *bp = nullptr;
+    BP::Predictor_Ensemble *ensemble = nullptr;
+    std::vector<std::thread> bp_workers;
+    if (bp_name != "none")
+    {
+        std::string unknown = bp_name;
+        if (bp_name.find(',') == std::string::npos && !bp_threads)
+        {
+            bp = BP::createBranchPredictor(bp_name, tage, perceptron);
+        }
+        else
+        {
+            ensemble = BP::createEnsemble(bp_name, unknown, tage, perceptron);
+            bp = ensemble;
+        }
+        if (bp == nullptr)
+        {
+            std::cerr << "Unknown branch predictor " << unknown << "\n";
+            return 1;
+        }
+
+        if (bp_threads)
+        {
+            ensemble->shard();
+            for (unsigned w = 0; w < ensemble->size(); w++)
+            {
+                bp_workers.emplace_back(BP::Predictor_Ensemble::workerMain,
+                                        ensemble->workerArg(w));
+            }
+        }
+    }
+
+    Trace::Reader reader(argv[arg]);
+    if (!reader.isValid())
+    {
+        std::cerr << "Cannot read trace " << argv[arg] << "\n";
+        return 1;
+    }
+
+    System::Platforms platforms(use_static);
+    for (auto &cfg_file : cfg_files) { platforms.add(cfg_file); }
+    platforms.init();
+
+    CacheSimulator::StackDistance *stack_distance = nullptr;
+    CacheSimulator::StackDistance *exact = nullptr;
+    std::vector<unsigned> set_counts = CacheSimulator::StackDistance::parseSetCounts(mrc_sets);
+    if (!mrc_file.empty())
+    {
+        Config::Cache_Level level = CacheSimulator::Hierarchy::parseLevel(mrc_level);
+        if (level == Config::Cache_Level::MAX ||
+            !platforms[0].cfg->caches[int(level)].valid)
+        {
+            std::cerr << "No " << mrc_level << " to profile\n";
+            return 1;
+        }
+
+        unsigned block_size = platforms[0].cfg->block_size;
+        stack_distance = new CacheSimulator::StackDistance(block_size, set_counts,
+                                                           mrc_rate, mrc_max_lines);
+        platforms.addObserver(stack_distance, level);
+        if (mrc_check)
+        {
+            exact = new CacheSimulator::StackDistance(block_size, set_counts);
+            platforms.addObserver(exact, level);
+        }
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    // Last PC of each thread, to tell the extra memory operands of an instruction apart.
+    std::unordered_map<uint32_t, uint64_t> last_eips;
+
+    uint64_t insn_count = 0;
+    uint64_t num_records = 0;
+    Trace::Record record;
+    Instruction instr;
+    while ((max_insts == 0 || insn_count < max_insts) && reader.next(record))
+    {
+        num_records++;
+
+        auto last = last_eips.emplace(record.tid, record.eip);
+        bool new_instr = record.count != 0 || last.second || last.first->second != record.eip;
+        last.first->second = record.eip;
+        insn_count += record.count + (new_instr ? 1 : 0);
+
+        if (new_instr) { platforms.fetch(record.eip); }
+
+        if (record.type == Trace::Type::BRANCH)
+        {
+            if (bp != nullptr)
+            {
+                instr.setPC(record.eip);
+                instr.setBranch();
+                instr.setTaken(record.taken);
+                bp->predict(instr, insn_count); // insn_count as time-stamp, as profiler.cpp.
+            }
+            continue;
+        }
+
+        platforms.access(record.eip, record.addr, 1, record.type == Trace::Type::STORE);
+    }
+
+    if (ensemble != nullptr) { ensemble->finish(); }
+    for (auto &worker : bp_workers) { worker.join(); }
+
+    if (!reader.isValid())
+    {
+        std::cerr << "Malformed trace " << argv[arg] << " after " << num_records
+                  << " records\n";
+        return 1;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    std::cout << "Replayed " << num_records << " records (" << insn_count
+              << " instructions) in " << elapsed.count() << " s ("
+              << uint64_t(num_records / elapsed.count()) << " records/s).\n";
+
+    for (unsigned p = 0; p < platforms.size(); p++)
+    {
+        Stats stat;
+        stat.registerStats("Number of instructions: "
+                           + to_string(insn_count));
+        platforms.registerStats(p, stat);
+        if (bp != nullptr) { bp->registerStats(stat); }
+
+        stat.outputStats(platforms.statsFile(p, stats_file));
+    }
+
+    if (stack_distance != nullptr)
+    {
+        Stats stat;
+        stack_distance->registerStats(stat);
+        if (exact != nullptr)
+        {
+            for (auto num_sets : set_counts)
+            {
+                double error = CacheSimulator::StackDistance::meanAbsoluteError(
+                    *exact, *stack_distance, num_sets);
+                stat.registerStats("Stack distance (" + to_string(num_sets) +
+                                   " sets): Mean absolute error vs. exact (assoc >= " +
+                                   to_string(stack_distance->resolution()) + ") = " +
+                                   to_string(error));
+            }
+        }
+        stat.outputStats(mrc_file);
+        stack_distance->outputCurves(mrc_file + ".csv");
+        delete stack_distance;
+        delete exact;
+    }
+
+    delete bp;
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../include/Trace/trace_format.hh"
+
+// Converts a trace_extr trace between the text and the binary format (see
+// include/Trace/trace_format.hh), compressed or not.
+//
+// Usage: trace_convert [-t|-b] [-z] <input trace> <output trace>
+//     -t, -b: output format (text or binary); by default, the other format than the input's.
+//     -z: compress the output into LZ frames.
+//
+// Binary output keeps the order of the events: a block holds up to BLOCK_RECORDS consecutive
+// events of a thread, and ends early when the next event is another thread's, so a converted
+// trace replays the same as the original.
+static const uint32_t BLOCK_RECORDS = 16384;
+static const size_t CHUNK_BYTES = 1 << 20;
+
+// Writes whole blocks/lines, as LZ frames of about CHUNK_BYTES if compressing.
+class Trace_Output
+{
+  public:
+    Trace_Output(const char *fn, bool _compress) : out(fn, std::ios::binary),
+                                                   compress(_compress) {}
+    ~Trace_Output() { flush(); }
+
+    bool isValid() const { return bool(out); }
+
+    std::string &buffer() { return chunk; }
+
+    // Call after whole blocks/lines have been appended to buffer().
+    void commit()
+    {
+        if (chunk.size() >= CHUNK_BYTES) { flush(); }
+    }
+
+    void flush()
+    {
+        if (chunk.empty()) { return; }
+        if (compress)
+        {
+            frame.clear();
+            compressor.compressFrame(reinterpret_cast<const uint8_t*>(chunk.data()),
+                                     chunk.size(), frame);
+            out.write(frame.data(), frame.size());
+        }
+        else
+        {
+            out.write(chunk.data(), chunk.size());
+        }
+        chunk.clear();
+    }
+
+    void writeHeader(uint16_t flags)
+    {
+        Trace::File_Header header;
+        header.flags = flags;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+  private:
+    std::ofstream out;
+    bool compress;
+    std::string chunk;
+    std::string frame;
+    LZ::Compressor compressor;
+};
+
+int main(int argc, char *argv[])
+{
+    int to_binary = -1;
+    bool compress = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (strcmp(argv[arg], "-t") == 0) { to_binary = 0; }
+        else if (strcmp(argv[arg], "-b") == 0) { to_binary = 1; }
+        else if (strcmp(argv[arg], "-z") == 0) { compress = true; }
+        else { break; }
+    }
+    if (argc - arg != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [-t|-b] [-z] <input trace> <output trace>\n";
+        return 1;
+    }
+
+    Trace::Reader reader(argv[arg]);
+    if (!reader.isValid())
+    {
+        std::cerr << "Cannot read trace " << argv[arg] << "\n";
+        return 1;
+    }
+    if (to_binary == -1) { to_binary = !reader.isBinary(); }
+
+    Trace_Output out(argv[arg + 1], compress);
+    if (!out.isValid())
+    {
+        std::cerr << "Cannot open " << argv[arg + 1] << "\n";
+        return 1;
+    }
+
+    uint64_t num_records = 0;
+    Trace::Record record;
+    if (!to_binary)
+    {
+        if (compress) { out.writeHeader(Trace::FLAG_COMPRESSED | Trace::FLAG_TEXT); }
+        while (reader.next(record))
+        {
+            Trace::formatText(record, out.buffer());
+            out.commit();
+            num_records++;
+        }
+    }
+    else
+    {
+        out.writeHeader(compress ? Trace::FLAG_COMPRESSED : 0);
+
+        Trace::Block_Encoder block;
+        uint32_t block_tid = 0;
+        while (reader.next(record))
+        {
+            if (block.numRecords() == 0 || record.tid != block_tid ||
+                block.numRecords() == BLOCK_RECORDS)
+            {
+                if (block.numRecords() > 0)
+                {
+                    block.finish(out.buffer());
+                    out.commit();
+                }
+                block.reset(record.tid);
+                block_tid = record.tid;
+            }
+            block.append(record);
+            num_records++;
+        }
+        if (block.numRecords() > 0) { block.finish(out.buffer()); }
+    }
+    out.flush();
+
+    if (!reader.isValid())
+    {
+        std::cerr << "Malformed trace " << argv[arg] << " after " << num_records
+                  << " records\n";
+        return 1;
+    }
+    std::cout << "Converted " << num_records << " records to "
+              << (to_binary ? "binary" : "text") << (compress ? " (compressed)" : "")
+              << ".\n";
+    return 0;
+}
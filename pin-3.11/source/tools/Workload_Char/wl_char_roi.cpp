@@ -16,36 +16,68 @@
 // TODO, how to handle branch misprediction.
 //     (Sniper sim, a hard-coded number, 15 is a reasonable number)
 
-// Data trace output
+// Data trace output: with -o, the LLC of the first configuration writes its off-chip reads and
+// write-backs (the latter with the original and new contents of their line) to the trace, see
+// include/CacheSim/cache.hh.
 using std::ofstream;
 ofstream trace_out;
 KNOB<std::string> TraceOut(KNOB_MODE_WRITEONCE, "pintool",
-    "o", "", "specify output trace file name");
+    "o", "", "specify output trace file name (data-aware LLC trace, none by default)");
+
+// NVM write analysis: with -nvm, the write-backs of the LLC of the first configuration go to
+// an NVMWrites (see include/Sim/nvm_writes.hh), which writes its per-interval histograms to
+// the file and its totals to the stats.
+ofstream nvm_out;
+KNOB<std::string> NVMOut(KNOB_MODE_WRITEONCE, "pintool",
+    "nvm", "", "specify output file of the NVM write-back histograms (none by default)");
 
 static bool fast_forwarding = true; // Fast-forwarding mode? Initially, we should be
                                     // in fast-forwarding mode.
 
-// Define config here
-KNOB<std::string> CfgFile(KNOB_MODE_WRITEONCE, "pintool",
-    "c", "", "specify system configuration file name");
-#include "include/Sim/config.hh"
-static Config *cfg;
-
-// Define MMU
-#include "include/System/mmu.hh"
-static unsigned int NUM_CORES;
-typedef System::SingleNode SingleNode; // A bit advanced MMU.
-static SingleNode *mmu;
-
-// Define cache here
-static unsigned BLOCK_SIZE;
-#include "include/CacheSim/cache.hh"
-typedef CacheSimulator::SetWayAssocCache Cache;
-static std::vector<Cache*> L1Is, L1Ds, L2s, L3s, eDRAMs;
-
-// Define data storage unit
+// Define config here. Repeat -c to simulate several platforms in one run (see
+// include/System/platforms.hh); the stats of each go to <-s>.<config name>.
+KNOB<std::string> CfgFile(KNOB_MODE_APPEND, "pintool",
+    "c", "", "specify system configuration file name(s)");
+
+// Configurations with a compile-time cache hierarchy (include/CacheSim/static_configs.hh) use
+// it unless -static 0.
+KNOB<bool> UseStatic(KNOB_MODE_WRITEONCE, "pintool",
+    "static", "1", "use the compile-time cache hierarchy of a configuration when there is one");
+
+// Every level of the configuration is connected to the next, as in trace_tools/replay.
+// -legacy_wiring 1 connects the caches as wl_char_roi used to (core 0's L1s to the L2, see
+// CacheSimulator::Hierarchy), to reproduce earlier results.
+KNOB<bool> LegacyWiring(KNOB_MODE_WRITEONCE, "pintool",
+    "legacy_wiring", "0", "connect only core 0's L1s, to the L2");
+
+// Define MMU and caches here, one cache hierarchy per configuration.
+#include "include/System/platforms.hh"
+static System::Platforms *platforms;
+static unsigned BLOCK_SIZE; // Of the first configuration.
+
+// Miss-ratio curves of the requests going into one level of the first configuration, see
+// include/CacheSim/stack_distance.hh. The summary goes to <-mrc>, the curves to <-mrc>.csv.
+KNOB<std::string> MrcOut(KNOB_MODE_WRITEONCE, "pintool",
+    "mrc", "", "specify output file of the miss-ratio curves (none by default)");
+KNOB<std::string> MrcSets(KNOB_MODE_WRITEONCE, "pintool",
+    "mrc_sets", "1", "set counts to profile, comma-separated (1 is fully associative)");
+KNOB<std::string> MrcLevel(KNOB_MODE_WRITEONCE, "pintool",
+    "mrc_level", "L1D", "level to profile: L1I, L1D, L2, L3 or eDRAM");
+KNOB<double> MrcRate(KNOB_MODE_WRITEONCE, "pintool",
+    "mrc_rate", "1", "SHARDS sampling rate of the lines (1 profiles every line)");
+KNOB<UINT64> MrcMaxLines(KNOB_MODE_WRITEONCE, "pintool",
+    "mrc_max_lines", "0", "SHARDS fixed size: at most this many sampled lines (0 for no limit)");
+KNOB<bool> MrcCheck(KNOB_MODE_WRITEONCE, "pintool",
+    "mrc_check", "0", "also profile exactly and report the error of the sampled curves");
+#include "include/CacheSim/stack_distance.hh"
+static CacheSimulator::StackDistance *stack_distance = NULL;
+static CacheSimulator::StackDistance *exact_distance = NULL;
+static std::vector<unsigned> mrc_set_counts;
+
+// Define data storage unit (data-aware tracing only)
 #include "include/Sim/data.hh"
-static Data *data_storage;
+static Data *data_storage = NULL;
+static NVMWrites *nvm_writes = NULL;
 
 // Stats output
 KNOB<std::string> StatsOut(KNOB_MODE_WRITEONCE, "pintool",
@@ -100,6 +132,79 @@ BOOL FollowChild(CHILD_PROCESS childProcess, VOID * userData)
 
 static const uint64_t LIMIT = 1000000000;
 static uint64_t insn_count = 0; // Track how many instructions we have already instrumented.
+
+// Instruction counting mode. "bbl" adds BBL_NumIns once per basic block into a per-thread
+// counter (no lock); "ins" is the original one-call-per-instruction counter, kept so that
+// the two can be compared (see test_apps/slowdown.bash).
+KNOB<std::string> CountMode(KNOB_MODE_WRITEONCE, "pintool",
+    "count_mode", "bbl", "instruction counting mode: bbl or ins");
+static bool per_bbl_count = true;
+
+// Instrumentation versions (per-basic-block counting mode only). Code outside the ROI runs
+// the fast-forward version, which carries nothing but the magic-op hook; the ROI runs the
+// simulation version. See include/Pin/fast_forward.hh.
+#include "include/Pin/fast_forward.hh"
+enum Version : ADDRINT
+{
+    VERSION_FAST_FORWARD = FastForward::DEFAULT_VERSION,
+    VERSION_SIM,
+    NUM_VERSIONS
+};
+
+// A thread only folds its count into insn_count (under pinLock) once every COUNT_QUANTUM
+// instructions.
+static const uint64_t COUNT_QUANTUM = 1 << 16;
+
+static void outputStats()
+{
+    for (unsigned p = 0; p < platforms->size(); p++)
+    {
+        Stats stat;
+        stat.registerStats("Number of instructions: "
+                           + to_string(insn_count));
+
+        platforms->registerStats(p, stat);
+
+        stat.outputStats(platforms->statsFile(p, StatsOut.Value()));
+    }
+
+    if (stack_distance != NULL)
+    {
+        Stats stat;
+        stack_distance->registerStats(stat);
+        if (exact_distance != NULL)
+        {
+            for (auto num_sets : mrc_set_counts)
+            {
+                double error = CacheSimulator::StackDistance::meanAbsoluteError(
+                    *exact_distance, *stack_distance, num_sets);
+                stat.registerStats("Stack distance (" + to_string(num_sets) +
+                                   " sets): Mean absolute error vs. exact (assoc >= " +
+                                   to_string(stack_distance->resolution()) + ") = " +
+                                   to_string(error));
+            }
+        }
+        stat.outputStats(MrcOut.Value());
+        stack_distance->outputCurves(MrcOut.Value() + ".csv");
+        delete stack_distance;
+        delete exact_distance;
+    }
+
+    delete platforms;
+    delete data_storage;
+    delete nvm_writes;
+    if (trace_out.is_open()) { trace_out.close(); }
+    if (nvm_out.is_open()) { nvm_out.close(); }
+}
+
+static void outputStatsAndExit()
+{
+    // std::cout << "Total number of threads = " << numThreads << std::endl;
+    outputStats();
+
+    exit(0);
+}
+
 static void increCount(THREADID t_id) 
 {
     if (fast_forwarding) { return; }	
@@ -107,51 +212,40 @@ static void increCount(THREADID t_id)
     ++insn_count;
 
     // Exit if it exceeds a threshold.
-    if (insn_count >= LIMIT)
-    {
-        // std::cout << "Total number of threads = " << numThreads << std::endl;
-        Stats stat;
-        stat.registerStats("Number of instructions: "
-                           + to_string(insn_count) + "\n");
+    if (insn_count >= LIMIT) { outputStatsAndExit(); }
 
-        for (auto cache : L1Is) { cache->registerStats(stat); }
-        for (auto cache : L1Ds) { cache->registerStats(stat); }
-        for (auto cache : L2s) { cache->registerStats(stat); }
-        for (auto cache : L3s) { cache->registerStats(stat); }
-        for (auto cache : eDRAMs) { cache->registerStats(stat); }
-
-        stat.outputStats(StatsOut.Value().c_str());
+    PIN_ReleaseLock(&pinLock);
+}
 
-        for (auto cache : L1Is) { delete cache; }
-        for (auto cache : L1Ds) { delete cache; }
-        for (auto cache : L2s) { delete cache; }
-        for (auto cache : L3s) { delete cache; }
-        for (auto cache : eDRAMs) { delete cache; }
+// Inlined predicate guarding every simulation call. With versioning it only matters for the
+// instructions a thread executes between a magic op and its next basic block.
+static ADDRINT PIN_FAST_ANALYSIS_CALL isSimulating()
+{
+    return !fast_forwarding;
+}
 
-        delete cfg;
-        delete mmu;
-        delete data_storage;
+static void PIN_FAST_ANALYSIS_CALL foldCount(THREADID t_id)
+{
+    PIN_GetLock(&pinLock, t_id + 1);
+    insn_count += FastForward::takeCount(t_id);
 
-        exit(0);
-    }
+    // Exit if it exceeds a threshold.
+    if (insn_count >= LIMIT) { outputStatsAndExit(); }
 
     PIN_ReleaseLock(&pinLock);
+    FastForward::checkAgainIn(t_id, COUNT_QUANTUM);
 }
 
-/*
+// The data of the previous store of a thread (now done) into the data storage.
 static void writeData(THREADID t_id)
 {
-    return;
-    std::cerr << "Counting number of instructions only..." << std::endl;
-    exit(0);
-
     thread_data_t* t_data = static_cast<thread_data_t*>(PIN_GetThreadData(tls_key, t_id));
 
     if (t_data->prev_is_write)
     {
         // Lock storage-access
         PIN_GetLock(&pinLock, t_id + 1);
-        for (unsigned int i = 0; i < NUM_CORES; i++)
+        for (unsigned int i = 0; i < (*platforms)[0].cfg->num_cores; i++)
         {
             for (unsigned int j = 0; j < (t_data->prev_write_addrs).size(); j++)
 	    {
@@ -166,11 +260,9 @@ static void writeData(THREADID t_id)
                 req.addr = (uint64_t)prev_write_addr;
 
                 req.core_id = i;
-                mmu->va2pa(req);
+                platforms->getMMU().va2pa(req);
 
-                data_storage->modifyData((req.addr & ~((uint64_t)BLOCK_SIZE - (uint64_t)1)),
-                                         new_write_data,
-                                         prev_write_size);
+                data_storage->modifyData(req.addr, new_write_data, prev_write_size);
             }
         }
         
@@ -180,29 +272,41 @@ static void writeData(THREADID t_id)
         PIN_ReleaseLock(&pinLock);
     }
 }
-*/
 
 static void simInstrCache(THREADID t_id,
                           ADDRINT eip)
 {
-    if (fast_forwarding) { return; }
-
-    Request req;
-    req.instr_loading = true;
-    req.req_type = Request::Request_Type::READ;
-    req.addr = (uint64_t)eip;
-
     PIN_GetLock(&pinLock, t_id + 1);
     // std::cout << "Thread " << t_id << " is accessing cache..." << std::endl;
-    for (unsigned int i = 0; i < NUM_CORES; i++)
+    platforms->fetch((uint64_t)eip); // TODO, any instruction loading should be marked.
+    PIN_ReleaseLock(&pinLock);
+}
+
+// Lines of an access that just came into the caches (of the first configuration), as the
+// program has them, into the data storage.
+static void loadData(ADDRINT mem_addr, UINT32 payload_size)
+{
+    static std::vector<Addr> lines;
+    System::Platforms::splitLines(mem_addr, payload_size, BLOCK_SIZE, lines);
+
+    uint8_t data[BLOCK_SIZE];
+    for (unsigned int i = 0; i < (*platforms)[0].cfg->num_cores; i++)
     {
-        req.core_id = i;
-        mmu->va2pa(req); // TODO, any instruction loading should be marked.
+        for (auto line : lines)
+        {
+            Request req;
+            req.core_id = i;
+            req.addr = line;
+            platforms->getMMU().va2pa(req);
+
+            Addr aligned_addr = req.addr & ~((uint64_t)BLOCK_SIZE - (uint64_t)1);
+            if (data_storage->contains(aligned_addr)) { continue; }
 
-        L1Is[i]->send(req);
+            ADDRINT aligned_line = line & ~((ADDRINT)BLOCK_SIZE - (ADDRINT)1);
+            PIN_SafeCopy(&data, (const uint8_t*)aligned_line, BLOCK_SIZE);
+            data_storage->loadData(aligned_addr, data, BLOCK_SIZE);
+        }
     }
-    
-    PIN_ReleaseLock(&pinLock);
 }
 
 // TODO, simulate store and load.
@@ -216,101 +320,25 @@ static void simMemOpr(THREADID t_id,
     // std::cerr << "Counting number of instructions only..." << std::endl;
     // exit(0);
 
-    if (fast_forwarding) { return; }
-   
-    thread_data_t* t_data = static_cast<thread_data_t*>(PIN_GetThreadData(tls_key, t_id));
-
-    // Important! Check cross-block situations. Common in Python program.
-    std::vector<ADDRINT> addrs;
-    std::vector<UINT32> sizes;
-
-    ADDRINT aligned_addr_begin = mem_addr & ~((ADDRINT)BLOCK_SIZE - (ADDRINT)1);
-    ADDRINT aligned_addr_end = (mem_addr + (ADDRINT)payload_size - (ADDRINT)1) 
-                               & ~((ADDRINT)BLOCK_SIZE - (ADDRINT)1);
-    addrs.push_back(mem_addr); 
-    for (ADDRINT addr = aligned_addr_begin + BLOCK_SIZE;
-                addr <= aligned_addr_end;
-                addr += BLOCK_SIZE)
-    {
-        addrs.push_back(addr);
-    }
-
-    UINT32 payload_left = payload_size;
-    if (addrs.size() == 1)
+    if (is_store && data_storage != NULL)
     {
-        sizes.push_back(payload_left);
-        payload_left = 0;
-    }
-    else
-    {
-        UINT32 chunk_size = (UINT32)BLOCK_SIZE - 
-                            (UINT32)(mem_addr & ((ADDRINT)BLOCK_SIZE - (ADDRINT)1));
-        sizes.push_back(chunk_size);
-        payload_left -= chunk_size;
-    }
-    while (payload_left > 0)
-    {
-        if (payload_left > BLOCK_SIZE)
-        {
-            sizes.push_back(BLOCK_SIZE);
-            payload_left -= (UINT32)BLOCK_SIZE;
-        }
-        else
-        {
-            sizes.push_back(payload_left);
-            payload_left = 0;
-        }
-    }
-    assert(sizes.size() == addrs.size());
-
-    Request req;
+        thread_data_t* t_data = static_cast<thread_data_t*>(PIN_GetThreadData(tls_key, t_id));
 
-    req.eip = eip;
-    if (is_store)
-    {
-        req.req_type = Request::Request_Type::WRITE;
+        // Important! Check cross-block situations. Common in Python program.
+        std::vector<Addr> addrs;
+        std::vector<unsigned> sizes;
+        System::Platforms::splitLines(mem_addr, payload_size, BLOCK_SIZE, addrs, &sizes);
 
         t_data->prev_is_write = true;
         for (auto addr : addrs) { (t_data->prev_write_addrs).push_back(addr); }
         for (auto size : sizes) { (t_data->prev_write_sizes).push_back(size); }
     }
-    else
-    {
-        req.req_type = Request::Request_Type::READ;
-    }
 
-    // Lock access-cache
+    // Lock access-cache. Lines are split and translated once, for all the platforms.
     PIN_GetLock(&pinLock, t_id + 1);
     // std::cout << "Thread " << t_id << " is accessing cache..." << std::endl;
-    for (unsigned int i = 0; i < NUM_CORES; i++)
-    {
-        for (unsigned int j = 0; j < addrs.size(); j++)
-        {
-            ADDRINT addr = addrs[j];
-
-            req.core_id = i;
-            req.addr = (uint64_t)addr;
-            mmu->va2pa(req);
-
-            L1Ds[i]->send(req);
-            // bool hit = L1Ds[i]->send(req);
-
-            /*
-	    if (!hit)
-            {
-                uint8_t data[BLOCK_SIZE];
-
-                ADDRINT aligned_addr = addr & ~((ADDRINT)BLOCK_SIZE - (ADDRINT)1);
-                PIN_SafeCopy(&data, (const uint8_t*)aligned_addr, BLOCK_SIZE);
-
-                data_storage->loadData((req.addr & ~((uint64_t)BLOCK_SIZE - (uint64_t)1)),
-                                       data,
-                                       (unsigned)BLOCK_SIZE);
-            }
-            */
-        }
-    }
-    
+    platforms->access((uint64_t)eip, (uint64_t)mem_addr, payload_size, is_store);
+    if (data_storage != NULL) { loadData(mem_addr, payload_size); }
     PIN_ReleaseLock(&pinLock);
 }
 
@@ -323,34 +351,62 @@ void HandleMagicOp(THREADID t_id, ADDRINT op)
         case ROI_BEGIN:
             PIN_GetLock(&pinLock, t_id + 1);
             fast_forwarding = false;
+            if (per_bbl_count) { FastForward::setVersion(VERSION_SIM); }
             PIN_ReleaseLock(&pinLock);
             // std::cout << "Captured roi_begin() \n";
             return;
         case ROI_END:
             PIN_GetLock(&pinLock, t_id + 1);
             fast_forwarding = true;
+            if (per_bbl_count) { FastForward::setVersion(VERSION_FAST_FORWARD); }
             PIN_ReleaseLock(&pinLock);
             // std::cout << "Captured roi_end() \n";
             return;
     }
 }
 
-// "Main" function: decode and simulate the instruction
-static void instructionSim(INS ins)
+// "Main" function: decode and simulate the instruction. Without simulate, only the magic
+// ops are instrumented (fast-forward version).
+static void instructionSim(INS ins, bool simulate)
 {
-    // Count number of instructions.
-    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)increCount, IARG_THREAD_ID, IARG_END);
+    // Count number of instructions (per-instruction mode only, see traceCallback()).
+    if (!per_bbl_count)
+    {
+        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)increCount, IARG_THREAD_ID, IARG_END);
+    }
 
-    // Simulate instruction cache
-    INS_InsertCall(ins, 
-                   IPOINT_BEFORE,
-                   (AFUNPTR)simInstrCache,
-                   IARG_THREAD_ID,
-                   IARG_ADDRINT, INS_Address(ins),
-                   IARG_END);
+    if (INS_IsXchg(ins) &&
+        INS_OperandReg(ins, 0) == REG_RCX &&
+        INS_OperandReg(ins, 1) == REG_RCX)
+    {
+        INS_InsertCall(
+            ins,
+            IPOINT_BEFORE,
+            (AFUNPTR) HandleMagicOp,
+            IARG_THREAD_ID,
+            IARG_REG_VALUE, REG_ECX,
+            IARG_END);
+    }
+
+    if (!simulate) { return; }
+
+    // Finish up prev store (data-aware tracing only), before the fetch can evict its line.
+    if (data_storage != NULL)
+    {
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)isSimulating,
+                         IARG_FAST_ANALYSIS_CALL, IARG_END);
+        INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)writeData, IARG_THREAD_ID, IARG_END);
+    }
 
-    // Finish up prev store (disabled for now).
-    // INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)writeData, IARG_THREAD_ID, IARG_END);
+    // Simulate instruction cache
+    INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)isSimulating,
+                     IARG_FAST_ANALYSIS_CALL, IARG_END);
+    INS_InsertThenCall(ins, 
+                       IPOINT_BEFORE,
+                       (AFUNPTR)simInstrCache,
+                       IARG_THREAD_ID,
+                       IARG_ADDRINT, INS_Address(ins),
+                       IARG_END);
 
     if (INS_IsMemoryRead (ins) || INS_IsMemoryWrite (ins))
     {
@@ -358,11 +414,13 @@ static void instructionSim(INS ins)
         {
             if (INS_MemoryOperandIsRead(ins, i))
             {
-                INS_InsertPredicatedCall(
+                INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)isSimulating,
+                                           IARG_FAST_ANALYSIS_CALL, IARG_END);
+                INS_InsertThenPredicatedCall(
                     ins,
                     IPOINT_BEFORE,
                     (AFUNPTR)simMemOpr,
-		    IARG_THREAD_ID,
+                    IARG_THREAD_ID,
                     IARG_ADDRINT, INS_Address(ins),
                     IARG_BOOL, FALSE,
                     IARG_MEMORYOP_EA, i,
@@ -372,11 +430,13 @@ static void instructionSim(INS ins)
 
             if (INS_MemoryOperandIsWritten(ins, i))
             {
-                INS_InsertPredicatedCall(
+                INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)isSimulating,
+                                           IARG_FAST_ANALYSIS_CALL, IARG_END);
+                INS_InsertThenPredicatedCall(
                     ins,
                     IPOINT_BEFORE,
                     (AFUNPTR)simMemOpr,
-		    IARG_THREAD_ID,
+                    IARG_THREAD_ID,
                     IARG_ADDRINT, INS_Address(ins),
                     IARG_BOOL, TRUE,
                     IARG_MEMORYOP_EA, i,
@@ -385,61 +445,42 @@ static void instructionSim(INS ins)
             }
         }
     }
-    else if (INS_IsXchg(ins) &&
-             INS_OperandReg(ins, 0) == REG_RCX &&
-             INS_OperandReg(ins, 1) == REG_RCX)
-    {
-        INS_InsertCall(
-            ins,
-            IPOINT_BEFORE,
-            (AFUNPTR) HandleMagicOp,
-            IARG_THREAD_ID,
-            IARG_REG_VALUE, REG_ECX,
-            IARG_END);
-    }
 }
 
 static void traceCallback(TRACE trace, VOID *v)
 {
+    // The original counting mode keeps a single, fully instrumented version.
+    bool simulate = !per_bbl_count || TRACE_Version(trace) == VERSION_SIM;
+
     BBL bbl_head = TRACE_BblHead(trace);
 
     for (BBL bbl = bbl_head; BBL_Valid(bbl); bbl = BBL_Next(bbl))
     {
+        if (per_bbl_count && simulate)
+        {
+            FastForward::insertCount(bbl, (AFUNPTR)foldCount);
+        }
+
         for(INS ins = BBL_InsHead(bbl); ; ins = INS_Next(ins))
         {
-            instructionSim(ins);
+            instructionSim(ins, simulate);
             if (ins == BBL_InsTail(bbl))
             {
                 break;
             }
         }
+
+        if (per_bbl_count) { FastForward::insertVersionSwitch(trace, bbl); }
     }
 }
 
 VOID Fini(INT32 code, VOID *v)
 {
     std::cout << "Total number of threads = " << numThreads << std::endl;
-    Stats stat;
-    stat.registerStats("Number of instructions: "
-		        + to_string(insn_count));
-
-    for (auto cache : L1Is) { cache->registerStats(stat); }
-    for (auto cache : L1Ds) { cache->registerStats(stat); }
-    for (auto cache : L2s) { cache->registerStats(stat); }
-    for (auto cache : L3s) { cache->registerStats(stat); }
-    for (auto cache : eDRAMs) { cache->registerStats(stat); }
-
-    stat.outputStats(StatsOut.Value().c_str());
-
-    for (auto cache : L1Is) { delete cache; }
-    for (auto cache : L1Ds) { delete cache; }
-    for (auto cache : L2s) { delete cache; }
-    for (auto cache : L3s) { delete cache; }
-    for (auto cache : eDRAMs) { delete cache; }
-
-    delete cfg;
-    delete mmu;
-    delete data_storage;
+    // Fold in what the threads have not flushed yet.
+    insn_count += FastForward::takeAllCounts();
+
+    outputStats();
 }
 
 int
@@ -455,93 +496,57 @@ main(int argc, char *argv[])
         return 1;
     }
     // assert(!TraceOut.Value().empty());
-    assert(!CfgFile.Value().empty());
+    assert(CfgFile.NumberOfValues() > 0);
     assert(!StatsOut.Value().empty());
-
-    // trace_out.open(TraceOut.Value().c_str());
-
-    // Parse configuration file
-    cfg = new Config(CfgFile.Value());
-    NUM_CORES = cfg->num_cores;
-    assert(NUM_CORES == 1); // TODO, should delete this for future analysis.
-
-    BLOCK_SIZE = cfg->block_size;
-    
-    // Create MMU
-    mmu = new SingleNode(NUM_CORES);
-
-    // Create caches
-    if (cfg->caches[int(Config::Cache_Level::L1I)].valid)
+    assert(CountMode.Value() == "bbl" || CountMode.Value() == "ins");
+    per_bbl_count = CountMode.Value() == "bbl";
+    if (per_bbl_count) { FastForward::init(NUM_VERSIONS); }
+
+    // Parse configuration files, create caches and MMU
+    platforms = new System::Platforms(UseStatic.Value(),
+                                      LegacyWiring.Value() ?
+                                      CacheSimulator::Hierarchy::Wiring::LEGACY :
+                                      CacheSimulator::Hierarchy::Wiring::LEVELS);
+    for (UINT32 i = 0; i < CfgFile.NumberOfValues(); i++)
     {
-        for (unsigned i = 0; i < NUM_CORES; i++)
-        {
-            L1Is.emplace_back(new Cache(Config::Cache_Level::L1I, *cfg));
-            L1Is[i]->setId(i);
-        }
+        platforms->add(CfgFile.Value(i));
     }
+    platforms->init();
 
-    if (cfg->caches[int(Config::Cache_Level::L1D)].valid)
-    {
-        for (unsigned i = 0; i < NUM_CORES; i++)
-        {
-            L1Ds.emplace_back(new Cache(Config::Cache_Level::L1D, *cfg));
-            L1Ds[i]->setId(i);
-        }
-    }
+    BLOCK_SIZE = (*platforms)[0].cfg->block_size;
 
-    if (cfg->caches[int(Config::Cache_Level::L2)].valid)
+    if (!MrcOut.Value().empty())
     {
-        if (cfg->caches[int(Config::Cache_Level::L2)].shared)
+        Config::Cache_Level level = CacheSimulator::Hierarchy::parseLevel(MrcLevel.Value());
+        assert(level != Config::Cache_Level::MAX);
+        assert((*platforms)[0].cfg->caches[int(level)].valid);
+
+        mrc_set_counts = CacheSimulator::StackDistance::parseSetCounts(MrcSets.Value());
+        stack_distance = new CacheSimulator::StackDistance(
+            BLOCK_SIZE, mrc_set_counts, MrcRate.Value(), MrcMaxLines.Value());
+        platforms->addObserver(stack_distance, level);
+        if (MrcCheck.Value())
         {
-            L2s.emplace_back(new Cache(Config::Cache_Level::L2, *cfg));
-        }
-        else
-        {
-            for (unsigned i = 0; i < NUM_CORES; i++)
-            {
-                L2s.emplace_back(new Cache(Config::Cache_Level::L2, *cfg));
-                L2s[i]->setId(i);
-            }
+            exact_distance = new CacheSimulator::StackDistance(BLOCK_SIZE, mrc_set_counts);
+            platforms->addObserver(exact_distance, level);
         }
     }
 
-    if (cfg->caches[int(Config::Cache_Level::L3)].valid)
+    // Data storage, for data-aware tracing and NVM write analysis of the LLC of the first
+    // configuration.
+    if (!TraceOut.Value().empty() || !NVMOut.Value().empty())
     {
-        if (cfg->caches[int(Config::Cache_Level::L3)].shared)
-        {
-            L3s.emplace_back(new Cache(Config::Cache_Level::L3, *cfg));
-        }
-        else
+        if (!TraceOut.Value().empty()) { trace_out.open(TraceOut.Value().c_str()); }
+        if (!NVMOut.Value().empty())
         {
-            for (unsigned i = 0; i < NUM_CORES; i++)
-            {
-                L3s.emplace_back(new Cache(Config::Cache_Level::L3, *cfg));
-                L3s[i]->setId(i);
-            }
+            nvm_out.open(NVMOut.Value().c_str());
+            nvm_writes = new NVMWrites(*(*platforms)[0].cfg, &nvm_out);
         }
+        data_storage = new Data(BLOCK_SIZE);
+        platforms->traceData(0, data_storage, trace_out.is_open() ? &trace_out : NULL,
+                             nvm_writes);
     }
 
-    // Data storage
-    data_storage = new Data(BLOCK_SIZE);
-
-    /*
-    // skylake setup
-    L1Is[0]->setNextLevel(L2s[0]);
-    L1Ds[0]->setNextLevel(L2s[0]);
-    L2s[0]->setPrevLevel(L1Is[0]);
-    L2s[0]->setPrevLevel(L1Ds[0]);
-
-    L2s[0]->setNextLevel(L3s[0]);
-    L3s[0]->setPrevLevel(L2s[0]);
-    L3s[0]->traceOutput(&trace_out);
-    L3s[0]->setStorageUnit(data_storage);
-    */
-    // cortex a-76 setup
-    L1Is[0]->setNextLevel(L2s[0]);
-    L1Ds[0]->setNextLevel(L2s[0]);
-    L2s[0]->setPrevLevel(L1Is[0]);
-    L2s[0]->setPrevLevel(L1Ds[0]);
-
     // Obtain  a key for TLS storage.
     tls_key = PIN_CreateThreadDataKey(NULL);
     if (tls_key == INVALID_TLS_KEY)